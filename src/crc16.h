@@ -0,0 +1,35 @@
+/**
+ * @file crc16.h
+ *
+ * @brief CRC-16/CCITT (polynomial 0x1021, MSB first)
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef CRC16_H_
+#define CRC16_H_
+
+#include "micro.h"
+
+#define CRC16_INIT 0xFFFF
+
+/**
+ * @brief Update the CRC with one byte
+ *
+ * @details Table-less byte update, cheap enough to be called from an ISR.
+ *          Once the CRC is appended MSB first, the CRC computed over the
+ *          data and the CRC itself is 0.
+ */
+static inline uint16_t Crc16__Update(uint16_t crc, uint8_t data)
+{
+    crc = (crc >> 8) | (crc << 8);
+    crc ^= data;
+    crc ^= (crc & 0xFF) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xFF) << 5;
+
+    return crc;
+}
+
+#endif /* CRC16_H_ */
@@ -0,0 +1,128 @@
+/**
+ * @file hal.h
+ *
+ * @brief Pins and SPI port used by the SPI and radio drivers
+ *
+ * @details spi.c and radio.c reach the hardware only through these. On the
+ *          target they are inline register accesses. The host build
+ *          (HOST_BUILD) implements them on an emulated nRF24L01+, see
+ *          src/sim.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include "micro.h"
+
+// Chip select lines, all on PORTB
+#define HAL_CSN_RADIO (1 << 2) // PB2
+
+#ifdef HOST_BUILD
+
+void Hal__InitializeSpi(void);
+void Hal__SetSpiClock(uint8_t spr, uint8_t spi2x);
+void Hal__SelectSpi(uint8_t csn_mask);
+void Hal__DeselectSpi(uint8_t csn_mask);
+void Hal__WriteSpi(uint8_t data);
+uint8_t Hal__ReadSpi(void);
+BOOL_T Hal__IsSpiDone(void);
+void Hal__EnableSpiInterrupt(void);
+void Hal__DisableSpiInterrupt(void);
+void Hal__InitializeRadioPins(void);
+void Hal__DriveRadioCeLow(void);
+void Hal__DriveRadioCeHigh(void);
+BOOL_T Hal__IsRadioIrqActive(void);
+
+#else
+
+/**
+ * @brief SPI master with its interrupt, MOSI, SCK and chip selects as
+ *        outputs, the SCK rate is set by Hal__SetSpiClock()
+ */
+static inline void Hal__InitializeSpi(void)
+{
+    DDRB |= (1 << DDB5) | (1 << DDB3) | (1 << DDB2);
+    SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPIE);
+}
+
+static inline void Hal__SetSpiClock(uint8_t spr, uint8_t spi2x)
+{
+    SPCR = (SPCR & ~((1 << SPR1) | (1 << SPR0))) | spr;
+    SPSR = spi2x << SPI2X;
+}
+
+static inline void Hal__SelectSpi(uint8_t csn_mask)
+{
+    PORTB &= ~csn_mask;
+}
+
+static inline void Hal__DeselectSpi(uint8_t csn_mask)
+{
+    PORTB |= csn_mask;
+}
+
+static inline void Hal__WriteSpi(uint8_t data)
+{
+    SPDR = data;
+}
+
+/**
+ * @remarks Clears SPIF, after Hal__IsSpiDone() or in the SPI ISR
+ */
+static inline uint8_t Hal__ReadSpi(void)
+{
+    return SPDR;
+}
+
+static inline BOOL_T Hal__IsSpiDone(void)
+{
+    return (SPSR & (1 << SPIF)) ? TRUE : FALSE;
+}
+
+static inline void Hal__EnableSpiInterrupt(void)
+{
+    SPCR |= (1 << SPIE);
+}
+
+static inline void Hal__DisableSpiInterrupt(void)
+{
+    SPCR &= ~(1 << SPIE);
+}
+
+/**
+ * @brief CE on PB1 as output, IRQ on PD2 as input with INT0 on the
+ *        falling edge
+ */
+static inline void Hal__InitializeRadioPins(void)
+{
+    DDRB |= (1 << DDB1);
+    DDRD &= ~(1 << DDD2);
+    EICRA |= (1 << ISC01);
+    EICRA &= ~(1 << ISC00);
+    EIMSK |= (1 << INT0);
+}
+
+static inline void Hal__DriveRadioCeLow(void)
+{
+    PORTB &= ~(1 << PORTB1);
+}
+
+static inline void Hal__DriveRadioCeHigh(void)
+{
+    PORTB |= (1 << PORTB1);
+}
+
+/**
+ * @brief The IRQ line is active low
+ */
+static inline BOOL_T Hal__IsRadioIrqActive(void)
+{
+    return (PIND & (1 << PIND2)) ? FALSE : TRUE;
+}
+
+#endif /* HOST_BUILD */
+
+#endif /* HAL_H_ */
@@ -8,10 +8,16 @@
 #ifndef SRC_DRIVERS_MICRO_H_
 #define SRC_DRIVERS_MICRO_H_
 
+#ifdef HOST_BUILD
+// Simulator build on a PC, see src/sim
+#include "host.h"
+#else
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <util/atomic.h>
 #include <util/delay_basic.h>
+#endif
 
 // Frequency of the CPU
 #ifndef F_CPU
@@ -29,5 +35,7 @@ void Micro__Initialize(void);
 #define Micro__WaitFourClockCycles(n) _delay_loop_2(n)
 #define Micro__GetClockFrequency() F_CPU
 #define Micro__EnableInterrupts() sei()
+#define Micro__DisableInterrupts() cli()
+#define Micro__MemoryBarrier() __asm__ __volatile__("" ::: "memory")
 
 #endif /* SRC_DRIVERS_MICRO_H_ */
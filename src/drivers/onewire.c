@@ -14,6 +14,7 @@
 
 #include "micro.h"
 #include "onewire.h"
+#include "profiler.h"
 
 // Ticks for a delay of 1 microsecond timer clocked at 2 MHz
 #define TICKS_PER_MICROSECOND 2 // 2 * 0.5 us = 1 us
@@ -194,6 +195,7 @@ uint8_t Onewire__IsIdle(void)
  */
 ISR(TIMER1_COMPA_vect)
 {
+    PROFILER_ENTER(PROFILER_ID_ISR_TIMER1);
     TIMER1__STOP();
 	switch (Onewire_State)
 	{
@@ -251,5 +253,6 @@ ISR(TIMER1_COMPA_vect)
 	        break;
 	    }
 	}
+    PROFILER_EXIT(PROFILER_ID_ISR_TIMER1);
 }
 
@@ -1,193 +1,581 @@
 /**
  * @file radio.c
  *
+ * @brief Non-blocking nRF24L01+ driver
+ *
+ * @details Radio__Send() and Radio__Receive() return immediately, the
+ *          completion is reported through callbacks from the main loop.
+ *
+ *          INT0 only posts EVENT_RADIO_IRQ, the STATUS register is read
+ *          and cleared by Radio__OnIrq(). Register accesses are short
+ *          polled SPI transfers, payloads are moved by the SPI ISR and
+ *          their completion posts EVENT_RADIO_RX_PAYLOAD. The power-on
+ *          reset, power-up and TX timeouts are soft timers checked by
+ *          Radio__1msTask(). No busy-wait delay is left.
+ *
+ *          Up to 6 pipes receive on their own address, pipe 1 is opened on
+ *          the node address by default. Pipe 0 receives the acknowledgments
+ *          on the destination address while sending, its own address is
+ *          restored when back in RX. Pipes 2 to 5 share the address bytes
+ *          1 to 4 of pipe 1, so they differ by node ID only. Received
+ *          payloads are read into pool packets and demultiplexed by
+ *          RX_P_NO into per-pipe queues. When the queues are full or the
+ *          pool is empty they stay in the RX FIFO, which stops the
+ *          acknowledgments until a packet is freed.
+ *
+ *          Payloads have a dynamic length (R_RX_PL_WID), so a frame is only
+ *          as long as its content. In RX the node can piggyback a payload
+ *          on the next auto-ACK of a pipe (W_ACK_PAYLOAD). The ACK payload
+ *          shares the TX FIFO with the payloads to send, so it is flushed
+ *          before each transmission and written again when back in RX.
+ *
+ *          Messages wait in a software queue of pool packets, which
+ *          Radio__SendPacket() takes without copying them. While sending,
+ *          CE stays high and the 3-level TX FIFO is kept full with the next
+ *          messages for the same destination, so the module transmits back
+ *          to back.
+ *          Every IRQ reconciles the queue with the FIFO status and refills
+ *          it. On MAX_RT only the failed message is dropped: the FIFO is
+ *          flushed and the messages behind it are written again.
+ *
+ *          The PA level and retry delay are set per destination by the
+ *          link adaptation (radio_link.c), from the retransmits of the
+ *          messages sent to it.
+ *
+ *          Before sending, the channel is listened to (listen-before-talk):
+ *          while the received power detector (RPD) reports a busy channel
+ *          the transmission is put off by a random, growing backoff. The
+ *          RPD is also sampled while listening, on the own channel and
+ *          now and then on the other channels of the hop sequence, for
+ *          their busy scores (radio_channel.c).
+ *
  * @date 22/09/2014 18:30:05
  * @authors Stefan Engelke, Leonardo Ricupero
- */ 
+ */
 
+#include <string.h>
 #include "micro.h"
-#include "usart.h"
+#include "hal.h"
 #include "spi.h"
+#include "soft_timer.h"
+#include "profiler.h"
+#include "events.h"
+#include "trace.h"
+#include "packet_pool.h"
 #include "radio.h"
+#include "radio_link.h"
+#include "radio_channel.h"
+#include "scheduler.h"
 
 #define DEFAULT_ADDRESS_SIZE 5
+// The first byte is the node ID, set by Radio__Initialize()
 #define DEFAULT_NODE_ADDRESS {0x00, 0x01, 0x02, 0x03, 0x04}
 
+#define DELAY_POWER_ON_RESET 100 // milliseconds
 #define DELAY_TPD2STBY 5 // milliseconds
+// 15 retransmits with the longest retry delay take about 55 ms at 250 kbps
+#define TX_TIMEOUT 80 // milliseconds
+
+// Preamble, 5 bytes address, 9 bits packet control field, 2 bytes CRC
+#define AIR_OVERHEAD_BYTES 10
+#define AIR_BYTES(length) ((uint32_t)(length) + AIR_OVERHEAD_BYTES)
+
+#define ALL_PIPES_MASK ((1 << RADIO_NUM_PIPES) - 1)
 
-#define RADIO_DRIVE_CE_LOW()  {PORTB &= ~(1<<PORTB1);}
-#define RADIO_DRIVE_CE_HIGH() {PORTB |= (1<<PORTB1);}
+#define TX_FIFO_DEPTH 3
+
+// The RPD is valid after 130 us of RX settling and 170 us of listening,
+// at least one full tick
+#define RPD_SETTLING_TICKS 2
+// Busy channel assessments before sending anyway
+#define CCA_MAX_ATTEMPTS 4
+// Period of the RPD samples on the other channels of the hop sequence,
+// jittered so that the scans do not stay in phase with the beacons
+#define SCAN_PERIOD 100 // milliseconds
+#define SCAN_JITTER 16 // milliseconds, power of 2
+
+#define CONFIG_DEFAULT ((1 << BIT_EN_CRC) | (1 << BIT_CRCO))
+#define STATUS_IRQ_MASK ((1 << BIT_RX_DR) | (1 << BIT_TX_DS) | (1 << BIT_MAX_RT))
 
 typedef enum {
-    STATE_INIT = 0,
-    STATE_IDLE,
-    STATE_READING,
-    STATE_CONFIGURING,
-    STATE_ERROR_FOUND,
+    STATE_RESET = 0,   // waiting for the module power-on reset
+    STATE_OFF,         // power down
+    STATE_POWERING_UP, // waiting for the crystal to start
+    STATE_STANDBY,
+    STATE_RX,
+    STATE_CCA,         // listening, waiting for a clear channel to send
+    STATE_TX,
 } RADIO_STATE_T;
 
-typedef union {
-    struct {
-        uint8_t turning_on: 1;
-        uint8_t on :1;
-        uint8_t transmitting :1;
-        uint8_t receiving :1;
-        uint8_t rx_complete :1;
-    };
+static RADIO_STATE_T Radio_State;
+static BOOL_T Power_Requested;
+static uint8_t Config_Register;
+static uint8_t Rf_Setup_Register;
+static uint8_t Setup_Retr_Register;
 
-    uint8_t all;
-} RADIO_EVENTS_T;
+static SOFT_TIMER_T Power_Up_Timer;
+static SOFT_TIMER_T Tx_Timer;
+static SOFT_TIMER_T Cca_Timer;
+static SOFT_TIMER_T Scan_Timer;
 
-static RADIO_STATE_T Radio_State;
-static RADIO_EVENTS_T Radio_Events;
+static uint8_t Rf_Channel_Register;
+static uint8_t Cca_Attempts;
+static BOOL_T Scanning;      // listening on another channel for its RPD
+static BOOL_T Rpd_Latched;   // a packet was received, the RPD is stuck high
+static uint16_t Rx_Start_Tick;
 
 static uint8_t Node_Address[DEFAULT_ADDRESS_SIZE] = DEFAULT_NODE_ADDRESS;
+static uint8_t Pipe_Node_Id[RADIO_NUM_PIPES];
+static uint8_t Pipes_Enabled;
+static uint8_t Tx_Address[DEFAULT_ADDRESS_SIZE];
+
+typedef struct {
+    uint8_t node_id;
+    RADIO_TX_CALLBACK_T callback;
+    PACKET_T* packet; // one reference, released once sent
+} TX_MESSAGE_T;
+
+// Tx_In_Fifo messages from Tx_Head are in the module TX FIFO
+static TX_MESSAGE_T Tx_Queue[RADIO_TX_QUEUE_SIZE];
+static uint8_t Tx_Head;
+static uint8_t Tx_Count;
+static uint8_t Tx_In_Fifo;
+// One payload write chain per FIFO level
+static SPI_TRANSACTION_T Tx_Transactions[TX_FIFO_DEPTH][2];
+static uint8_t Tx_Write_Index;
+
+typedef struct {
+    PACKET_T* packets[RADIO_RX_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+} PIPE_QUEUE_T;
+
+static RADIO_RX_CALLBACK_T Rx_Callback;
+static BOOL_T Rx_Busy;
+static BOOL_T Rx_Stalled; // no free packet, the payload is left in the FIFO
+static volatile BOOL_T Rx_Ready;
+static uint8_t Rx_Pipe;
+static PACKET_T* Rx_Packet; // being read by the SPI
+static uint8_t Rx_Queued;   // in all the pipe queues
+static PIPE_QUEUE_T Pipe_Queues[RADIO_NUM_PIPES];
+static SPI_TRANSACTION_T Rx_Transactions[2];
+
+static BOOL_T Ack_Pending;
+static uint8_t Ack_Pipe;
+static uint8_t Ack_Payload[RADIO_PAYLOAD_SIZE];
+static uint8_t Ack_Length;
 
-static void WriteRegister(uint8_t reg, uint8_t value);
-static void InitializeIRQ(void);
+static RADIO_STATS_T Radio_Stats;
 
-uint8_t* data;
+static const uint8_t Tx_Command = CMD_W_TX_PAYLOAD;
+static const uint8_t Tx_No_Ack_Command = CMD_W_TX_PAYLOAD_NOACK;
+static const uint8_t Rx_Command = CMD_R_RX_PAYLOAD;
+
+static uint8_t Command(uint8_t cmd, const uint8_t* tx, uint8_t* rx, uint8_t n);
+static void WriteRegister(uint8_t reg, const uint8_t* val, uint8_t n_val);
+static uint8_t ReadRegister(uint8_t reg);
+static void Configure(void);
+static void PowerUp(void);
+static void EnterStandby(void);
+static void StartRx(void);
+static void StartTx(void);
+static void SetTxAddress(uint8_t node_id);
+static void WriteLinkSetup(uint8_t node_id);
+static void WriteChannel(uint8_t channel);
+static void RestartRxPeriod(void);
+static BOOL_T IsRpdValid(void);
+static BOOL_T ReadRpd(void);
+static void StartCca(void);
+static void HandleCca(void);
+static void HandleScan(void);
+static void StartScanTimer(void);
+static void RefillTxFifo(void);
+static uint8_t CountSentMessages(uint8_t status);
+static void CompleteTx(uint8_t n, RADIO_STATUS_T status, uint8_t frames);
+static void HandleTxIrq(uint8_t status);
+static void WriteAckPayload(void);
+static void WritePipeAddress(uint8_t pipe);
+static void WriteEnabledPipes(void);
+static void ReadPayload(void);
+static void ResumeRx(void);
+static void RxPayloadCallback(SPI_TRANSACTION_T* transaction);
+static void HandleRxPayload(void);
 
 /**
  * Setup the RF24 module
- * 
- * @brief Edit this function in order to change the initial configuration
- *        of the radio module
- * 
+ *
+ * @brief The module is configured once its power-on reset is over, by
+ *        Radio__1msTask(). Spi__Initialize() must have been called.
  */
 void Radio__Initialize(void)
 {
-	uint8_t val;
-	// Set CE low to start with, because nothing has to be transmitted
-    RADIO_DRIVE_CE_LOW();
-	
-	// EN_AA - (enable auto-acknowledgments)
-	// Transmitter gets automatic response from receiver in case of successful transmission
-	// It only works if the TX module has the same RF_Address on its channel. ex: RX_ADDR_P0 = TX_ADDR
-    val = (1 << BIT_ENAA_P0);
-	WriteRegister(REG_EN_AA, &val, 1);
-	
-	// SETUP_RETR (the setup for "EN_AA")
-	// 0b0010 00011 "2" sets it up to 750uS delay between every retry (at least 500us at 250kbps and if payload >5bytes in 1Mbps, and if payload >15byte in 2Mbps) "F" is number of retries (1-15, now 15)
-	val = (2 << BIT_ARD) | (15 << BIT_ARC); //0x2F;
-	WriteRegister(REG_SETUP_RETR, &val, 1);
-	
-	// Choose the number of the enabled RX data pipe (0-5)
-	val = (1 << BIT_ERX_P0);
-	WriteRegister(REG_EN_RXADDR, &val, 1); // enable data pipe 0
-	
-	// RF_Address width setup: how many bytes is the receiver address
-	val = (0x03 << BIT_AW);
-	WriteRegister(REG_SETUP_AW, &val, 1); // 5byte RF Address
-	
-	// RF channel setup - choose frequency 2.401 - 2.527 GHz, 1 MHz/step
-	val = 0x4C;
-	WriteRegister(REG_RF_CH, &val, 1); // 0b1101 0100 = 2,476 GHz (same on TX and RX)
-	
-	//RF setup - choose power mode and data speed
-	val = (0 << BIT_RF_DR_HIGH) | (3 << BIT_RF_PWR); //0x07;
-	WriteRegister(REG_RF_SETUP, &val, 1); //0b0000 0111 bit 3="0" 1Mbps=longer range, bit 2-1 power mode ("11" = 0dB)
-	
-	// RX RF_Adress width setup 5 byte - set receiver address (set RX_ADDR_P0 = TX_ADDR if EN_AA is enabled)
-	// Address = 0x01 00 01 00 01
-	// Since we chose pipe 0 and 1 on EN_RXADDR, we give this address to those channels.
-	// P1 is the primary receiver address.
-	// It is possible to assign different addresses to different channels (if they are enabled in EN_RXADDR) in order
-	// to listen on several different transmitters
-	WriteRegister(REG_RX_ADDR_P0, Node_Address, DEFAULT_ADDRESS_SIZE);
-	
-	// TX RF_Adress setup 5 byte - set TX address
-	// Not used in a receiver but can be set anyway. Equal to Rx address
-	WriteRegister(REG_TX_ADDR, Node_Address, DEFAULT_ADDRESS_SIZE);
-	
-//	// Enable dynamic payload length and payload with ack packet
-//	val[0] = 0x06;
-//	WriteRegister(REG_FEATURE, val, 1); // 0b0000 0110: EN_DPL = 1, EN_ACK_PAY = 1
-//
-//	// Choose the pipes with dynamic payload length. 0 and 1.
-//	val[0] = 0x03;
-//	RF24ReadWrite(DYNPD, val, 1);
-	
-	/*
-	// Payload width setup - how many bytes to send per transmission (1-32)
-	val[0] = 32;	// 32 bytes per package (same on RX and TX)
-	RF24ReadWrite(W, RX_PW_P0, val, 1);
-	*/
-	
-	// CONFIG reg setup - boot up the nRF24L01 and choose if it is a transmitter or a receiver
-	val = (0 << BIT_PRIM_RX) | (0 << BIT_PWR_UP) | (1 << BIT_MASK_MAX_RT);
-	WriteRegister(REG_CONFIG, &val, 1);
-	
-	InitializeIRQ();
-
-	Radio_State = STATE_INIT;
-	Radio_Events.all = 0;
+	// Set CE low to start with, because nothing has to be transmitted,
+	// INT0 on the falling edge of IRQ
+    Hal__InitializeRadioPins();
+    Hal__DriveRadioCeLow();
+
+    Power_Requested = FALSE;
+    RadioLink__Initialize();
+    RadioChannel__Initialize();
+    Scanning = FALSE;
+    Node_Address[0] = RADIO_NODE_ID;
+    memcpy(Tx_Address, Node_Address, DEFAULT_ADDRESS_SIZE);
+    Tx_Head = 0;
+    Tx_Count = 0;
+    Tx_In_Fifo = 0;
+    Tx_Write_Index = 0;
+    Rx_Callback = NULL;
+    Rx_Busy = FALSE;
+    Rx_Stalled = FALSE;
+    Rx_Ready = FALSE;
+    Rx_Packet = NULL;
+    Rx_Queued = 0;
+    memset(Pipe_Queues, 0, sizeof(Pipe_Queues));
+    memset(Pipe_Node_Id, 0, sizeof(Pipe_Node_Id));
+    Pipe_Node_Id[1] = RADIO_NODE_ID;
+    Pipes_Enabled = (1 << 1);
+    Ack_Pending = FALSE;
+    memset(&Radio_Stats, 0, sizeof(Radio_Stats));
+
+    SoftTimer__StartOneShot(&Power_Up_Timer, DELAY_POWER_ON_RESET, NULL);
+    StartScanTimer();
+	Radio_State = STATE_RESET;
 }
 
 void Radio__TurnOn(void)
 {
-    uint8_t val;
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    Power_Requested = TRUE;
+    if (Radio_State == STATE_OFF)
     {
-        // fixme read config first
-        val = (1 << BIT_PWR_UP);
-        WriteRegister(REG_CONFIG, &val, 1);
-        Radio_Events.turning_on = 1;
+        PowerUp();
     }
 }
 
+/**
+ * @brief Power down the module
+ *
+ * @details The queued messages are kept and sent once the radio is on
+ *          again. The ones in the TX FIFO are written again then, so they
+ *          may be received twice.
+ */
 void Radio__TurnOff(void)
 {
-    uint8_t val;
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    Power_Requested = FALSE;
+    if (Radio_State > STATE_OFF)
+    {
+        Hal__DriveRadioCeLow();
+        SoftTimer__Stop(&Power_Up_Timer);
+        SoftTimer__Stop(&Tx_Timer);
+        SoftTimer__Stop(&Cca_Timer);
+        Config_Register &= ~(1 << BIT_PWR_UP);
+        WriteRegister(REG_CONFIG, &Config_Register, 1);
+        Tx_In_Fifo = 0;
+        Radio_State = STATE_OFF;
+    }
+}
+
+BOOL_T Radio__IsOn(void)
+{
+    return (Radio_State >= STATE_STANDBY) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Queue a payload for a node
+ *
+ * @details The callback is called once the payload is acknowledged or the
+ *          retransmits are exhausted. Payloads for RADIO_BROADCAST_ID are
+ *          sent once, with no ACK, and always reported sent. The queue is sent while the radio
+ *          is on, consecutive messages for the same node back to back.
+ *
+ * @return FALSE if the queue is full, the packet pool is empty or the
+ *         length is not 1 to RADIO_PAYLOAD_SIZE
+ */
+BOOL_T Radio__Send(uint8_t node_id, const uint8_t* payload, uint8_t length, RADIO_TX_CALLBACK_T callback)
+{
+    PACKET_T* packet;
+    BOOL_T result = FALSE;
+
+    if (Tx_Count < RADIO_TX_QUEUE_SIZE && length > 0 && length <= RADIO_PAYLOAD_SIZE)
+    {
+        packet = PacketPool__Alloc();
+        if (packet != NULL)
+        {
+            memcpy(packet->data, payload, length);
+            packet->length = length;
+            result = Radio__SendPacket(node_id, packet, callback);
+            PacketPool__Release(packet);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Queue a packet for a node, without copying it
+ *
+ * @details As Radio__Send(). The queue takes its own reference to the
+ *          packet, so the caller still releases its one.
+ */
+BOOL_T Radio__SendPacket(uint8_t node_id, PACKET_T* packet, RADIO_TX_CALLBACK_T callback)
+{
+    TX_MESSAGE_T* message;
+    BOOL_T result = FALSE;
+
+    if (Tx_Count < RADIO_TX_QUEUE_SIZE && packet->length > 0 && packet->length <= RADIO_PAYLOAD_SIZE)
+    {
+        message = &Tx_Queue[(Tx_Head + Tx_Count) % RADIO_TX_QUEUE_SIZE];
+        message->node_id = node_id;
+        message->callback = callback;
+        message->packet = packet;
+        PacketPool__Retain(packet);
+        Tx_Count++;
+        TRACE(TRACE_RADIO_TX, node_id, packet->length);
+
+        // While sending, the FIFO is refilled on the next IRQ
+        if (Radio_State == STATE_STANDBY || Radio_State == STATE_RX)
+        {
+            StartCca();
+        }
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Whether messages are queued, sent once the radio is on
+ */
+BOOL_T Radio__IsTxPending(void)
+{
+    return (Tx_Count > 0) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Listen on the open pipes when not sending
+ *
+ * @param callback  Called when a payload is queued on a pipe, NULL to stop
+ *                  listening
+ */
+void Radio__Receive(RADIO_RX_CALLBACK_T callback)
+{
+    Rx_Callback = callback;
+    if (callback != NULL && Radio_State == STATE_STANDBY)
+    {
+        StartRx();
+    }
+    else if (callback == NULL && Radio_State == STATE_RX)
+    {
+        Hal__DriveRadioCeLow();
+        Radio_State = STATE_STANDBY;
+    }
+}
+
+/**
+ * @brief Set the payload sent with the next auto-ACK on a pipe
+ *
+ * @details Replaces the previous one if it has not been sent yet. Any
+ *          node sending to the pipe address may get it.
+ *
+ * @return FALSE if the pipe is not valid or the length is not 1 to
+ *         RADIO_PAYLOAD_SIZE
+ */
+BOOL_T Radio__SetAckPayload(uint8_t pipe, const uint8_t* payload, uint8_t length)
+{
+    BOOL_T result = FALSE;
+
+    if (pipe < RADIO_NUM_PIPES && length > 0 && length <= RADIO_PAYLOAD_SIZE)
+    {
+        memcpy(Ack_Payload, payload, length);
+        Ack_Length = length;
+        Ack_Pipe = pipe;
+        Ack_Pending = TRUE;
+        if (Radio_State == STATE_RX)
+        {
+            WriteAckPayload();
+        }
+        result = TRUE;
+    }
+
+    return result;
+}
+
+BOOL_T Radio__IsAckPayloadPending(void)
+{
+    return Ack_Pending;
+}
+
+void Radio__GetStats(RADIO_STATS_T* stats)
+{
+    *stats = Radio_Stats;
+}
+
+/**
+ * @brief Move to another channel of the hop sequence
+ *
+ * @details Applied at once when listening, otherwise once the messages
+ *          being sent are done
+ *
+ * @return FALSE if the hop is not valid
+ */
+BOOL_T Radio__SetHop(uint8_t hop)
+{
+    BOOL_T result = RadioChannel__SetHop(hop);
+
+    if (result && Radio_State == STATE_RX)
+    {
+        StartRx();
+    }
+
+    return result;
+}
+
+/**
+ * @brief Receive on a pipe, on the address of the given node ID
+ *
+ * @details The address bytes 1 to 4 are the same for all the pipes
+ *
+ * @return FALSE if the pipe is not valid
+ */
+BOOL_T Radio__OpenPipe(uint8_t pipe, uint8_t node_id)
+{
+    BOOL_T result = FALSE;
+
+    if (pipe < RADIO_NUM_PIPES)
+    {
+        Pipe_Node_Id[pipe] = node_id;
+        Pipes_Enabled |= (1 << pipe);
+        // Written by Configure() after the reset. While sending, pipe 0
+        // is written by StartRx().
+        if (Radio_State > STATE_RESET)
+        {
+            if (pipe != 0 || Radio_State != STATE_TX)
+            {
+                WritePipeAddress(pipe);
+            }
+            WriteEnabledPipes();
+        }
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Stop receiving on a pipe, its queued payloads can still be read
+ */
+void Radio__ClosePipe(uint8_t pipe)
+{
+    if (pipe < RADIO_NUM_PIPES)
+    {
+        Pipes_Enabled &= ~(1 << pipe);
+        if (Radio_State > STATE_RESET)
+        {
+            WriteEnabledPipes();
+        }
+    }
+}
+
+/**
+ * @brief Copy out the oldest payload queued on a pipe
+ *
+ * @param payload  Buffer of RADIO_PAYLOAD_SIZE bytes
+ *
+ * @return The payload length, 0 if the queue is empty
+ */
+uint8_t Radio__Read(uint8_t pipe, uint8_t* payload)
+{
+    PACKET_T* packet = Radio__ReadPacket(pipe);
+    uint8_t length = 0;
+
+    if (packet != NULL)
+    {
+        length = packet->length;
+        memcpy(payload, packet->data, length);
+        PacketPool__Release(packet);
+    }
+
+    return length;
+}
+
+/**
+ * @brief Take the oldest packet queued on a pipe
+ *
+ * @return The packet, whose reference goes to the caller, NULL if the
+ *         queue is empty
+ */
+PACKET_T* Radio__ReadPacket(uint8_t pipe)
+{
+    PIPE_QUEUE_T* queue;
+    PACKET_T* packet = NULL;
+
+    if (pipe < RADIO_NUM_PIPES && Pipe_Queues[pipe].count > 0)
     {
-        // fixme read config first
-        val = (0 << BIT_PWR_UP);
-        WriteRegister(REG_CONFIG, &val, 1);
-        Radio_Events.on = 0;
+        queue = &Pipe_Queues[pipe];
+        packet = queue->packets[queue->head];
+        queue->head = (queue->head + 1) % RADIO_RX_QUEUE_SIZE;
+        queue->count--;
+        Rx_Queued--;
+        ResumeRx();
     }
+
+    return packet;
+}
+
+uint8_t Radio__GetQueuedCount(uint8_t pipe)
+{
+    return (pipe < RADIO_NUM_PIPES) ? Pipe_Queues[pipe].count : 0;
 }
 
 void Radio__1msTask(void)
 {
-    static down_counter = 0;
-    RADIO_STATE_T next_state = Radio_State;
+    // Packets freed by the other modules
+    ResumeRx();
 
     switch (Radio_State)
     {
-        case STATE_INIT:
+        case STATE_RESET:
         {
-            if (Spi__IsTxBufferEmpty())
+            if (SoftTimer__IsExpired(&Power_Up_Timer))
             {
-                next_state = STATE_IDLE;
+                Configure();
+                Radio_State = STATE_OFF;
+                if (Power_Requested)
+                {
+                    PowerUp();
+                }
             }
             break;
         }
-        case STATE_IDLE:
+        case STATE_POWERING_UP:
         {
-            if (Radio_Events.turning_on)
+            if (SoftTimer__IsExpired(&Power_Up_Timer))
             {
-                down_counter = DELAY_TPD2STBY;
-                next_state = STATE_CONFIGURING;
+                EnterStandby();
             }
             break;
         }
-        case STATE_CONFIGURING:
+        case STATE_RX:
         {
-            down_counter--;
-            if (down_counter == 0)
-            {
-                if (Radio_Events.turning_on)
-                {
-                    Radio_Events.turning_on = 0;
-                    Radio_Events.on = 1;
-                    next_state = STATE_IDLE;
-                }
-            }
+            HandleScan();
+            break;
+        }
+        case STATE_CCA:
+        {
+            HandleCca();
             break;
         }
-        case STATE_READING:
+        case STATE_TX:
         {
+            // The IRQ never came, the module may have been reset:
+            // drop the first message and start again from the next one
+            if (SoftTimer__IsExpired(&Tx_Timer))
+            {
+                Hal__DriveRadioCeLow();
+                Command(CMD_FLUSH_TX, NULL, NULL, 0);
+                CompleteTx(1, RADIO_STATUS_ERROR, 0);
+                Tx_In_Fifo = 0;
+                EnterStandby();
+            }
             break;
         }
         default:
@@ -196,185 +584,769 @@ void Radio__1msTask(void)
         }
     }
 
-    Radio_State = next_state;
-
+    // In case EVENT_RADIO_IRQ or EVENT_RADIO_RX_PAYLOAD has been lost:
+    // INT0 is edge triggered, the IRQ line would stay low
+    if (Hal__IsRadioIrqActive())
+    {
+        Radio__OnIrq(NULL);
+    }
+    HandleRxPayload();
 }
 
 /**
- * \brief Read a register value from nRF24L01
+ * @brief Handle the radio IRQ
  *
- * \param reg
+ * Called by the event dispatcher after a data receive or transmission
  *
- * \return uint8_t
+ * @return void
+ */
+void Radio__OnIrq(const EVENT_T* event)
+{
+    uint8_t status;
+    uint8_t flags;
+
+    if (Radio_State == STATE_RESET)
+    {
+        return;
+    }
+
+    status = Command(CMD_NOP, NULL, NULL, 0);
+    flags = status & STATUS_IRQ_MASK;
+    if (Radio_State == STATE_TX && (status & (1 << BIT_MAX_RT)))
+    {
+        // With CE high, clearing MAX_RT sends the failed payload again:
+        // hold the module in standby until the FIFO has been flushed
+        Hal__DriveRadioCeLow();
+    }
+    if (flags != 0)
+    {
+        // Flags are cleared writing 1
+        WriteRegister(REG_STATUS, &flags, 1);
+    }
+
+    if (status & (1 << BIT_RX_DR))
+    {
+        Rpd_Latched = TRUE;
+    }
+    if ((status & (1 << BIT_RX_DR)) && !Rx_Busy)
+    {
+        Rx_Stalled = FALSE;
+        ReadPayload();
+    }
+
+    if (Radio_State == STATE_TX)
+    {
+        if (status & ((1 << BIT_TX_DS) | (1 << BIT_MAX_RT)))
+        {
+            HandleTxIrq(status);
+        }
+    }
+    else if ((Radio_State == STATE_RX || Radio_State == STATE_CCA) && (status & (1 << BIT_TX_DS)))
+    {
+        // In RX, TX_DS signals that the ACK payload has been sent
+        Ack_Pending = FALSE;
+        Radio_Stats.ack_payloads_sent++;
+    }
+}
+
+/**
+ * @brief Handle the completion of a payload read
  */
-uint8_t RF24GetReg(uint8_t reg)
+void Radio__OnRxPayload(const EVENT_T* event)
 {
-	_delay_us(10);
-	Spi__PutChar(R_REGISTER + reg);	// R_REGISTER = set the RF24 to reading mode, "reg" is the register that will be read back
-	_delay_us(10);
-	Spi__WriteThenRead(NOP); // Send a NOP (dummy byte) in order to read the first byte of the register "reg"
-	reg = Spi__GetChar();
-	_delay_us(10);
-	return reg;	// Return the read register
+    HandleRxPayload();
 }
 
 /**
- * \brief Write to or Read from nRF24L01
+ * \brief Execute a command on the nRF24L01
  *
- * \param ReadWrite		Specifies if we want to read ("R") or write ("W") to the register
- * \param reg			The register to read or write
- * \param val			array to read or write
- * \param nVal			size of the array
+ * The command byte and its data bytes are transferred as one SPI chain,
+ * so CSN stays low for the whole command. Register accesses are short
+ * enough to be polled by Spi__Transfer().
  *
- * \return uint8_t *	array of bytes read
+ * \param cmd			Command byte
+ * \param tx			Data bytes to write, NULL to clock out NOPs
+ * \param rx			Buffer for the bytes read, NULL to discard them
+ * \param n			Number of data bytes
+ *
+ * \return uint8_t		STATUS register shifted out with the command byte
  */
-uint8_t *RF24ReadWrite(uint8_t ReadWrite, uint8_t reg, uint8_t *val, uint8_t nVal)
+static uint8_t Command(uint8_t cmd, const uint8_t* tx, uint8_t* rx, uint8_t n)
 {
-    //! A static uint8_t is needed to return an array
-    static uint8_t ret[DATA_LEN];
-
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    uint8_t status;
+    SPI_TRANSACTION_T data_transaction =
     {
-	//! If "W" we want to write to nRF24. No need to "R" mode because R=0x00
-	if (ReadWrite == W)
-	{
-		reg = W_REGISTER + reg;	//ex: reg = EN_AA: 0b0010 0000 + 0b0000 0001 = 0b0010 0001
-	}
+        .device = SPI_DEVICE_RADIO,
+        .tx = tx,
+        .rx = rx,
+        .length = n,
+        .flags = 0,
+        .callback = NULL,
+        .next = NULL,
+    };
+    SPI_TRANSACTION_T cmd_transaction =
+    {
+        .device = SPI_DEVICE_RADIO,
+        .tx = &cmd,
+        .rx = &status,
+        .length = 1,
+        .flags = 0,
+        .callback = NULL,
+        .next = (n > 0) ? &data_transaction : NULL,
+    };
+
+    Spi__Transfer(&cmd_transaction);
+    return status;
+}
+
+static void WriteRegister(uint8_t reg, const uint8_t* val, uint8_t n_val)
+{
+    Command(CMD_W_REGISTER | (reg & CMD_REGISTER_MASK), val, NULL, n_val);
+}
+
+static uint8_t ReadRegister(uint8_t reg)
+{
+    uint8_t value;
 
-	//! Makes sure we wait a bit
-	_delay_us(10);
-	Spi__PutChar(reg);	// set to write or read mode the register "reg"
-	_delay_us(10);
+    Command(CMD_R_REGISTER | (reg & CMD_REGISTER_MASK), NULL, &value, 1);
+    return value;
+}
+
+/**
+ * @brief Write the initial configuration, the module is left powered down
+ *
+ * @details Edit this function in order to change the initial configuration
+ *          of the radio module
+ */
+static void Configure(void)
+{
+	uint8_t val;
+	uint8_t pipe;
 
-	int i;
-	for(i=0; i < nVal; i++)
+	// EN_AA - (enable auto-acknowledgments)
+	// Transmitter gets automatic response from receiver in case of successful transmission
+	// It only works if the TX module has the same RF_Address on its channel. ex: RX_ADDR_P0 = TX_ADDR
+    val = ALL_PIPES_MASK;
+	WriteRegister(REG_EN_AA, &val, 1);
+
+	// RF_Address width setup: how many bytes is the receiver address
+	val = (0x03 << BIT_AW);
+	WriteRegister(REG_SETUP_AW, &val, 1); // 5byte RF Address
+
+	// Choose the enabled RX data pipes (0-5) and their addresses
+	// Pipe 1 first, pipes 2 to 5 take its address bytes 1 to 4
+	for (pipe = 1; pipe <= RADIO_NUM_PIPES; pipe++)
 	{
-		// We want to read a register
-		if (ReadWrite == R && reg != W_TX_PAYLOAD)
-		{
-			// Send dummy bytes to read the data
-		    Spi__WriteThenRead(NOP);
-			ret[i] = Spi__GetChar();
-			_delay_us(10);
-		}
-		else
-		{
-		    Spi__PutChar(val[i]);
-			_delay_us(10);
-		}
+	    WritePipeAddress(pipe % RADIO_NUM_PIPES);
 	}
+	WriteEnabledPipes();
+
+	// RF channel setup - choose frequency 2.400 - 2.525 GHz, 1 MHz/step
+	// First channel of the hop sequence, the same on all the nodes
+	Rf_Channel_Register = RadioChannel__GetChannel();
+	WriteRegister(REG_RF_CH, &Rf_Channel_Register, 1);
+
+	// RF_SETUP (data rate and PA level) and SETUP_RETR (retry delay and
+	// count), rewritten before sending to each node by the link adaptation
+	Rf_Setup_Register = RadioLink__GetRfSetup(RADIO_LINK_NO_NODE);
+	WriteRegister(REG_RF_SETUP, &Rf_Setup_Register, 1);
+	Setup_Retr_Register = RadioLink__GetSetupRetr(RADIO_LINK_NO_NODE);
+	WriteRegister(REG_SETUP_RETR, &Setup_Retr_Register, 1);
+
+	// Enable dynamic payload length, payload with ack packet and
+	// payloads without ack (broadcasts)
+	val = (1 << BIT_EN_DPL) | (1 << BIT_EN_ACK_PAY) | (1 << BIT_EN_DYN_ACK);
+	WriteRegister(REG_FEATURE, &val, 1);
+
+	// Choose the pipes with dynamic payload length, all of them.
+	// The RX_PW_Px widths are not used then.
+	val = ALL_PIPES_MASK;
+	WriteRegister(REG_DYNPD, &val, 1);
+
+	// Start from empty FIFOs and no pending IRQ
+	Command(CMD_FLUSH_TX, NULL, NULL, 0);
+	Command(CMD_FLUSH_RX, NULL, NULL, 0);
+	val = STATUS_IRQ_MASK;
+	WriteRegister(REG_STATUS, &val, 1);
+
+	// CONFIG reg setup - 2 bytes CRC, all the IRQs enabled, powered down
+	Config_Register = CONFIG_DEFAULT;
+	WriteRegister(REG_CONFIG, &Config_Register, 1);
+}
+
+static void PowerUp(void)
+{
+    Config_Register |= (1 << BIT_PWR_UP);
+    WriteRegister(REG_CONFIG, &Config_Register, 1);
+    SoftTimer__StartOneShot(&Power_Up_Timer, DELAY_TPD2STBY, NULL);
+    // No scan right after waking up, when a duty-cycled node expects the
+    // beacon
+    StartScanTimer();
+    Radio_State = STATE_POWERING_UP;
+}
+
+/**
+ * @brief Go to standby, then start the pending transmission or listen
+ */
+static void EnterStandby(void)
+{
+    Hal__DriveRadioCeLow();
+    Radio_State = STATE_STANDBY;
+
+    if (Tx_Count > 0)
+    {
+        StartCca();
+    }
+    else if (Rx_Callback != NULL)
+    {
+        StartRx();
+    }
+}
+
+static void StartRx(void)
+{
+    // Stop receiving on the address of the last destination
+    Hal__DriveRadioCeLow();
+    Radio_State = STATE_STANDBY;
+    Scanning = FALSE;
+    WriteChannel(RadioChannel__GetChannel());
+    WriteEnabledPipes();
+    WriteLinkSetup(RADIO_LINK_NO_NODE);
+    if (Pipes_Enabled & (1 << 0))
+    {
+        WritePipeAddress(0);
+    }
+    Config_Register |= (1 << BIT_PRIM_RX);
+    WriteRegister(REG_CONFIG, &Config_Register, 1);
+    if (Ack_Pending)
+    {
+        WriteAckPayload();
+    }
+    RestartRxPeriod();
+    Radio_State = STATE_RX;
+}
+
+/**
+ * @brief Start sending the queued messages
+ *
+ * @details CE is raised right after the payload writes are queued: the
+ *          module waits in standby-II until the TX FIFO is not empty,
+ *          then transmits. CE stays high until the queue is empty.
+ */
+static void StartTx(void)
+{
+    Hal__DriveRadioCeLow();
+    SoftTimer__Stop(&Cca_Timer);
+    Scanning = FALSE;
+    WriteChannel(RadioChannel__GetChannel());
+    Config_Register &= ~(1 << BIT_PRIM_RX);
+    WriteRegister(REG_CONFIG, &Config_Register, 1);
+    // Drop the ACK payload, it would be sent as a normal payload
+    Command(CMD_FLUSH_TX, NULL, NULL, 0);
+    Radio_State = STATE_TX;
+    WriteEnabledPipes();
+    Tx_In_Fifo = 0;
+    SetTxAddress(Tx_Queue[Tx_Head].node_id);
+    RefillTxFifo();
+
+    Hal__DriveRadioCeHigh();
+    SoftTimer__StartOneShot(&Tx_Timer, TX_TIMEOUT, NULL);
+}
+
+/**
+ * @brief Set the destination, pipe 0 receives its acknowledgments
+ */
+static void SetTxAddress(uint8_t node_id)
+{
+    Tx_Address[0] = node_id;
+    WriteRegister(REG_TX_ADDR, Tx_Address, DEFAULT_ADDRESS_SIZE);
+    WriteRegister(REG_RX_ADDR_P0, Tx_Address, DEFAULT_ADDRESS_SIZE);
+    WriteLinkSetup(node_id);
+}
+
+/**
+ * @brief Write the PA level and retry delay of a node, if they changed
+ */
+static void WriteLinkSetup(uint8_t node_id)
+{
+    uint8_t val;
+
+    val = RadioLink__GetRfSetup(node_id);
+    if (val != Rf_Setup_Register)
+    {
+        Rf_Setup_Register = val;
+        WriteRegister(REG_RF_SETUP, &Rf_Setup_Register, 1);
     }
+    val = RadioLink__GetSetupRetr(node_id);
+    if (val != Setup_Retr_Register)
+    {
+        Setup_Retr_Register = val;
+        WriteRegister(REG_SETUP_RETR, &Setup_Retr_Register, 1);
+    }
+}
 
-	return ret;
+static void WriteChannel(uint8_t channel)
+{
+    if (channel != Rf_Channel_Register)
+    {
+        Rf_Channel_Register = channel;
+        WriteRegister(REG_RF_CH, &Rf_Channel_Register, 1);
+    }
 }
 
+/**
+ * @brief Raise CE again, so that the RPD measures from now on
+ */
+static void RestartRxPeriod(void)
+{
+    Hal__DriveRadioCeLow();
+    Hal__DriveRadioCeHigh();
+    Rpd_Latched = FALSE;
+    Rx_Start_Tick = Scheduler__GetTickCount();
+}
 
+static BOOL_T IsRpdValid(void)
+{
+    return ((uint16_t)(Scheduler__GetTickCount() - Rx_Start_Tick) >= RPD_SETTLING_TICKS) ? TRUE : FALSE;
+}
 
 /**
- * \brief Transmit a data packet with the radio module
- * 
- * \param WBuff
- * 
- * \return void
+ * @return TRUE if the power on the channel is over -64 dBm
  */
-void RF24TransmitPayload(uint8_t *WBuff)
+static BOOL_T ReadRpd(void)
 {
-	// Sends 0xE1 to flush the register from old data
-	RF24ReadWrite(R, FLUSH_TX, WBuff, 0);
-	// Sends data in WBuff to the module
-	// Note that FLUSH_TX and W_TX_PAYLOAD are sent with "R" instead of "W" because
-	// they are on the highest byte-level in the nRF
-	RF24ReadWrite(R, W_TX_PAYLOAD, WBuff, 5);
-	
-	_delay_ms(10);
-	// CE high = transmit the data
-	PORTB |= (1 << PORTB1);
-	_delay_us(20);
-	// CE low = stop transmitting
-	PORTB &= ~(1 << PORTB1);
-	_delay_ms(10);
+    return (ReadRegister(RPD) & 0x01) ? TRUE : FALSE;
 }
 
 /**
- * \brief Receive a data packet with the radio module
- * 
- * 
- * \return void
+ * @brief Listen before sending the queued messages
  */
-void RF24ReceivePayload(void)
+static void StartCca(void)
 {
-	// CE high = listens for data
-	PORTB |= (1 << PORTB1);
-	// listens for 1 sec
-	_delay_ms(1000);
-	// CE low = stop listening
-	PORTB &= ~(1 << PORTB1);
+    if (Radio_State != STATE_RX || Scanning)
+    {
+        StartRx();
+    }
+    Cca_Attempts = 0;
+    Radio_State = STATE_CCA;
+    HandleCca();
 }
 
 /**
- * \brief Reset IRQ on the nRF24L01
+ * @brief Send if the channel is clear, otherwise back off for a random time
  *
- * 
- * \return void
+ * @details After a received packet the RPD stays high until CE is lowered,
+ *          the channel is taken as busy then. Once CCA_MAX_ATTEMPTS
+ *          assessments have found it busy, the messages are sent anyway:
+ *          the retransmits are left to cope with it.
  */
-void RF24ResetIRQ(void)
+static void HandleCca(void)
 {
-	// Write to STATUS register
-	Spi__PutChar(W_REGISTER + STATUS);
-	_delay_us(10);
-	// Reset all IRQ in STATUS register
-	Spi__PutChar(0x70);
-	_delay_us(10);
+    BOOL_T busy;
+
+    if (SoftTimer__IsRunning(&Cca_Timer) || !IsRpdValid())
+    {
+        return;
+    }
+
+    busy = Rpd_Latched || ReadRpd();
+    if (!Rpd_Latched)
+    {
+        RadioChannel__AddSample(Rf_Channel_Register, busy);
+    }
+
+    if (!busy)
+    {
+        StartTx();
+    }
+    else if (Cca_Attempts >= CCA_MAX_ATTEMPTS)
+    {
+        Radio_Stats.cca_forced++;
+        StartTx();
+    }
+    else
+    {
+        Cca_Attempts++;
+        Radio_Stats.cca_busy++;
+        RestartRxPeriod();
+        SoftTimer__StartOneShot(&Cca_Timer, RadioChannel__GetBackoff(Cca_Attempts), NULL);
+    }
 }
 
-static void WriteRegister(uint8_t reg, uint8_t* val, uint8_t n_val)
+/**
+ * @brief Sample the RPD while listening, now and then on another channel
+ *
+ * @details The listening channel is sampled on every tick. Every
+ *          SCAN_PERIOD, the next channel of the hop sequence is listened
+ *          to for one sample; the packets sent meanwhile are retransmitted.
+ */
+static void HandleScan(void)
 {
-    uint8_t i;
+    BOOL_T busy;
+
+    if (!IsRpdValid())
+    {
+        return;
+    }
+
+    // After a received packet the listening channel is sampled again
+    // from the next scan, which lowers CE
+    if (!Rpd_Latched)
+    {
+        busy = ReadRpd();
+        RadioChannel__AddSample(Rf_Channel_Register, busy);
+    }
 
-    reg = CMD_W_REGISTER + reg;
-    Spi__PutChar(reg);
-    for (i = 0; i < n_val; i++)
+    if (Scanning)
     {
-        Spi__PutChar(val[i]);
+        Scanning = FALSE;
+        Hal__DriveRadioCeLow();
+        WriteChannel(RadioChannel__GetChannel());
+        RestartRxPeriod();
+    }
+    else if (SoftTimer__IsExpired(&Scan_Timer))
+    {
+        StartScanTimer();
+        Scanning = TRUE;
+        Hal__DriveRadioCeLow();
+        WriteChannel(RadioChannel__GetScanChannel());
+        RestartRxPeriod();
     }
 }
 
-static void InitializeIRQ(void)
+static void StartScanTimer(void)
 {
-    // INT0 init
-    DDRD &= ~(1 << DDD2);
-    // INT0 falling edge PD2
-    EICRA |=  (1<<ISC01);
-    EICRA  &=  ~(1<<ISC00);
-    // Enable IRQ INT0
-    EIMSK |=  (1<<INT0);
+    SoftTimer__StartOneShot(&Scan_Timer, SCAN_PERIOD - SCAN_JITTER / 2 +
+                            (RadioChannel__GetRandom() & (SCAN_JITTER - 1)), NULL);
 }
 
 /**
- * @brief ISR on INT0
+ * @brief Write the next queued messages up to a full TX FIFO
  *
- * This is called when successful data receive or transmission
- * happened
+ * @details All the payloads in the FIFO go to the same address, the
+ *          destination changes only once the FIFO is empty
+ */
+static void RefillTxFifo(void)
+{
+    TX_MESSAGE_T* message;
+    SPI_TRANSACTION_T* chain;
+
+    while (Tx_In_Fifo < Tx_Count && Tx_In_Fifo < TX_FIFO_DEPTH)
+    {
+        message = &Tx_Queue[(Tx_Head + Tx_In_Fifo) % RADIO_TX_QUEUE_SIZE];
+        if (message->node_id != Tx_Address[0])
+        {
+            if (Tx_In_Fifo > 0)
+            {
+                break;
+            }
+            Hal__DriveRadioCeLow();
+            SetTxAddress(message->node_id);
+            Hal__DriveRadioCeHigh();
+        }
+
+        // The chain written three messages ago is complete: its payload
+        // has left the FIFO, or the FIFO was flushed after it
+        chain = Tx_Transactions[Tx_Write_Index];
+        Tx_Write_Index = (Tx_Write_Index + 1) % TX_FIFO_DEPTH;
+        chain[0] = (SPI_TRANSACTION_T){
+            .device = SPI_DEVICE_RADIO,
+            .tx = (message->node_id == RADIO_BROADCAST_ID) ? &Tx_No_Ack_Command : &Tx_Command,
+            .length = 1,
+            .next = &chain[1],
+        };
+        chain[1] = (SPI_TRANSACTION_T){
+            .device = SPI_DEVICE_RADIO,
+            .tx = message->packet->data,
+            .length = message->packet->length,
+        };
+        Spi__Submit(&chain[0]);
+        Tx_In_Fifo++;
+    }
+}
+
+/**
+ * @brief Number of messages that left the TX FIFO since the last IRQ
  *
- * @todo Avoid 0.5 sec delay
+ * @details The FIFO status only tells empty, full or neither. If two ACKs
+ *          came before the IRQ was handled with a full FIFO, one message
+ *          is counted now and the other one once the FIFO is empty. After
+ *          MAX_RT the failed payload is still in the FIFO.
+ */
+static uint8_t CountSentMessages(uint8_t status)
+{
+    uint8_t fifo_status = ReadRegister(REG_FIFO_STATUS);
+    uint8_t left;
+
+    if (fifo_status & (1 << BIT_TX_EMPTY))
+    {
+        left = 0;
+    }
+    else if (fifo_status & (1 << BIT_FIFO_FULL))
+    {
+        left = TX_FIFO_DEPTH;
+    }
+    else
+    {
+        left = Tx_In_Fifo;
+        if (status & (1 << BIT_TX_DS))
+        {
+            left--;
+        }
+        if (left < 1)
+        {
+            left = 1;
+        }
+        else if (left > TX_FIFO_DEPTH - 1)
+        {
+            left = TX_FIFO_DEPTH - 1;
+        }
+    }
+
+    return (left < Tx_In_Fifo) ? (Tx_In_Fifo - left) : 0;
+}
+
+/**
+ * @brief Remove the first n messages of the queue and report them
  *
- * @return void
+ * @param frames  On-air frames of the last message, retransmits included
  */
-ISR(INT0_vect)
+static void CompleteTx(uint8_t n, RADIO_STATUS_T status, uint8_t frames)
+{
+    TX_MESSAGE_T* message;
+    RADIO_TX_CALLBACK_T callback;
+
+    while (n > 0 && Tx_Count > 0)
+    {
+        message = &Tx_Queue[Tx_Head];
+        callback = message->callback;
+        n--;
+        if (n > 0)
+        {
+            frames = 1;
+        }
+        Radio_Stats.tx_messages++;
+        Radio_Stats.tx_frames += frames;
+        Radio_Stats.tx_air_bytes += frames * AIR_BYTES(message->packet->length);
+        Radio_Stats.tx_air_bytes_static += frames * AIR_BYTES(RADIO_PAYLOAD_SIZE);
+        PacketPool__Release(message->packet);
+
+        Tx_Head = (Tx_Head + 1) % RADIO_TX_QUEUE_SIZE;
+        Tx_Count--;
+        if (Tx_In_Fifo > 0)
+        {
+            Tx_In_Fifo--;
+        }
+        // Messages sent from the callback are only queued
+        if (callback != NULL)
+        {
+            callback(status);
+        }
+    }
+}
+
+/**
+ * @brief Handle TX_DS and MAX_RT while sending, then refill the FIFO
+ */
+static void HandleTxIrq(uint8_t status)
 {
-    PORTB &= ~(1 << PORTB1);
+    uint8_t retransmits = ReadRegister(REG_OBSERVE_TX) & 0x0F;
+    uint8_t sent = CountSentMessages(status);
 
-    // LED to show success
-    PORTB |= (1 << PORTB0);
-    _delay_ms(500);
-    PORTB &= ~(1 << PORTB0);
-    // Read data from RX FIFO
-    data = RF24ReadWrite(R, R_RX_PAYLOAD, data, 32);
-    // Print data to console
-    for (int i = 0; i < 32; i++)
+    // ARC_CNT is only known for the last message
+    if (status & (1 << BIT_MAX_RT))
     {
-        Usart__PutChar(data[i]);
+        CompleteTx(sent, RADIO_STATUS_OK, 1);
+        // The failed payload blocks the FIFO: flush it and write the
+        // following ones again
+        Command(CMD_FLUSH_TX, NULL, NULL, 0);
+        RadioLink__OnTxResult(Tx_Queue[Tx_Head].node_id, retransmits, FALSE);
+        CompleteTx(1, RADIO_STATUS_NO_ACK, retransmits + 1);
+        Tx_In_Fifo = 0;
     }
-    // Clear IRQ masks in STATUS register
-    RF24ResetIRQ();
+    else if (sent > 0)
+    {
+        RadioLink__OnTxResult(Tx_Queue[(Tx_Head + sent - 1) % RADIO_TX_QUEUE_SIZE].node_id, retransmits, TRUE);
+        CompleteTx(sent, RADIO_STATUS_OK, retransmits + 1);
+    }
+
+    if (Tx_Count == 0)
+    {
+        SoftTimer__Stop(&Tx_Timer);
+        EnterStandby();
+    }
+    else
+    {
+        RefillTxFifo();
+        if (status & (1 << BIT_MAX_RT))
+        {
+            // CE was dropped by Radio__OnIrq()
+            Hal__DriveRadioCeHigh();
+        }
+        SoftTimer__StartOneShot(&Tx_Timer, TX_TIMEOUT, NULL);
+    }
+}
+
+/**
+ * @brief Write the ACK payload in the TX FIFO
+ *
+ * @details The FIFO is flushed first, so that only one copy is queued
+ */
+static void WriteAckPayload(void)
+{
+    Command(CMD_FLUSH_TX, NULL, NULL, 0);
+    Command(CMD_W_ACK_PAYLOAD | Ack_Pipe, Ack_Payload, NULL, Ack_Length);
+}
+
+/**
+ * @brief Write the address of a pipe, only the node ID for pipes 2 to 5
+ */
+static void WritePipeAddress(uint8_t pipe)
+{
+    uint8_t address[DEFAULT_ADDRESS_SIZE];
+
+    memcpy(address, Node_Address, DEFAULT_ADDRESS_SIZE);
+    address[0] = Pipe_Node_Id[pipe];
+    WriteRegister(REG_RX_ADDR_P0 + pipe, address, (pipe < 2) ? DEFAULT_ADDRESS_SIZE : 1);
+}
+
+/**
+ * @brief Enable the open pipes, and pipe 0 for the ACKs while sending
+ */
+static void WriteEnabledPipes(void)
+{
+    uint8_t mask = Pipes_Enabled;
+
+    if (Radio_State == STATE_TX)
+    {
+        mask |= (1 << 0);
+    }
+    WriteRegister(REG_EN_RXADDR, &mask, 1);
+}
+
+/**
+ * @brief Queue the read of the top RX FIFO payload
+ *
+ * @details Its width is read first, a width over 32 bytes or a pipe
+ *          number out of range (6 unused, 7 RX FIFO empty) means a
+ *          corrupted frame and the RX FIFO is flushed
+ */
+static void ReadPayload(void)
+{
+    uint8_t status;
+    uint8_t width;
+    uint8_t pipe;
+
+    if (Rx_Queued >= RADIO_RX_QUEUE_SIZE || (Rx_Packet = PacketPool__Alloc()) == NULL)
+    {
+        Rx_Stalled = TRUE;
+        Rx_Busy = FALSE;
+        return;
+    }
+
+    status = Command(CMD_R_RX_PL_WID, NULL, &width, 1);
+    pipe = (status >> BIT_RX_P_NO) & 0x07;
+    if (width == 0 || width > RADIO_PAYLOAD_SIZE || pipe >= RADIO_NUM_PIPES)
+    {
+        Command(CMD_FLUSH_RX, NULL, NULL, 0);
+        Radio_Stats.rx_errors++;
+        PacketPool__Release(Rx_Packet);
+        Rx_Packet = NULL;
+        Rx_Busy = FALSE;
+        return;
+    }
+
+    Rx_Packet->length = width;
+    Rx_Pipe = pipe;
+    Rx_Busy = TRUE;
+    Rx_Transactions[0] = (SPI_TRANSACTION_T){
+        .device = SPI_DEVICE_RADIO,
+        .tx = &Rx_Command,
+        .length = 1,
+        .next = &Rx_Transactions[1],
+    };
+    Rx_Transactions[1] = (SPI_TRANSACTION_T){
+        .device = SPI_DEVICE_RADIO,
+        .rx = Rx_Packet->data,
+        .length = width,
+        .callback = RxPayloadCallback,
+    };
+    Spi__Submit(&Rx_Transactions[0]);
+}
+
+/**
+ * @brief Read the payloads left in the RX FIFO for lack of packets
+ */
+static void ResumeRx(void)
+{
+    if (Rx_Stalled && !Rx_Busy &&
+        Rx_Queued < RADIO_RX_QUEUE_SIZE && PacketPool__GetFreeCount() > 0)
+    {
+        Rx_Stalled = FALSE;
+        if (!(ReadRegister(REG_FIFO_STATUS) & (1 << BIT_RX_EMPTY)))
+        {
+            ReadPayload();
+        }
+    }
+}
+
+/**
+ * @brief SPI completion of the payload read, ISR context
+ */
+static void RxPayloadCallback(SPI_TRANSACTION_T* transaction)
+{
+    Rx_Ready = TRUE;
+    Events__PostFromIsr(EVENT_RADIO_RX_PAYLOAD, 0, 0);
+}
+
+/**
+ * @brief Queue the payload read on its pipe, then read the next one if any
+ */
+static void HandleRxPayload(void)
+{
+    PIPE_QUEUE_T* queue;
+    uint8_t pipe = Rx_Pipe;
+
+    if (Rx_Ready)
+    {
+        Rx_Ready = FALSE;
+        Radio_Stats.rx_messages++;
+        Radio_Stats.rx_air_bytes += AIR_BYTES(Rx_Packet->length);
+        Radio_Stats.rx_air_bytes_static += AIR_BYTES(RADIO_PAYLOAD_SIZE);
+
+        // A pipe queue can hold all the queued packets
+        queue = &Pipe_Queues[pipe];
+        queue->packets[(queue->head + queue->count) % RADIO_RX_QUEUE_SIZE] = Rx_Packet;
+        queue->count++;
+        Rx_Queued++;
+        Rx_Packet = NULL;
+
+        if (ReadRegister(REG_FIFO_STATUS) & (1 << BIT_RX_EMPTY))
+        {
+            Rx_Busy = FALSE;
+        }
+        else
+        {
+            ReadPayload();
+        }
+
+        if (Rx_Callback != NULL)
+        {
+            Rx_Callback(pipe);
+        }
+    }
+}
+
+/**
+ * @brief ISR on INT0
+ *
+ * The IRQ is only signaled here, the SPI transfers are done by
+ * Radio__OnIrq() in the main loop
+ */
+ISR(INT0_vect)
+{
+    PROFILER_ENTER(PROFILER_ID_ISR_INT0);
+    TRACE(TRACE_RADIO_IRQ, 0, 0);
+    Events__PostFromIsr(EVENT_RADIO_IRQ, 0, 0);
+    PROFILER_EXIT(PROFILER_ID_ISR_INT0);
 }
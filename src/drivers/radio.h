@@ -35,7 +35,8 @@
 
 #include "micro.h"
 #include "spi.h"
-#include <util/delay.h>
+#include "events.h"
+#include "packet_pool.h"
 
 
 /* Memory Map */
@@ -91,7 +92,7 @@
 #define BIT_ARC         0
 #define BIT_PLL_LOCK    4
 #define BIT_RF_DR_HIGH  3
-#define BIT_RF_PWR      6
+#define BIT_RF_PWR      1
 #define BIT_RX_DR       6
 #define BIT_TX_DS       5
 #define BIT_MAX_RT      4
@@ -123,6 +124,7 @@
 #define CMD_R_RX_PAYLOAD  0x61
 #define CMD_W_TX_PAYLOAD  0xA0
 #define CMD_W_ACK_PAYLOAD 0xA8
+#define CMD_W_TX_PAYLOAD_NOACK 0xB0
 #define CMD_FLUSH_TX      0xE1
 #define CMD_FLUSH_RX      0xE2
 #define CMD_REUSE_TX_PL   0xE3
@@ -140,19 +142,78 @@
 #define RF_PWR_LOW  1
 #define RF_PWR_HIGH 2
 
-// Read and Write mode
-#define W 1
-#define R 0
+// Maximum payload width, payloads have a dynamic length
+#define RADIO_PAYLOAD_SIZE PACKET_SIZE
+
+// Messages waiting to be sent, the TX FIFO holds 3 of them
+#ifndef RADIO_TX_QUEUE_SIZE
+#define RADIO_TX_QUEUE_SIZE 4
+#endif
+
+// Received payloads waiting to be read, shared by all the pipes
+#ifndef RADIO_RX_QUEUE_SIZE
+#define RADIO_RX_QUEUE_SIZE 4
+#endif
+
+#define RADIO_NUM_PIPES 6
+
+// Destination of the broadcasts, sent without waiting for any ACK
+#define RADIO_BROADCAST_ID 0xFF
+
+// Node ID, first byte of the node address
+#ifndef RADIO_NODE_ID
+#define RADIO_NODE_ID 0x00
+#endif
+
+typedef enum {
+    RADIO_STATUS_OK = 0,
+    RADIO_STATUS_NO_ACK, // retransmits exhausted (MAX_RT)
+    RADIO_STATUS_ERROR,  // no IRQ from the module or radio turned off
+} RADIO_STATUS_T;
+
+// On-air data frames: preamble, address, payload and CRC. The data frames
+// with a static 32 bytes payload are counted too, for comparison.
+typedef struct {
+    uint16_t tx_messages;
+    uint16_t tx_frames;          // retransmits included
+    uint32_t tx_air_bytes;
+    uint32_t tx_air_bytes_static;
+    uint16_t rx_messages;        // ACK payloads included
+    uint32_t rx_air_bytes;
+    uint32_t rx_air_bytes_static;
+    uint16_t rx_errors;          // invalid payload width
+    uint16_t ack_payloads_sent;
+    uint16_t cca_busy;           // backoffs before sending
+    uint16_t cca_forced;         // sent on a channel still busy
+} RADIO_STATS_T;
+
+// Completion callbacks, called from the main loop
+typedef void (*RADIO_TX_CALLBACK_T)(RADIO_STATUS_T status);
+// A payload has been queued on the pipe, to be taken by Radio__Read()
+// or Radio__ReadPacket().
+// Pipe 0 also queues the ACK payloads of the sent messages.
+typedef void (*RADIO_RX_CALLBACK_T)(uint8_t pipe);
 
-#define DATA_LEN 32
-
-uint8_t RF24GetReg(uint8_t reg);
-uint8_t *RF24ReadWrite(uint8_t ReadWrite, uint8_t reg, uint8_t *val, uint8_t nVal);
 void Radio__Initialize(void);
 void Radio__1msTask(void);
-void RF24TransmitPayload(uint8_t *WBuff);
-void RF24ReceivePayload(void);
-void RF24ResetIRQ(void);
+void Radio__OnIrq(const EVENT_T* event);
+void Radio__OnRxPayload(const EVENT_T* event);
+void Radio__TurnOn(void);
+void Radio__TurnOff(void);
+BOOL_T Radio__IsOn(void);
+BOOL_T Radio__Send(uint8_t node_id, const uint8_t* payload, uint8_t length, RADIO_TX_CALLBACK_T callback);
+BOOL_T Radio__SendPacket(uint8_t node_id, PACKET_T* packet, RADIO_TX_CALLBACK_T callback);
+BOOL_T Radio__IsTxPending(void);
+void Radio__Receive(RADIO_RX_CALLBACK_T callback);
+BOOL_T Radio__OpenPipe(uint8_t pipe, uint8_t node_id);
+void Radio__ClosePipe(uint8_t pipe);
+uint8_t Radio__Read(uint8_t pipe, uint8_t* payload);
+PACKET_T* Radio__ReadPacket(uint8_t pipe);
+uint8_t Radio__GetQueuedCount(uint8_t pipe);
+BOOL_T Radio__SetAckPayload(uint8_t pipe, const uint8_t* payload, uint8_t length);
+BOOL_T Radio__IsAckPayloadPending(void);
+void Radio__GetStats(RADIO_STATS_T* stats);
+BOOL_T Radio__SetHop(uint8_t hop);
 
 
 #endif /* NRF24L01_H_ */
@@ -0,0 +1,204 @@
+/**
+ * @file radio_channel.c
+ *
+ * @brief Channel quality of the radio and hop sequence
+ *
+ * @details The radio driver samples the received power detector (RPD,
+ *          power over -64 dBm for at least 40 us) while listening, on its
+ *          own channel and, when scanning, on the other channels of the
+ *          hop sequence. Each sample updates the busy score of its channel,
+ *          an exponential average over the last few samples.
+ *
+ *          All the nodes of a network follow the same hop sequence. Moving
+ *          to another hop is decided by the gateway, from the scores the
+ *          nodes report, and announced in its TDMA sync (tdma.c), so that
+ *          all of them leave a congested channel at the same frame.
+ *
+ *          The random backoffs of the listen-before-talk are drawn here
+ *          too, from a xorshift generator stirred with the timer count.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include "micro.h"
+#include "timer.h"
+#include "radio.h"
+#include "radio_channel.h"
+
+// Weight of a new sample in the busy score, 1 / 2^N
+#define SCORE_SHIFT 3
+#define SCORE_BUSY 255
+
+// Backoff window of the first attempt, doubled at each attempt
+#define BACKOFF_WINDOW_MS 2
+#define BACKOFF_MAX_ATTEMPT 4
+
+static const uint8_t Hops[RADIO_CHANNEL_NUM_HOPS] = RADIO_CHANNEL_HOPS;
+static uint8_t Busy_Scores[RADIO_CHANNEL_NUM_HOPS];
+static uint8_t Current_Hop;
+static uint8_t Scan_Hop;
+static uint16_t Random_State;
+
+static uint8_t FindHop(uint8_t channel);
+
+void RadioChannel__Initialize(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < RADIO_CHANNEL_NUM_HOPS; i++)
+    {
+        Busy_Scores[i] = 0;
+    }
+    Current_Hop = 0;
+    Scan_Hop = 0;
+    // Nodes starting together must not draw the same backoffs
+    Random_State = 0xACE1 ^ ((uint16_t)RADIO_NODE_ID << 8);
+}
+
+uint8_t RadioChannel__GetChannel(void)
+{
+    return Hops[Current_Hop];
+}
+
+uint8_t RadioChannel__GetHop(void)
+{
+    return Current_Hop;
+}
+
+/**
+ * @brief Move to a hop of the sequence, used from the next RX or TX start
+ *
+ * @return FALSE if the hop is not valid
+ */
+BOOL_T RadioChannel__SetHop(uint8_t hop)
+{
+    BOOL_T result = FALSE;
+
+    if (hop < RADIO_CHANNEL_NUM_HOPS)
+    {
+        Current_Hop = hop;
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Hop with the lowest busy score, the current one on ties
+ */
+uint8_t RadioChannel__GetBestHop(void)
+{
+    uint8_t best = Current_Hop;
+    uint8_t i;
+
+    for (i = 0; i < RADIO_CHANNEL_NUM_HOPS; i++)
+    {
+        if (Busy_Scores[i] < Busy_Scores[best])
+        {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Next channel to scan, the other hops in turn
+ */
+uint8_t RadioChannel__GetScanChannel(void)
+{
+    Scan_Hop = (Scan_Hop + 1) % RADIO_CHANNEL_NUM_HOPS;
+    if (Scan_Hop == Current_Hop)
+    {
+        Scan_Hop = (Scan_Hop + 1) % RADIO_CHANNEL_NUM_HOPS;
+    }
+
+    return Hops[Scan_Hop];
+}
+
+/**
+ * @brief Update the busy score of a channel with an RPD sample
+ */
+void RadioChannel__AddSample(uint8_t channel, BOOL_T busy)
+{
+    uint8_t hop = FindHop(channel);
+    uint8_t score;
+
+    if (hop < RADIO_CHANNEL_NUM_HOPS)
+    {
+        score = Busy_Scores[hop];
+        score -= score >> SCORE_SHIFT;
+        if (busy)
+        {
+            score += SCORE_BUSY >> SCORE_SHIFT;
+        }
+        Busy_Scores[hop] = score;
+    }
+}
+
+/**
+ * @param channels  Array of RADIO_CHANNEL_NUM_HOPS entries, in hop order
+ */
+void RadioChannel__GetChannels(RADIO_CHANNEL_T* channels)
+{
+    uint8_t i;
+
+    for (i = 0; i < RADIO_CHANNEL_NUM_HOPS; i++)
+    {
+        channels[i].channel = Hops[i];
+        channels[i].busy_score = Busy_Scores[i];
+    }
+}
+
+/**
+ * @brief Random backoff before the next clear channel assessment
+ *
+ * @param attempt  Busy assessments so far, from 1
+ *
+ * @return 1 to BACKOFF_WINDOW_MS * 2^(attempt - 1) milliseconds
+ */
+uint8_t RadioChannel__GetBackoff(uint8_t attempt)
+{
+    uint8_t window;
+
+    if (attempt > BACKOFF_MAX_ATTEMPT)
+    {
+        attempt = BACKOFF_MAX_ATTEMPT;
+    }
+    else if (attempt < 1)
+    {
+        attempt = 1;
+    }
+    window = BACKOFF_WINDOW_MS << (attempt - 1);
+
+    return (uint8_t)(RadioChannel__GetRandom() % window) + 1;
+}
+
+static uint8_t FindHop(uint8_t channel)
+{
+    uint8_t i;
+
+    for (i = 0; i < RADIO_CHANNEL_NUM_HOPS && Hops[i] != channel; i++)
+    {
+    }
+
+    return i;
+}
+
+/**
+ * @brief Pseudo-random number, also used to spread the mesh floods
+ */
+uint16_t RadioChannel__GetRandom(void)
+{
+    Random_State ^= Timer__GetTimerCount();
+    if (Random_State == 0)
+    {
+        Random_State = 1;
+    }
+    Random_State ^= Random_State << 7;
+    Random_State ^= Random_State >> 9;
+    Random_State ^= Random_State << 8;
+
+    return Random_State;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file radio_channel.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef RADIO_CHANNEL_H_
+#define RADIO_CHANNEL_H_
+
+#include "micro.h"
+
+// Hop sequence, RF channels (2400 + n MHz) between or above the Wi-Fi
+// channels 1, 6 and 11. The first one is used after reset.
+#define RADIO_CHANNEL_HOPS {76, 25, 80, 50}
+#define RADIO_CHANNEL_NUM_HOPS 4
+
+// Busy score of a channel, 0 always clear to 255 always busy
+typedef struct {
+    uint8_t channel;
+    uint8_t busy_score;
+} RADIO_CHANNEL_T;
+
+void RadioChannel__Initialize(void);
+uint8_t RadioChannel__GetChannel(void);
+uint8_t RadioChannel__GetHop(void);
+BOOL_T RadioChannel__SetHop(uint8_t hop);
+uint8_t RadioChannel__GetBestHop(void);
+uint8_t RadioChannel__GetScanChannel(void);
+void RadioChannel__AddSample(uint8_t channel, BOOL_T busy);
+void RadioChannel__GetChannels(RADIO_CHANNEL_T* channels);
+uint8_t RadioChannel__GetBackoff(uint8_t attempt);
+uint16_t RadioChannel__GetRandom(void);
+
+#endif /* RADIO_CHANNEL_H_ */
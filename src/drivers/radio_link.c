@@ -0,0 +1,234 @@
+/**
+ * @file radio_link.c
+ *
+ * @brief Link adaptation of the radio, per destination node
+ *
+ * @details The radio driver reports the retransmit count (ARC_CNT of
+ *          OBSERVE_TX) of every message, or its loss after the last
+ *          retransmit. Each destination has its own PA level and retry
+ *          delay, written in RF_SETUP and SETUP_RETR before sending to it.
+ *
+ *          A lost message, or a few messages in a row needing retransmits,
+ *          make the link more robust by one step: first the PA level is
+ *          raised, then the retry delay is lengthened, to get out of
+ *          interference bursts. Many messages in a row without any
+ *          retransmit relax it by one step in the reverse order. The long
+ *          run asked for relaxing keeps a link from toggling between two
+ *          settings.
+ *
+ *          The average number of frames sent per message is the link cost
+ *          used by the mesh routing.
+ *
+ *          The data rate is the same for the whole network (RADIO_DATA_RATE):
+ *          the receiver only decodes frames sent at its own rate, a sender
+ *          cannot change it alone. It sets the shortest retry delay, long
+ *          enough for a 32-byte ACK payload.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <string.h>
+#include "micro.h"
+#include "radio.h"
+#include "radio_link.h"
+
+// Messages with this many retransmits or more count as bad
+#define BAD_RETRANSMITS 2
+// Consecutive bad messages before the link is made more robust
+#define BAD_MESSAGES_STEP 2
+// Consecutive messages without retransmits before the link is relaxed
+#define GOOD_MESSAGES_STEP 32
+
+#define RETRANSMITS 15
+// Weight of a new message in the frames average, 1 / 2^N
+#define AVERAGE_SHIFT 3
+// 2000 us, 15 retransmits stay within the radio TX timeout
+#define RETRY_DELAY_MAX 7
+
+#if (RADIO_DATA_RATE == RADIO_RATE_250KBPS)
+    #define RF_SETUP_RATE (1 << RF_DR_LOW)
+    #define RETRY_DELAY_MIN 5 // 1500 us
+#elif (RADIO_DATA_RATE == RADIO_RATE_1MBPS)
+    #define RF_SETUP_RATE 0
+    #define RETRY_DELAY_MIN 2 // 750 us
+#elif (RADIO_DATA_RATE == RADIO_RATE_2MBPS)
+    #define RF_SETUP_RATE (1 << RF_DR_HIGH)
+    #define RETRY_DELAY_MIN 1 // 500 us
+#else
+    #error "Unknown RADIO_DATA_RATE!!"
+#endif
+
+static RADIO_LINK_T Links[RADIO_LINK_MAX_NODES];
+
+static void ResetLink(RADIO_LINK_T* link);
+static void StepUp(RADIO_LINK_T* link);
+static void StepDown(RADIO_LINK_T* link);
+
+void RadioLink__Initialize(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < RADIO_LINK_MAX_NODES; i++)
+    {
+        ResetLink(&Links[i]);
+    }
+}
+
+/**
+ * @brief RF_SETUP value to send to a node
+ *
+ * @details The PA level also sets the power of the ACKs sent when
+ *          receiving, at full power with RADIO_LINK_NO_NODE
+ */
+uint8_t RadioLink__GetRfSetup(uint8_t node_id)
+{
+    uint8_t pa_level = RADIO_PA_0DBM;
+
+    if (node_id < RADIO_LINK_MAX_NODES)
+    {
+        pa_level = Links[node_id].pa_level;
+    }
+
+    return RF_SETUP_RATE | (pa_level << BIT_RF_PWR);
+}
+
+/**
+ * @brief SETUP_RETR value to send to a node
+ */
+uint8_t RadioLink__GetSetupRetr(uint8_t node_id)
+{
+    uint8_t retry_delay = RETRY_DELAY_MIN;
+
+    if (node_id < RADIO_LINK_MAX_NODES)
+    {
+        retry_delay = Links[node_id].retry_delay;
+    }
+
+    return (retry_delay << BIT_ARD) | (RETRANSMITS << BIT_ARC);
+}
+
+/**
+ * @brief Update the link of a node with the outcome of a message
+ *
+ * @param retransmits   ARC_CNT after the message
+ * @param acknowledged  FALSE if the retransmits have been exhausted
+ */
+void RadioLink__OnTxResult(uint8_t node_id, uint8_t retransmits, BOOL_T acknowledged)
+{
+    RADIO_LINK_T* link;
+    uint8_t frames;
+    int16_t average;
+
+    if (node_id >= RADIO_LINK_MAX_NODES)
+    {
+        return;
+    }
+
+    link = &Links[node_id];
+    link->messages++;
+    // A lost message costs all the frames sent, and then some
+    frames = acknowledged ? (retransmits + 1) : (RETRANSMITS + 1);
+    average = link->frames_average;
+    average += ((int16_t)frames * RADIO_LINK_COST_UNIT - average) >> AVERAGE_SHIFT;
+    link->frames_average = (average > UINT8_MAX) ? UINT8_MAX : (uint8_t)average;
+    if (!acknowledged)
+    {
+        link->lost_messages++;
+        StepUp(link);
+    }
+    else if (retransmits >= BAD_RETRANSMITS)
+    {
+        link->good_messages = 0;
+        link->bad_messages++;
+        if (link->bad_messages >= BAD_MESSAGES_STEP)
+        {
+            StepUp(link);
+        }
+    }
+    else if (retransmits == 0)
+    {
+        link->bad_messages = 0;
+        link->good_messages++;
+        if (link->good_messages >= GOOD_MESSAGES_STEP)
+        {
+            StepDown(link);
+        }
+    }
+    else
+    {
+        // A single retransmit is normal, but does not prove the link good
+        link->good_messages = 0;
+    }
+}
+
+/**
+ * @return FALSE if the node ID has no link of its own
+ */
+BOOL_T RadioLink__GetLink(uint8_t node_id, RADIO_LINK_T* link)
+{
+    BOOL_T result = FALSE;
+
+    if (node_id < RADIO_LINK_MAX_NODES)
+    {
+        *link = Links[node_id];
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Cost of sending to a node, RADIO_LINK_COST_UNIT per frame
+ *
+ * @return UINT8_MAX if the node ID has no link of its own
+ */
+uint8_t RadioLink__GetCost(uint8_t node_id)
+{
+    return (node_id < RADIO_LINK_MAX_NODES) ? Links[node_id].frames_average : UINT8_MAX;
+}
+
+/**
+ * @brief Start from the most robust power and the shortest retry delay
+ */
+static void ResetLink(RADIO_LINK_T* link)
+{
+    memset(link, 0, sizeof(*link));
+    link->pa_level = RADIO_PA_0DBM;
+    link->retry_delay = RETRY_DELAY_MIN;
+    link->frames_average = RADIO_LINK_COST_UNIT;
+}
+
+/**
+ * @brief Make the link more robust: more power, then longer retry delay
+ */
+static void StepUp(RADIO_LINK_T* link)
+{
+    if (link->pa_level < RADIO_PA_0DBM)
+    {
+        link->pa_level++;
+    }
+    else if (link->retry_delay < RETRY_DELAY_MAX)
+    {
+        link->retry_delay++;
+    }
+    link->good_messages = 0;
+    link->bad_messages = 0;
+}
+
+/**
+ * @brief Relax the link: shorter retry delay, then less power
+ */
+static void StepDown(RADIO_LINK_T* link)
+{
+    if (link->retry_delay > RETRY_DELAY_MIN)
+    {
+        link->retry_delay--;
+    }
+    else if (link->pa_level > RADIO_PA_MINUS_18DBM)
+    {
+        link->pa_level--;
+    }
+    link->good_messages = 0;
+    link->bad_messages = 0;
+}
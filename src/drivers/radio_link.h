@@ -0,0 +1,60 @@
+/**
+ * @file radio_link.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef RADIO_LINK_H_
+#define RADIO_LINK_H_
+
+#include "micro.h"
+
+// Destinations with their own link settings, node IDs 0 to N-1.
+// The other node IDs are sent to with the default settings.
+#ifndef RADIO_LINK_MAX_NODES
+#define RADIO_LINK_MAX_NODES 16
+#endif
+
+// Data rates, tested by the preprocessor
+#define RADIO_RATE_250KBPS 0
+#define RADIO_RATE_1MBPS   1
+#define RADIO_RATE_2MBPS   2
+
+// Data rate of the whole network: a node only receives at its own rate,
+// so all the nodes must use the same one
+#ifndef RADIO_DATA_RATE
+#define RADIO_DATA_RATE RADIO_RATE_1MBPS
+#endif
+
+// Link cost of one frame per message, the best one
+#define RADIO_LINK_COST_UNIT 16
+
+// Node ID standing for the default settings, also used when receiving
+#define RADIO_LINK_NO_NODE 0xFF
+
+typedef enum {
+    RADIO_PA_MINUS_18DBM = 0,
+    RADIO_PA_MINUS_12DBM,
+    RADIO_PA_MINUS_6DBM,
+    RADIO_PA_0DBM,
+} RADIO_PA_T;
+
+typedef struct {
+    uint8_t pa_level;      // RADIO_PA_T
+    uint8_t retry_delay;   // ARD, in 250 us steps minus one
+    uint8_t good_messages; // consecutive messages without retransmits
+    uint8_t bad_messages;  // consecutive lost or retransmitted messages
+    uint8_t frames_average; // frames sent per message, Q4.4
+    uint16_t messages;
+    uint16_t lost_messages;
+} RADIO_LINK_T;
+
+void RadioLink__Initialize(void);
+uint8_t RadioLink__GetRfSetup(uint8_t node_id);
+uint8_t RadioLink__GetSetupRetr(uint8_t node_id);
+void RadioLink__OnTxResult(uint8_t node_id, uint8_t retransmits, BOOL_T acknowledged);
+BOOL_T RadioLink__GetLink(uint8_t node_id, RADIO_LINK_T* link);
+uint8_t RadioLink__GetCost(uint8_t node_id);
+
+#endif /* RADIO_LINK_H_ */
@@ -8,6 +8,9 @@
 
 #include "micro.h"
 #include <avr/interrupt.h>
+#include "soft_timer.h"
+#include "events.h"
+#include "trace.h"
 #include "relays.h"
 
 #define RELAYS_ACTION_DELAY_MS 4
@@ -31,7 +34,7 @@ static RELAY_T Current_Relay;
 static RELAYS_STATE_T Relay0_State;
 static RELAYS_STATE_T Relay1_State;
 static RELAYS_EVENT_T Relays_Event;
-static uint8_t Countdown_Timer_Ms;
+static SOFT_TIMER_T Pulse_Timer;
 
 static inline void BeginMovePinForSet(RELAY_T relay);
 static inline void EndMovePinForSet(RELAY_T relay);
@@ -80,11 +83,6 @@ void Relays__1msTask(void)
 {
 	RELAYS_STATE_T current_state, next_state;
 
-	if (Countdown_Timer_Ms != 0)
-	{
-		Countdown_Timer_Ms--;
-	}
-
 	if (Relays_Event != EVENT_NO_EVENT)
 	{
 		if (Current_Relay == RELAY_0)
@@ -104,34 +102,44 @@ void Relays__1msTask(void)
 			{
 				BeginMovePinForReset(RELAY_0);
 				BeginMovePinForReset(RELAY_1);
-				Countdown_Timer_Ms = RELAYS_ACTION_DELAY_MS;
+				TRACE(TRACE_RELAY_PULSE_START, RELAY_0, 0);
+				TRACE(TRACE_RELAY_PULSE_START, RELAY_1, 0);
+				SoftTimer__StartOneShot(&Pulse_Timer, RELAYS_ACTION_DELAY_MS, NULL);
 				next_state = STATE_WAIT_FOR_INIT_RESET;
 				break;
 			}
 			case STATE_WAIT_FOR_INIT_RESET:
 			{
-				if (Countdown_Timer_Ms == 0)
+				if (SoftTimer__IsExpired(&Pulse_Timer))
 				{
 					EndMovePinForReset(RELAY_0);
 					EndMovePinForReset(RELAY_1);
+					TRACE(TRACE_RELAY_PULSE_END, RELAY_0, 0);
+					TRACE(TRACE_RELAY_PULSE_END, RELAY_1, 0);
+					Events__Post(EVENT_RELAY_DONE, RELAY_0, 0);
+					Events__Post(EVENT_RELAY_DONE, RELAY_1, 0);
 					next_state = STATE_RESET;
 				}
 				break;
 			}
 			case STATE_WAIT_FOR_SET:
 			{
-				if (Countdown_Timer_Ms == 0)
+				if (SoftTimer__IsExpired(&Pulse_Timer))
 				{
 					EndMovePinForSet(Current_Relay);
+					TRACE(TRACE_RELAY_PULSE_END, Current_Relay, 1);
+					Events__Post(EVENT_RELAY_DONE, Current_Relay, 1);
 					next_state = STATE_SET;
 				}
 				break;
 			}
 			case STATE_WAIT_FOR_RESET:
 			{
-				if (Countdown_Timer_Ms == 0)
+				if (SoftTimer__IsExpired(&Pulse_Timer))
 				{
 					EndMovePinForReset(Current_Relay);
+					TRACE(TRACE_RELAY_PULSE_END, Current_Relay, 0);
+					Events__Post(EVENT_RELAY_DONE, Current_Relay, 0);
 					next_state = STATE_RESET;
 				}
 				break;
@@ -141,7 +149,8 @@ void Relays__1msTask(void)
 				if (Relays_Event == EVENT_RELAY_RESET_REQUESTED)
 				{
 					BeginMovePinForReset(Current_Relay);
-					Countdown_Timer_Ms = RELAYS_ACTION_DELAY_MS;
+					TRACE(TRACE_RELAY_PULSE_START, Current_Relay, 0);
+					SoftTimer__StartOneShot(&Pulse_Timer, RELAYS_ACTION_DELAY_MS, NULL);
 					next_state = STATE_WAIT_FOR_RESET;
 				}
 				else
@@ -155,7 +164,8 @@ void Relays__1msTask(void)
 				if (Relays_Event == EVENT_RELAY_SET_REQUESTED)
 				{
 					BeginMovePinForSet(Current_Relay);
-					Countdown_Timer_Ms = RELAYS_ACTION_DELAY_MS;
+					TRACE(TRACE_RELAY_PULSE_START, Current_Relay, 1);
+					SoftTimer__StartOneShot(&Pulse_Timer, RELAYS_ACTION_DELAY_MS, NULL);
 					next_state = STATE_WAIT_FOR_SET;
 				}
 				else
@@ -3,135 +3,441 @@
  *
  * Created: 22/09/2014 17:18:08
  *  \author: Leonardo Ricupero
- */ 
+ *
+ * Transaction based SPI master. Transaction chains are queued by
+ * Spi__Submit() and transferred by the SPI_STC_vect ISR, which writes
+ * each byte as soon as the previous one is complete, with the device
+ * CSN held low for the whole chain.
+ *
+ * Spi__Transfer() moves short chains with a polled loop instead, when
+ * the bus is free: at high SCK rates the ISR overhead would be longer
+ * than the byte itself. The SCK rate is set per device when its chain
+ * starts.
+ */
 
 #include "micro.h"
+#include "hal.h"
 #include "spi.h"
+#include "profiler.h"
+#ifdef SPI_BENCHMARK_ENABLED
+#include "timer.h"
+#endif
+
+// SPR1:0 in bits 1:0, SPI2X in bit 2
+#define CLOCK_SETTING(spr, spi2x) ((spr) | ((spi2x) << 2))
+#define CLOCK_SETTING_SPR(setting) ((setting) & 0x03)
+#define CLOCK_SETTING_SPI2X(setting) ((setting) >> 2)
 
-#define DDR_SPI DDRB
-#define DDR_MOSI DDB3
-#define DDR_SCK DDB5
-#define DDR_CSN DDB2
+#ifdef SPI_BENCHMARK_ENABLED
+#define BENCHMARK_ITERATIONS 40
+#define BENCHMARK_PAYLOAD_LENGTH 32
+#endif
 
-#define PORT_SPI PORTB
-#define PIN_CSN PORTB2
+static const uint8_t Clock_Settings[SPI_NUM_CLOCKS] = {
+    [SPI_CLOCK_DIV_2]   = CLOCK_SETTING(0, 1),
+    [SPI_CLOCK_DIV_4]   = CLOCK_SETTING(0, 0),
+    [SPI_CLOCK_DIV_8]   = CLOCK_SETTING(1, 1),
+    [SPI_CLOCK_DIV_16]  = CLOCK_SETTING(1, 0),
+    [SPI_CLOCK_DIV_32]  = CLOCK_SETTING(2, 1),
+    [SPI_CLOCK_DIV_64]  = CLOCK_SETTING(2, 0),
+    [SPI_CLOCK_DIV_128] = CLOCK_SETTING(3, 0),
+};
 
-#define TX_BUFFER_SIZE 16
-#define RX_BUFFER_SIZE 16
+static const uint8_t Csn_Pin_Mask[SPI_NUM_DEVICES] = {
+    [SPI_DEVICE_RADIO] = HAL_CSN_RADIO,
+};
 
-#define SPI_DRIVE_CSN_LOW() {PORT_SPI &= ~(1 << PIN_CSN);}
-#define SPI_DRIVE_CSN_HIGH() {PORT_SPI |= (1 << PIN_CSN);}
+// The nRF24L01+ supports up to 8 MHz
+static SPI_CLOCK_T Device_Clock[SPI_NUM_DEVICES] = {
+    [SPI_DEVICE_RADIO] = SPI_CLOCK_DIV_2,
+};
 
-static uint8_t Tx_Buffer[TX_BUFFER_SIZE];
-static uint8_t Rx_Buffer[RX_BUFFER_SIZE];
-static uint8_t Tx_Idx;
-static uint8_t Rx_Idx;
+#define SPI_DRIVE_CSN_LOW(device) Hal__SelectSpi(Csn_Pin_Mask[device])
+#define SPI_DRIVE_CSN_HIGH(device) Hal__DeselectSpi(Csn_Pin_Mask[device])
 
-static BOOL_T Pending_Write;
-static BOOL_T Pending_Read;
+// Queued transactions, the head one is being transferred
+static SPI_TRANSACTION_T* Queue_Head;
+static SPI_TRANSACTION_T* Queue_Tail;
+static uint8_t Byte_Index;
+static BOOL_T Chain_Active;
+// The bus is owned by a polled transfer, queued chains wait for it
+static volatile BOOL_T Polled_Active;
+
+static void SelectDevice(SPI_DEVICE_T device);
+static uint8_t GetTxByte(const SPI_TRANSACTION_T* transaction, uint8_t index);
+static uint16_t GetChainLength(const SPI_TRANSACTION_T* chain);
+static SPI_TRANSACTION_T* GetChainEnd(SPI_TRANSACTION_T* chain);
+static BOOL_T AcquireBus(void);
+static void ReleaseBus(void);
+static void TransferPolled(SPI_TRANSACTION_T* chain);
+static void WriteNextByte(void);
 
 /**
  * Initialize SPI in master mode
- * 
+ *
  */
 void Spi__Initialize(void)
 {
-	// Set MOSI ,SCK, and CSN as output, all other pin as input
-	DDR_SPI = (1 << DDR_SCK) | (1 << DDR_MOSI) | (1 << DDR_CSN);
-	// Enable SPI, Master, set clock rate fck/16, IRQ enabled
-	SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPR0) | (1 << SPIE);
+    uint8_t i;
+
+	// Set MOSI ,SCK, and CSN as output, MISO as input
+	// Enable SPI, Master, IRQ enabled. The clock rate is set per device.
+	Hal__InitializeSpi();
 	// Set CSN high to start with, because nothing has to be transmitted
-	SPI_DRIVE_CSN_HIGH();
+	for (i = 0; i < SPI_NUM_DEVICES; i++)
+	{
+	    SPI_DRIVE_CSN_HIGH(i);
+	}
+
+    Queue_Head = NULL;
+    Queue_Tail = NULL;
+    Byte_Index = 0;
+    Chain_Active = FALSE;
+    Polled_Active = FALSE;
+}
+
+/**
+ * @brief Set the SCK rate of a device, from its next chain on
+ */
+void Spi__SetClock(SPI_DEVICE_T device, SPI_CLOCK_T clock)
+{
+    Device_Clock[device] = clock;
+}
+
+/**
+ * @brief Queue a transaction chain
+ *
+ * @details Returns immediately, completion is reported by the done flag
+ *          and the callback of each transaction. The chain is always
+ *          transferred by the ISR.
+ */
+void Spi__Submit(SPI_TRANSACTION_T* chain)
+{
+    SPI_TRANSACTION_T* last = chain;
+
+    chain->done = FALSE;
+    while (last->next != NULL)
+    {
+        last->flags &= ~SPI_FLAG_END;
+        last = last->next;
+        last->done = FALSE;
+    }
+    last->flags |= SPI_FLAG_END;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (Queue_Head == NULL)
+        {
+            Queue_Head = chain;
+            Queue_Tail = last;
+            if (!Polled_Active)
+            {
+                WriteNextByte();
+            }
+        }
+        else
+        {
+            Queue_Tail->next = chain;
+            Queue_Tail = last;
+        }
+    }
+}
+
+/**
+ * @brief Transfer a transaction chain and wait for its completion
+ *
+ * @details Chains up to SPI_POLLED_MAX_LENGTH bytes are transferred with
+ *          a polled loop if the bus is free, the others are queued as
+ *          by Spi__Submit()
+ *
+ * @remarks Must be called from the main loop with interrupts enabled
+ */
+void Spi__Transfer(SPI_TRANSACTION_T* chain)
+{
+    SPI_TRANSACTION_T* last = GetChainEnd(chain);
+
+    if (GetChainLength(chain) <= SPI_POLLED_MAX_LENGTH && AcquireBus())
+    {
+        TransferPolled(chain);
+        ReleaseBus();
+    }
+    else
+    {
+        Spi__Submit(chain);
+        while (!last->done)
+        {
+        }
+    }
+}
 
-	// Buffers initialization
-    Tx_Idx = 0;
-    Rx_Idx = 0;
-    Pending_Write = FALSE;
-    Pending_Read = FALSE;
+BOOL_T Spi__IsIdle(void)
+{
+    BOOL_T result = FALSE;
+
+    if (Queue_Head == NULL && !Polled_Active)
+    {
+        result = TRUE;
+    }
+
+    return result;
 }
 
-void Spi__PutChar(uint8_t c)
+#ifdef SPI_BENCHMARK_ENABLED
+/**
+ * @brief Measure the transfer times of both paths at the given SCK rate
+ *
+ * @details Every case is repeated BENCHMARK_ITERATIONS times and averaged.
+ *          Only dummy bytes are sent: 0xFF is the nRF24L01+ NOP command
+ *          and the following bytes are ignored, so the device state is
+ *          not changed. The measure includes the time spent in the other
+ *          ISRs and blocks the main loop for up to about 200 ms (at
+ *          fck/128).
+ *
+ * @remarks Must be called from the main loop with interrupts enabled
+ */
+void Spi__Benchmark(SPI_DEVICE_T device, SPI_CLOCK_T clock, SPI_BENCHMARK_T* result)
 {
-    if (Tx_Idx >= TX_BUFFER_SIZE - 1)
+    SPI_CLOCK_T saved_clock = Device_Clock[device];
+    SPI_TRANSACTION_T data;
+    SPI_TRANSACTION_T command;
+    uint16_t* results = &result->register_polled;
+    uint32_t start;
+    uint32_t elapsed;
+    uint8_t test;
+    uint8_t i;
+
+    while (!Spi__IsIdle())
     {
-        Tx_Idx = 0;
     }
-    Tx_Buffer[Tx_Idx] = c;
-    Tx_Idx++;
+    Device_Clock[device] = clock;
+
+    // Same order as the SPI_BENCHMARK_T fields
+    for (test = 0; test < 4; test++)
+    {
+        start = Timer__GetMicros();
+        for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        {
+            command = (SPI_TRANSACTION_T){
+                .device = device,
+                .length = 1,
+                .next = &data,
+            };
+            data = (SPI_TRANSACTION_T){
+                .device = device,
+                .length = (test < 2) ? 1 : BENCHMARK_PAYLOAD_LENGTH,
+            };
+
+            if ((test & 0x01) == 0)
+            {
+                while (!AcquireBus())
+                {
+                }
+                TransferPolled(&command);
+                ReleaseBus();
+            }
+            else
+            {
+                Spi__Submit(&command);
+                while (!data.done)
+                {
+                }
+            }
+        }
+        elapsed = (Timer__GetMicros() - start) * 10 / BENCHMARK_ITERATIONS;
+        results[test] = (elapsed > 0xFFFF) ? 0xFFFF : (uint16_t)elapsed;
+    }
+
+    Device_Clock[device] = saved_clock;
 }
+#endif
 
-uint8_t Spi__GetChar(void)
+ISR(SPI_STC_vect)
 {
-    uint8_t c = 0;
+    SPI_TRANSACTION_T* transaction = Queue_Head;
+    uint8_t data;
+
+    PROFILER_ENTER(PROFILER_ID_ISR_SPI);
+    data = Hal__ReadSpi();
+    if (transaction->rx != NULL)
+    {
+        transaction->rx[Byte_Index] = data;
+    }
+    Byte_Index++;
 
-    c = Rx_Buffer[Rx_Idx];
-    if (Rx_Idx >= 0)
+    if (Byte_Index < transaction->length)
+    {
+        WriteNextByte();
+    }
+    else
     {
-        Rx_Idx--;
+        Byte_Index = 0;
+        Queue_Head = transaction->next;
+        if (transaction->flags & SPI_FLAG_END)
+        {
+            SPI_DRIVE_CSN_HIGH(transaction->device);
+            Chain_Active = FALSE;
+        }
+
+        // Chain the next transaction back-to-back, before the callback
+        // which may queue more
+        if (Queue_Head != NULL)
+        {
+            WriteNextByte();
+        }
+
+        transaction->done = TRUE;
+        if (transaction->callback != NULL)
+        {
+            transaction->callback(transaction);
+        }
     }
+    PROFILER_EXIT(PROFILER_ID_ISR_SPI);
+}
+
+/**
+ * @brief Assert the device CSN and set its SCK rate
+ */
+static void SelectDevice(SPI_DEVICE_T device)
+{
+    uint8_t setting = Clock_Settings[Device_Clock[device]];
 
-    return c;
+    Hal__SetSpiClock(CLOCK_SETTING_SPR(setting), CLOCK_SETTING_SPI2X(setting));
+    SPI_DRIVE_CSN_LOW(device);
 }
 
-void Spi__WriteThenRead(uint8_t c)
+static uint8_t GetTxByte(const SPI_TRANSACTION_T* transaction, uint8_t index)
 {
-    Pending_Read = TRUE;
-    Spi__PutChar(c);
+    uint8_t data = SPI_DUMMY_BYTE;
+
+    if (transaction->tx != NULL)
+    {
+        if (transaction->flags & SPI_FLAG_TX_PROGMEM)
+        {
+            data = pgm_read_byte(&transaction->tx[index]);
+        }
+        else
+        {
+            data = transaction->tx[index];
+        }
+    }
+
+    return data;
 }
 
-BOOL_T Spi__IsRxBufferEmpty(void)
+static uint16_t GetChainLength(const SPI_TRANSACTION_T* chain)
 {
-    uint8_t res = TRUE;
+    uint16_t length = 0;
 
-    if (Rx_Idx != 0)
+    while (chain != NULL)
     {
-        res = FALSE;
+        length += chain->length;
+        chain = chain->next;
     }
 
-    return res;
+    return length;
 }
 
-BOOL_T Spi__IsTxBufferEmpty(void)
+static SPI_TRANSACTION_T* GetChainEnd(SPI_TRANSACTION_T* chain)
 {
-    uint8_t res = TRUE;
+    while (chain->next != NULL)
+    {
+        chain = chain->next;
+    }
+
+    return chain;
+}
 
-    if (Tx_Idx != 0)
+/**
+ * @brief Take the bus for a polled transfer, if no chain is queued
+ *
+ * @details The SPI interrupt is disabled until ReleaseBus(), chains
+ *          submitted meanwhile are queued and started by ReleaseBus()
+ */
+static BOOL_T AcquireBus(void)
+{
+    BOOL_T result = FALSE;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        res = FALSE;
+        if (Queue_Head == NULL && !Polled_Active)
+        {
+            Polled_Active = TRUE;
+            Hal__DisableSpiInterrupt();
+            result = TRUE;
+        }
     }
 
-    return res;
+    return result;
 }
 
-void Spi__FastTask(void)
+static void ReleaseBus(void)
 {
-    if (Tx_Idx > 0)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        if (!Pending_Write)
+        // SPIF has been cleared by the last SPDR read
+        Hal__EnableSpiInterrupt();
+        Polled_Active = FALSE;
+        if (Queue_Head != NULL)
         {
-            Tx_Idx--;
-            SPI_DRIVE_CSN_LOW();
-            SPDR = Tx_Buffer[Tx_Idx];
-            Pending_Write = TRUE;
+            WriteNextByte();
         }
     }
 }
 
-ISR(SPI_STC_vect)
+/**
+ * @brief Transfer a whole chain polling SPIF
+ *
+ * @remarks The bus must have been taken with AcquireBus()
+ */
+static void TransferPolled(SPI_TRANSACTION_T* chain)
 {
-    if (Pending_Read)
+    SPI_TRANSACTION_T* transaction;
+    uint8_t data;
+    uint8_t i;
+
+    SelectDevice(chain->device);
+    for (transaction = chain; transaction != NULL; transaction = transaction->next)
     {
-        Rx_Buffer[Rx_Idx] = SPDR;
-        if (Rx_Idx < RX_BUFFER_SIZE)
+        for (i = 0; i < transaction->length; i++)
         {
-            Rx_Idx++;
+            Hal__WriteSpi(GetTxByte(transaction, i));
+            while (!Hal__IsSpiDone())
+            {
+            }
+            data = Hal__ReadSpi();
+            if (transaction->rx != NULL)
+            {
+                transaction->rx[i] = data;
+            }
         }
-        else
+    }
+    SPI_DRIVE_CSN_HIGH(chain->device);
+
+    // Completion is reported once CSN is released
+    for (transaction = chain; transaction != NULL; transaction = transaction->next)
+    {
+        transaction->done = TRUE;
+        if (transaction->callback != NULL)
         {
-            Rx_Idx = 0;
+            transaction->callback(transaction);
         }
-        Pending_Read = FALSE;
     }
-    Pending_Write = FALSE;
-    SPI_DRIVE_CSN_HIGH();
+}
+
+/**
+ * @brief Write the next byte of the head transaction to the bus
+ *
+ * @remarks To be called with interrupts disabled
+ */
+static void WriteNextByte(void)
+{
+    SPI_TRANSACTION_T* transaction = Queue_Head;
+
+    if (!Chain_Active)
+    {
+        SelectDevice(transaction->device);
+        Chain_Active = TRUE;
+    }
+
+    Hal__WriteSpi(GetTxByte(transaction, Byte_Index));
 }
@@ -9,14 +9,81 @@
 #ifndef SPI_H_
 #define SPI_H_
 
-#include <avr/io.h>
+#include <stddef.h>
+#include "micro.h"
+
+#define SPI_DUMMY_BYTE 0xFF
+
+#define SPI_FLAG_TX_PROGMEM 0x01 // tx data is in flash
+#define SPI_FLAG_END        0x80 // last transaction of a chain, set by the driver
+
+// Longest chain, in bytes, transferred by Spi__Transfer() with a polled loop.
+// At fck/2 a byte takes 16 CPU cycles, less than the ISR entry and exit,
+// so short register accesses are faster polled. Longer chains (payloads)
+// are chained by the ISR and leave the CPU to the interrupts meanwhile.
+#ifndef SPI_POLLED_MAX_LENGTH
+#define SPI_POLLED_MAX_LENGTH 8
+#endif
+
+// Devices on the bus, each with its own chip select line
+typedef enum {
+    SPI_DEVICE_RADIO = 0,
+    SPI_NUM_DEVICES,
+} SPI_DEVICE_T;
+
+// SCK frequency, fck divider (SPI2X is set for DIV_2, DIV_8 and DIV_32)
+typedef enum {
+    SPI_CLOCK_DIV_2 = 0,
+    SPI_CLOCK_DIV_4,
+    SPI_CLOCK_DIV_8,
+    SPI_CLOCK_DIV_16,
+    SPI_CLOCK_DIV_32,
+    SPI_CLOCK_DIV_64,
+    SPI_CLOCK_DIV_128,
+    SPI_NUM_CLOCKS,
+} SPI_CLOCK_T;
+
+typedef struct SPI_TRANSACTION_S SPI_TRANSACTION_T;
+
+// Called once the transaction is complete, from ISR context or, for
+// polled transfers, from the Spi__Transfer() caller
+typedef void (*SPI_CALLBACK_T)(SPI_TRANSACTION_T* transaction);
+
+/**
+ * SPI transaction, owned by the caller until it is complete.
+ * Transactions linked through the next field form a chain, transferred
+ * back-to-back with CSN held low for the whole chain (e.g. a command
+ * byte followed by a payload buffer).
+ */
+struct SPI_TRANSACTION_S {
+    SPI_DEVICE_T device;
+    const uint8_t* tx;       // NULL to send dummy bytes
+    uint8_t* rx;             // NULL to discard the received bytes
+    uint8_t length;          // must not be 0
+    uint8_t flags;
+    SPI_CALLBACK_T callback; // can be NULL
+    SPI_TRANSACTION_T* next; // next transaction of the chain, NULL for the last one,
+                             // also used by the driver to link the queued chains
+    volatile BOOL_T done;
+};
+
+#ifdef SPI_BENCHMARK_ENABLED
+// Average transfer times, in 0.1 us units
+typedef struct {
+    uint16_t register_polled;    // command byte and one data byte
+    uint16_t register_interrupt;
+    uint16_t payload_polled;     // command byte and 32 data bytes
+    uint16_t payload_interrupt;
+} SPI_BENCHMARK_T;
+#endif
 
 void Spi__Initialize(void);
-void Spi__PutChar(uint8_t c);
-uint8_t Spi__GetChar(void);
-void Spi__WriteThenRead(uint8_t c);
-BOOL_T Spi__IsRxBufferEmpty(void);
-BOOL_T Spi__IsTxBufferEmpty(void);
-void Spi__FastTask(void);
+void Spi__SetClock(SPI_DEVICE_T device, SPI_CLOCK_T clock);
+void Spi__Submit(SPI_TRANSACTION_T* chain);
+void Spi__Transfer(SPI_TRANSACTION_T* chain);
+BOOL_T Spi__IsIdle(void);
+#ifdef SPI_BENCHMARK_ENABLED
+void Spi__Benchmark(SPI_DEVICE_T device, SPI_CLOCK_T clock, SPI_BENCHMARK_T* result);
+#endif
 
 #endif /* SPI_H_ */
@@ -6,6 +6,8 @@
  */ 
 
 #include "onewire.h"
+#include "events.h"
+#include "trace.h"
 #include "temp_sensor.h"
 
 #define SCRATCHPAD_SIZE		9
@@ -50,7 +52,6 @@ typedef union {
 	    uint8_t configuring :1;
 	    uint8_t reading_temp :1;
 	    uint8_t conversion_finished :1;
-	    uint8_t temperature_read :1;
 	    uint8_t configured: 1;
 	    uint8_t timeout_expired: 1;
     };
@@ -108,7 +109,8 @@ void TempSensor__StartAcquisition(void)
  * @details The temperature is given in fixed point
  * 			format Q12.4
  *
- * @remarks Call this function in order to start a new conversion
+ * @remarks The EVENT_TEMPERATURE_READY event is posted, with the
+ *          temperature as payload, each time a new value is available
  *
  */
 int16_t TempSensor__GetTemperature(void)
@@ -117,18 +119,6 @@ int16_t TempSensor__GetTemperature(void)
 
 	result = Scratchpad[1] << 8;
 	result += Scratchpad[0];
-	TempSensor_Events.temperature_read = 0;
-	return result;
-}
-
-uint8_t TempSensor__IsTemperatureReady(void)
-{
-	uint8_t result = 0;
-    if (TempSensor_Events.temperature_read)
-    {
-        TempSensor_Events.temperature_read = 0;
-        result = 1;
-    }
 	return result;
 }
 
@@ -165,6 +155,8 @@ void TempSensor__1msTask(void)
 				}
 				else
 				{
+					TRACE(TRACE_TEMP_SENSOR_ERROR, TempSensor_State, 0);
+					Events__Post(EVENT_SENSOR_FAULT, 0, 0);
 					next_state = STATE_ERROR_FOUND;
 				}
 			}
@@ -239,7 +231,8 @@ void TempSensor__1msTask(void)
 			{
 			    Scratchpad_Read_Index = 0;
                 TempSensor_Events.reading_temp = 0;
-				TempSensor_Events.temperature_read = 1;
+                TRACE(TRACE_TEMP_SENSOR_READY, (uint16_t)TempSensor__GetTemperature(), 0);
+                Events__Post(EVENT_TEMPERATURE_READY, 0, (uint16_t)TempSensor__GetTemperature());
                 next_state = STATE_IDLE;
 			}
 			break;
@@ -16,7 +16,6 @@
 void TempSensor__Initialize(void);
 void TempSensor__Configure(void);
 void TempSensor__StartAcquisition(void);
-uint8_t TempSensor__IsTemperatureReady(void);
 int16_t TempSensor__GetTemperature(void);
 void TempSensor__1msTask(void);
 
@@ -10,7 +10,6 @@
 
 // User parameters
 #define TIMER_PRESCALER 	64
-#define TIMER_COMPARE_VALUE 250
 
 #if (TIMER_PRESCALER == 1)
 	#define TIMER_PRESC_SHIFT 0
@@ -26,7 +25,13 @@
 	#error "Invalid timer prescaler value!!"
 #endif
 
-uint16_t Timer_Counter;
+#define TIMER_MICROS_PER_COUNT (1000000UL / (F_CPU >> TIMER_PRESC_SHIFT))
+
+#if ((TIMER_MICROS_PER_COUNT * TIMER_PERIOD_COUNTS) != 1000UL)
+	#error "Timer period is not 1 ms!!"
+#endif
+
+volatile uint32_t Timer_Millis;
 
 static uint32_t Timer_Frequency;
 
@@ -44,7 +49,7 @@ void Timer__Initialize(void)
 	TIMSK0 |= (1 << OCIE0A);
 
 	Timer_Frequency = Micro__GetClockFrequency() >> TIMER_PRESC_SHIFT;
-	Timer_Counter = 0;
+	Timer_Millis = 0;
 	Timer__Start();
 
 }
@@ -64,3 +69,48 @@ void Timer__Start(void)
         TCCR0B |= (1  << CS02) | (0 << CS01) | (1 << CS00);
     #endif
 }
+
+/**
+ * @brief Milliseconds elapsed since the timer start
+ *
+ * @remarks Wraps around after about 49 days
+ */
+uint32_t Timer__GetMillis(void)
+{
+    uint32_t result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = Timer_Millis;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Microseconds elapsed since the timer start
+ *
+ * @details The millisecond count is combined with the live counter
+ *          value, so the resolution is the one of the timer clock (4 us).
+ *          If the compare match happened but its ISR did not run yet,
+ *          the pending millisecond is accounted here.
+ *
+ * @remarks Wraps around after about 71 minutes
+ */
+uint32_t Timer__GetMicros(void)
+{
+    uint32_t millis;
+    uint8_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        millis = Timer_Millis;
+        count = TCNT0;
+        if ((TIFR0 & (1 << OCF0A)) && count < TIMER_COMPARE_VALUE)
+        {
+            millis++;
+        }
+    }
+
+    return (millis * 1000UL) + (uint16_t)(count * TIMER_MICROS_PER_COUNT);
+}
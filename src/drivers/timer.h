@@ -11,14 +11,22 @@
 
 #include "micro.h"
 
-extern uint16_t Timer_Counter;
+// Compare value of the 1 ms tick
+#define TIMER_COMPARE_VALUE 249
+// Timer counts in one tick period (CTC counts from 0 to the compare value)
+#define TIMER_PERIOD_COUNTS (TIMER_COMPARE_VALUE + 1)
+
+extern volatile uint32_t Timer_Millis;
 
 #define Timer__Stop() {TCCR0B &= 0b11111000;}
-#define Timer__GetCounter() Timer_Counter
-#define Timer__ResetCounter() {Timer_Counter = 0;}
+#define Timer__GetTimerCount() TCNT0
+// To be called by the compare match ISR only
+#define Timer__IncrementMillis() {Timer_Millis++;}
 
 void Timer__Initialize(void);
 void Timer__Start(void);
+uint32_t Timer__GetMillis(void);
+uint32_t Timer__GetMicros(void);
 
 
 #endif /* TIMER_H_ */
@@ -5,24 +5,71 @@
  * \author: Leonardo Ricupero
  */ 
 
+#include <stddef.h>
 #include "micro.h"
 #include "usart.h"
+#include "profiler.h"
 
-#define BAUD_PRESCALE (uint16_t) ((F_CPU / (16.0f * USART_BAUDRATE)) -1)
+// Baud rate register values, rounded to nearest, for normal and double speed
+#define UBRR_NORMAL ((F_CPU + 8UL * USART_BAUDRATE) / (16UL * USART_BAUDRATE) - 1UL)
+#define UBRR_U2X    ((F_CPU + 4UL * USART_BAUDRATE) / (8UL * USART_BAUDRATE) - 1UL)
 
-#define TX_BUFFER_SIZE 16
-#define RX_BUFFER_SIZE 16
+// Actual baud rates and their error in permille
+#define BAUD_NORMAL (F_CPU / (16UL * (UBRR_NORMAL + 1UL)))
+#define BAUD_U2X    (F_CPU / (8UL * (UBRR_U2X + 1UL)))
+#define BAUD_ERROR_PERMILLE(baud) \
+    ((((baud) > USART_BAUDRATE) ? ((baud) - USART_BAUDRATE) : (USART_BAUDRATE - (baud))) * 1000UL / USART_BAUDRATE)
 
-static uint8_t Tx_Buffer[TX_BUFFER_SIZE];
-static uint8_t Rx_Buffer[RX_BUFFER_SIZE];
+// Double speed is used only if it is more accurate, since it halves
+// the receiver tolerance
+#if (BAUD_ERROR_PERMILLE(BAUD_U2X) < BAUD_ERROR_PERMILLE(BAUD_NORMAL))
+    #define USART_USE_U2X 1
+    #define BAUD_PRESCALE UBRR_U2X
+    #define BAUD_ERROR BAUD_ERROR_PERMILLE(BAUD_U2X)
+#else
+    #define USART_USE_U2X 0
+    #define BAUD_PRESCALE UBRR_NORMAL
+    #define BAUD_ERROR BAUD_ERROR_PERMILLE(BAUD_NORMAL)
+#endif
 
-static uint8_t Tx_Idx;
-static uint8_t Rx_Idx;
+#if (BAUD_ERROR > 20)
+    #error "USART baud rate error greater than 2%!!"
+#endif
+#if (BAUD_PRESCALE > 4095)
+    #error "USART baud rate too low!!"
+#endif
+
+#define TX_BUFFER_MASK (USART_TX_BUFFER_SIZE - 1)
+#define RX_BUFFER_MASK (USART_RX_BUFFER_SIZE - 1)
+
+#if ((USART_TX_BUFFER_SIZE & TX_BUFFER_MASK) || (USART_TX_BUFFER_SIZE > 128))
+    #error "Invalid USART TX buffer size!!"
+#endif
+#if ((USART_RX_BUFFER_SIZE & RX_BUFFER_MASK) || (USART_RX_BUFFER_SIZE > 128))
+    #error "Invalid USART RX buffer size!!"
+#endif
+
+// Head indexes are written by the producer, tail indexes by the consumer
+static uint8_t Tx_Buffer[USART_TX_BUFFER_SIZE];
+static volatile uint8_t Tx_Head;
+static volatile uint8_t Tx_Tail;
+
+// Frame sent in place from the caller buffer, ahead of the TX buffer
+static const uint8_t* Tx_Frame;
+static volatile uint8_t Tx_Frame_Length;
+static USART_TX_CALLBACK_T Tx_Frame_Callback;
+
+static uint8_t Rx_Buffer[USART_RX_BUFFER_SIZE];
+static volatile uint8_t Rx_Head;
+static volatile uint8_t Rx_Tail;
+static uint16_t Rx_Overruns;
+static USART_RX_CALLBACK_T Rx_Callback;
 
 /**
  * \brief Initializes the USART
  * 
- * Interrupt disabled
+ * RX complete interrupt enabled, data register empty interrupt
+ * enabled only while there is data to transmit
  *
  * \return void
  */
@@ -31,11 +78,16 @@ void Usart__Initialize(void)
 	// Baud rate setting
 	UBRR0H = (uint8_t) (BAUD_PRESCALE >> 8);
 	UBRR0L = (uint8_t) BAUD_PRESCALE;
+#if (USART_USE_U2X == 1)
+	UCSR0A |= (1 << U2X0);
+#else
+	UCSR0A &= ~(1 << U2X0);
+#endif
 
 	// Frame format: 8 data bit, no parity, 1 stop bit
 	UCSR0C = (3 << UCSZ00);
 
-	// Interrupts enable - RX and data empty
+	// Interrupts enable - RX
 	UCSR0B = 0;
 	UCSR0B |= (1 << RXCIE0);
 
@@ -43,38 +95,133 @@ void Usart__Initialize(void)
     UCSR0B |= (1 << RXEN0) | (1 << TXEN0);
 
     // Buffers initialization
-    Tx_Idx = 0;
-    Rx_Idx = 0;
+    Tx_Head = 0;
+    Tx_Tail = 0;
+    Tx_Frame_Length = 0;
+    Rx_Head = 0;
+    Rx_Tail = 0;
+    Rx_Overruns = 0;
+    Rx_Callback = NULL;
+}
+
+/**
+ * \brief Hand the received bytes to a callback instead of the buffer
+ *
+ * \param callback called from the RX ISR, NULL to use the RX buffer
+ */
+void Usart__SetRxCallback(USART_RX_CALLBACK_T callback)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Rx_Callback = callback;
+    }
 }
 
+/**
+ * \brief Get the oldest received byte
+ *
+ * \remarks Check Usart__IsRxBufferEmpty() first, 0 is returned if
+ *          the buffer is empty
+ */
 uint8_t Usart__GetChar(void)
 {
     uint8_t c = 0;
+    uint8_t tail = Rx_Tail;
 
-    c = Rx_Buffer[Rx_Idx];
-    if (Rx_Idx >= 0)
+    if (tail != Rx_Head)
     {
-        Rx_Idx--;
+        c = Rx_Buffer[tail];
+        Micro__MemoryBarrier();
+        Rx_Tail = (tail + 1) & RX_BUFFER_MASK;
     }
 
     return c;
 }
 
-void Usart__PutChar(uint8_t c)
+BOOL_T Usart__PutChar(uint8_t c)
 {
-    if (Tx_Idx >= TX_BUFFER_SIZE - 1)
+    return (BOOL_T)Usart__Write(&c, 1);
+}
+
+/**
+ * \brief Queue bytes for transmission without blocking
+ *
+ * \remarks To be called from the main loop only
+ *
+ * \return number of bytes accepted, less than length if the buffer is full
+ */
+uint8_t Usart__Write(const uint8_t* data, uint8_t length)
+{
+    uint8_t count = 0;
+    uint8_t head = Tx_Head;
+    uint8_t next;
+
+    while (count < length)
     {
-        Tx_Idx = 0;
+        next = (head + 1) & TX_BUFFER_MASK;
+        if (next == Tx_Tail)
+        {
+            break;
+        }
+        Tx_Buffer[head] = data[count];
+        head = next;
+        count++;
     }
-    Tx_Buffer[Tx_Idx] = c;
-    Tx_Idx++;
+
+    if (count != 0)
+    {
+        Micro__MemoryBarrier();
+        Tx_Head = head;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            UCSR0B |= (1 << UDRIE0);
+        }
+    }
+
+    return count;
+}
+
+/**
+ * \brief Send a frame straight from the caller buffer, without copying it
+ *        into the TX buffer
+ *
+ * \details The buffer must be left untouched until the callback. The frame
+ *          goes out before the bytes waiting in the TX buffer.
+ *
+ * \param callback called from the UDRE ISR when the buffer is free again,
+ *                 it may send the next frame
+ *
+ * \return FALSE if a frame is still being sent
+ */
+BOOL_T Usart__WriteFrame(const uint8_t* data, uint8_t length, USART_TX_CALLBACK_T callback)
+{
+    BOOL_T result = FALSE;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (Tx_Frame_Length == 0 && length != 0)
+        {
+            Tx_Frame = data;
+            Tx_Frame_Callback = callback;
+            Tx_Frame_Length = length;
+            UCSR0B |= (1 << UDRIE0);
+            result = TRUE;
+        }
+    }
+
+    return result;
+}
+
+uint8_t Usart__GetTxFreeSpace(void)
+{
+    return (Tx_Tail - Tx_Head - 1) & TX_BUFFER_MASK;
 }
 
 BOOL_T Usart__IsRxBufferEmpty(void)
 {
     uint8_t res = TRUE;
 
-    if (Rx_Idx != 0)
+    if (Rx_Head != Rx_Tail)
     {
         res = FALSE;
     }
@@ -86,7 +233,7 @@ BOOL_T Usart__IsTxBufferEmpty(void)
 {
     uint8_t res = TRUE;
 
-    if (Tx_Idx != 0)
+    if (Tx_Head != Tx_Tail || Tx_Frame_Length != 0)
     {
         res = FALSE;
     }
@@ -94,27 +241,70 @@ BOOL_T Usart__IsTxBufferEmpty(void)
     return res;
 }
 
+/**
+ * \brief Number of received bytes dropped because the buffer was full
+ */
+uint16_t Usart__GetRxOverrunCount(void)
+{
+    uint16_t result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = Rx_Overruns;
+    }
+
+    return result;
+}
+
 ISR(USART_RX_vect)
 {
-    Rx_Buffer[Rx_Idx] = UDR0;
-    if (Rx_Idx < RX_BUFFER_SIZE)
+    uint8_t c;
+    uint8_t next;
+
+    PROFILER_ENTER(PROFILER_ID_ISR_USART_RX);
+    c = UDR0;
+    if (Rx_Callback != NULL)
     {
-        Rx_Idx++;
+        Rx_Callback(c);
     }
     else
     {
-        Rx_Idx = 0;
+        next = (Rx_Head + 1) & RX_BUFFER_MASK;
+        if (next != Rx_Tail)
+        {
+            Rx_Buffer[Rx_Head] = c;
+            Micro__MemoryBarrier();
+            Rx_Head = next;
+        }
+        else
+        {
+            Rx_Overruns++;
+        }
     }
+    PROFILER_EXIT(PROFILER_ID_ISR_USART_RX);
 }
 
-void Usart__FastTask(void)
+ISR(USART_UDRE_vect)
 {
-    if (Tx_Idx > 0)
+    uint8_t tail = Tx_Tail;
+
+    if (Tx_Frame_Length != 0)
     {
-        if ((UCSR0A & (1<<UDRE0)) == 1)
+        UDR0 = *Tx_Frame++;
+        Tx_Frame_Length--;
+        if (Tx_Frame_Length == 0 && Tx_Frame_Callback != NULL)
         {
-            Tx_Idx--;
-            UDR0 = Tx_Buffer[Tx_Idx];
+            Tx_Frame_Callback();
         }
     }
+    else if (tail != Tx_Head)
+    {
+        UDR0 = Tx_Buffer[tail];
+        Tx_Tail = (tail + 1) & TX_BUFFER_MASK;
+    }
+    else
+    {
+        // Nothing left, stop the interrupt until the next write
+        UCSR0B &= ~(1 << UDRIE0);
+    }
 }
@@ -11,13 +11,38 @@
 
 #include "micro.h"
 
-#define USART_BAUDRATE 9600
+/*
+ * Supported baud rates at 16 MHz (error within 2%):
+ * 9600, 19200, 38400, 57600, 76800, 250000, 500000, 1000000.
+ * The rate is checked at compile time.
+ */
+#ifndef USART_BAUDRATE
+    #define USART_BAUDRATE 9600
+#endif
+
+// Buffer sizes, must be powers of 2 not greater than 128
+#ifndef USART_TX_BUFFER_SIZE
+    #define USART_TX_BUFFER_SIZE 64
+#endif
+#ifndef USART_RX_BUFFER_SIZE
+    #define USART_RX_BUFFER_SIZE 16
+#endif
+
+// Called from the RX ISR for each received byte
+typedef void (*USART_RX_CALLBACK_T)(uint8_t c);
+// Called from the UDRE ISR once the last byte of a frame is loaded, the
+// frame buffer is free again
+typedef void (*USART_TX_CALLBACK_T)(void);
 
 void Usart__Initialize(void);
+void Usart__SetRxCallback(USART_RX_CALLBACK_T callback);
 uint8_t Usart__GetChar(void);
-void Usart__PutChar(uint8_t c);
+BOOL_T Usart__PutChar(uint8_t c);
+uint8_t Usart__Write(const uint8_t* data, uint8_t length);
+BOOL_T Usart__WriteFrame(const uint8_t* data, uint8_t length, USART_TX_CALLBACK_T callback);
+uint8_t Usart__GetTxFreeSpace(void);
 BOOL_T Usart__IsRxBufferEmpty(void);
 BOOL_T Usart__IsTxBufferEmpty(void);
-void Usart__FastTask(void);
+uint16_t Usart__GetRxOverrunCount(void);
 
 #endif /* USART_H_ */
@@ -0,0 +1,212 @@
+/**
+ * @file events.c
+ *
+ * @brief Event queues and dispatcher
+ *
+ * @details Events are posted to one of two single-producer /
+ *          single-consumer ring buffers: one written by the ISRs, one
+ *          written by the main loop. Both are read by the dispatcher in
+ *          the main loop only.
+ *          The producer only writes the head index and the consumer only
+ *          writes the tail index, both single bytes, so no interrupt
+ *          locking is needed. Since ISRs are never nested, all the ISRs
+ *          together count as a single producer.
+ *
+ *          The dispatcher routes each event to the handlers subscribed
+ *          to its type in the subscription table.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include "micro.h"
+#include "timer.h"
+#include "thermostat.h"
+#include "telemetry.h"
+#include "radio.h"
+#include "ui.h"
+#include "protocol.h"
+#include "events.h"
+
+// Must be a power of 2
+#define EVENTS_QUEUE_SIZE 8
+#define EVENTS_QUEUE_MASK (EVENTS_QUEUE_SIZE - 1)
+
+#if (EVENTS_QUEUE_SIZE & EVENTS_QUEUE_MASK)
+    #error "Event queue size must be a power of 2!!"
+#endif
+
+typedef struct {
+    EVENT_T buffer[EVENTS_QUEUE_SIZE];
+    volatile uint8_t head; // written by the producer only
+    volatile uint8_t tail; // written by the consumer only
+    uint16_t lost;         // written by the producer only
+} EVENT_QUEUE_T;
+
+typedef struct {
+    EVENT_TYPE_T type;
+    EVENT_HANDLER_T handler;
+} EVENT_SUBSCRIPTION_T;
+
+static const EVENT_SUBSCRIPTION_T Subscription_Table[] = {
+    {EVENT_TEMPERATURE_READY, Thermostat__OnTemperatureReady},
+    {EVENT_TEMPERATURE_READY, Telemetry__OnTemperatureReady},
+    {EVENT_RELAY_DONE,        Telemetry__OnRelayDone},
+    {EVENT_RADIO_IRQ,         Radio__OnIrq},
+    {EVENT_RADIO_IRQ,         Ui__OnRadioIrq},
+    {EVENT_SERIAL_FRAME,      Protocol__OnFrame},
+    {EVENT_RADIO_RX_PAYLOAD,  Radio__OnRxPayload},
+    {EVENT_SENSOR_FAULT,      Telemetry__OnSensorFault},
+};
+
+#define NUM_SUBSCRIPTIONS (sizeof(Subscription_Table) / sizeof(Subscription_Table[0]))
+
+static EVENT_QUEUE_T Isr_Queue;
+static EVENT_QUEUE_T Task_Queue;
+
+static BOOL_T Push(EVENT_QUEUE_T* queue, EVENT_TYPE_T type, uint8_t arg, uint16_t payload, uint32_t timestamp);
+static BOOL_T Pop(EVENT_QUEUE_T* queue, EVENT_T* event);
+static void Deliver(const EVENT_T* event);
+
+void Events__Initialize(void)
+{
+    Isr_Queue.head = 0;
+    Isr_Queue.tail = 0;
+    Isr_Queue.lost = 0;
+    Task_Queue.head = 0;
+    Task_Queue.tail = 0;
+    Task_Queue.lost = 0;
+}
+
+/**
+ * @brief Post an event from the main loop
+ *
+ * @return FALSE if the queue is full and the event was dropped
+ */
+BOOL_T Events__Post(EVENT_TYPE_T type, uint8_t arg, uint16_t payload)
+{
+    return Push(&Task_Queue, type, arg, payload, Timer__GetMillis());
+}
+
+/**
+ * @brief Post an event from an ISR
+ *
+ * @remarks Must not be called from an ISR_NOBLOCK handler
+ *
+ * @return FALSE if the queue is full and the event was dropped
+ */
+BOOL_T Events__PostFromIsr(EVENT_TYPE_T type, uint8_t arg, uint16_t payload)
+{
+    // Interrupts are disabled, the clock can be read directly
+    return Push(&Isr_Queue, type, arg, payload, Timer_Millis);
+}
+
+/**
+ * @brief Deliver all the queued events to their subscribers
+ */
+void Events__Dispatch(void)
+{
+    EVENT_T event;
+    BOOL_T found = TRUE;
+
+    while (found)
+    {
+        found = FALSE;
+        if (Pop(&Isr_Queue, &event))
+        {
+            Deliver(&event);
+            found = TRUE;
+        }
+        if (Pop(&Task_Queue, &event))
+        {
+            Deliver(&event);
+            found = TRUE;
+        }
+    }
+}
+
+BOOL_T Events__IsEmpty(void)
+{
+    BOOL_T result = FALSE;
+
+    if (Isr_Queue.head == Isr_Queue.tail &&
+        Task_Queue.head == Task_Queue.tail)
+    {
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Number of events dropped because a queue was full
+ */
+uint16_t Events__GetLostCount(void)
+{
+    uint16_t result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = Isr_Queue.lost + Task_Queue.lost;
+    }
+
+    return result;
+}
+
+static BOOL_T Push(EVENT_QUEUE_T* queue, EVENT_TYPE_T type, uint8_t arg, uint16_t payload, uint32_t timestamp)
+{
+    EVENT_T* slot;
+    uint8_t head = queue->head;
+    uint8_t next = (head + 1) & EVENTS_QUEUE_MASK;
+    BOOL_T result = FALSE;
+
+    if (next != queue->tail)
+    {
+        slot = &queue->buffer[head];
+        slot->type = type;
+        slot->arg = arg;
+        slot->payload = payload;
+        slot->timestamp_ms = timestamp;
+        // The slot must be complete before it is published
+        Micro__MemoryBarrier();
+        queue->head = next;
+        result = TRUE;
+    }
+    else
+    {
+        queue->lost++;
+    }
+
+    return result;
+}
+
+static BOOL_T Pop(EVENT_QUEUE_T* queue, EVENT_T* event)
+{
+    uint8_t tail = queue->tail;
+    BOOL_T result = FALSE;
+
+    if (tail != queue->head)
+    {
+        Micro__MemoryBarrier();
+        *event = queue->buffer[tail];
+        // The slot must be copied before it is released
+        Micro__MemoryBarrier();
+        queue->tail = (tail + 1) & EVENTS_QUEUE_MASK;
+        result = TRUE;
+    }
+
+    return result;
+}
+
+static void Deliver(const EVENT_T* event)
+{
+    uint8_t i;
+
+    for (i = 0; i < NUM_SUBSCRIPTIONS; i++)
+    {
+        if (Subscription_Table[i].type == event->type)
+        {
+            Subscription_Table[i].handler(event);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/**
+ * @file events.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+#include "micro.h"
+
+typedef enum {
+    EVENT_TEMPERATURE_READY = 0, // payload: temperature Q12.4
+    EVENT_RADIO_IRQ,             // payload: none
+    EVENT_RELAY_DONE,            // arg: relay, payload: 1 set, 0 reset
+    EVENT_SERIAL_FRAME,          // arg: frame buffer, payload: frame length
+    EVENT_RADIO_RX_PAYLOAD,      // payload: none
+    EVENT_SENSOR_FAULT,          // arg: sensor
+    EVENT_NUM_TYPES,
+} EVENT_TYPE_T;
+
+typedef struct {
+    uint8_t type;
+    uint8_t arg;
+    uint16_t payload;
+    uint32_t timestamp_ms;
+} EVENT_T;
+
+typedef void (*EVENT_HANDLER_T)(const EVENT_T* event);
+
+void Events__Initialize(void);
+BOOL_T Events__Post(EVENT_TYPE_T type, uint8_t arg, uint16_t payload);
+BOOL_T Events__PostFromIsr(EVENT_TYPE_T type, uint8_t arg, uint16_t payload);
+void Events__Dispatch(void);
+BOOL_T Events__IsEmpty(void);
+uint16_t Events__GetLostCount(void);
+
+#endif /* EVENTS_H_ */
@@ -0,0 +1,121 @@
+/**
+ * @file idle.c
+ *
+ * @brief Idle manager
+ *
+ * @details When no module has pending work, the main loop puts the MCU
+ *          in IDLE sleep mode. Any enabled interrupt (Timer0 tick, Timer1
+ *          1-Wire delay, USART, SPI, INT0) wakes it up, so the wake-up
+ *          latency is bounded by the 1 ms tick.
+ *          Power-save mode is not used: it stops the I/O clock, so
+ *          Timer0 and Timer1, which keep the tick and the 1-Wire timing,
+ *          would stop as well.
+ *
+ *          The time spent sleeping is measured in Timer0 counts and
+ *          reported once per second as a permille of the elapsed time.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <avr/sleep.h>
+#include "micro.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "events.h"
+#include "idle.h"
+
+static uint32_t Sleep_Counts;
+static uint32_t Sleep_Count;
+static uint16_t Sleep_Permille;
+
+static BOOL_T IsSystemIdle(void);
+
+/**
+ * @brief Initialize the idle manager
+ *
+ * @details The peripherals not used by the firmware (ADC, TWI, Timer2)
+ *          are powered down, so they do not draw current while sleeping
+ */
+void Idle__Initialize(void)
+{
+    PRR |= (1 << PRADC) | (1 << PRTWI) | (1 << PRTIM2);
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
+    Sleep_Counts = 0;
+    Sleep_Count = 0;
+    Sleep_Permille = 0;
+}
+
+/**
+ * @brief Sleep until the next interrupt if there is nothing to do
+ *
+ * @details The idle check and the sleep instruction are executed with
+ *          interrupts disabled: the instruction following sei() is
+ *          always executed before any pending interrupt, so an event
+ *          posted after the check still wakes the MCU up.
+ */
+void Idle__Task(void)
+{
+    uint8_t start;
+    uint8_t stop;
+
+    Micro__DisableInterrupts();
+    if (IsSystemIdle())
+    {
+        start = Timer__GetTimerCount();
+        sleep_enable();
+        Micro__EnableInterrupts();
+        sleep_cpu();
+        sleep_disable();
+        stop = Timer__GetTimerCount();
+
+        // The tick wakes the MCU up at least once per period
+        if (stop < start)
+        {
+            stop += TIMER_PERIOD_COUNTS;
+        }
+        Sleep_Counts += stop - start;
+        Sleep_Count++;
+    }
+    else
+    {
+        Micro__EnableInterrupts();
+    }
+}
+
+void Idle__1000msTask(void)
+{
+    // 1 s = 1000 periods, so the permille is counts / period
+    Sleep_Permille = Sleep_Counts / TIMER_PERIOD_COUNTS;
+    Sleep_Counts = 0;
+}
+
+/**
+ * @brief Time spent sleeping during the last second, in permille
+ */
+uint16_t Idle__GetSleepPermille(void)
+{
+    return Sleep_Permille;
+}
+
+/**
+ * @brief Number of times the MCU went to sleep since the start up
+ */
+uint32_t Idle__GetSleepCount(void)
+{
+    return Sleep_Count;
+}
+
+static BOOL_T IsSystemIdle(void)
+{
+    BOOL_T result = FALSE;
+
+    if (Scheduler__IsIdle() &&
+        Events__IsEmpty())
+    {
+        result = TRUE;
+    }
+
+    return result;
+}
@@ -0,0 +1,19 @@
+/**
+ * @file idle.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include "micro.h"
+
+void Idle__Initialize(void);
+void Idle__Task(void);
+void Idle__1000msTask(void);
+uint16_t Idle__GetSleepPermille(void);
+uint32_t Idle__GetSleepCount(void);
+
+#endif /* IDLE_H_ */
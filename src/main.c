@@ -19,56 +19,76 @@
 #include "timer.h"
 #include "usart.h"
 #include "spi.h"
+#include "packet_pool.h"
 #include "radio.h"
+#include "mesh.h"
+#include "tdma.h"
 #include "temp_sensor.h"
 #include "thermostat.h"
+#include "telemetry.h"
 #include "parameters.h"
 #include "relays.h"
 #include "ui.h"
+#include "scheduler.h"
+#include "soft_timer.h"
+#include "events.h"
+#include "idle.h"
+#include "profiler.h"
+#include "protocol.h"
+#include "trace.h"
 #include "main.h"
 
 int main(void)
 {
 	// Initialization routines
+	configLoadDefault();
+	Scheduler__Initialize();
+	SoftTimer__Initialize();
+	Events__Initialize();
 	Timer__Initialize();
 	Usart__Initialize();
+	Spi__Initialize();
+	PacketPool__Initialize();
+	Radio__Initialize();
+	Mesh__Initialize();
+	Tdma__Initialize();
+	Protocol__Initialize();
 	Relays__Initialize();
 	Ui__Initialize();
 	TempSensor__Initialize();
 	Thermostat__Initialize();
+	Telemetry__Initialize();
+	Idle__Initialize();
+#ifdef PROFILER_ENABLED
+	Profiler__Initialize(Protocol__SendProfilerRecord);
+#endif
+#ifdef TRACE_ENABLED
+	Trace__Initialize();
+#endif
 	Micro__EnableInterrupts();
 
 	Ui__LedBlink500ms(5);
+	Radio__TurnOn();
 
 	// Endless loop
 	while(1)
     {
-	    Usart__FastTask();
+	    Scheduler__Run();
+	    Events__Dispatch();
+	    Idle__Task();
     }
 }
 
 /**
  * Timer 0 compare match ISR
  *
- * This shall be triggered every 1 ms
+ * This shall be triggered every 1 ms. The tasks are run by the
+ * scheduler from the main loop, here the tick is only posted.
  */
-ISR(TIMER0_COMPA_vect, ISR_NOBLOCK)
+ISR(TIMER0_COMPA_vect)
 {
-    uint8_t prescaler;
-    
-	// Increment the base counter
-    prescaler = Timer__GetCounter()++;
-
-	// Execute the 1ms tasks
-    TempSensor__1msTask();
-    Relays__1msTask();
-    
-	// Execute the 100ms tasks
-	if (prescaler == 100)
-	{
-	    Timer__ResetCounter();
-        Thermostat__100msTask();
-	    Ui__100msTask();
-	}
-
+    PROFILER_ENTER(PROFILER_ID_ISR_TIMER0);
+    Timer__IncrementMillis();
+    Scheduler__PostTick();
+    PROFILER_EXIT(PROFILER_ID_ISR_TIMER0);
 }
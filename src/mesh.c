@@ -1,14 +1,965 @@
 /**
  * @file mesh.c
  *
+ * @brief Multi-hop routing over the radio
+ *
+ * @details Every node keeps a next-hop table indexed by the destination
+ *          node ID, so a lookup is a single table read.
+ *
+ *          The routes to the gateway come from beacons. The gateway floods
+ *          one every BEACON_PERIOD with its own sequence number; each node
+ *          takes as parent the neighbor that relayed the beacon, adds the
+ *          cost of its link to it (frames per message, from radio_link.c)
+ *          and floods the beacon again, once per sequence number, after a
+ *          random delay so that the neighbors do not collide. A copy of
+ *          the same beacon with a lower cost only updates the route.
+ *
+ *          The routes to the other nodes are learned backwards from the
+ *          data frames: the previous hop of a frame from a source is the
+ *          next hop towards it. A destination with no route is sent
+ *          towards the gateway, which knows the routes of all the nodes
+ *          sending to it.
+ *
+ *          Frames are stored and forwarded: a received frame is queued,
+ *          with its reception time, until its next hop listens (see
+ *          tdma.c) and the radio queue accepts it. The frames sent by the
+ *          node wait in the same queue. Frames are pool packets, the
+ *          header of a received frame is updated in place and the same
+ *          packet goes from the radio RX queue to the forward queue and
+ *          back to the radio TX queue.
+ *
+ *          Every frame carries a priority in its header. The forward
+ *          queue has a depth per priority and hands the highest priority
+ *          frame over first, so an alarm does not wait behind a bulk
+ *          transfer; the telemetry and bulk frames only take
+ *          MESH_RADIO_SLOTS_LOW slots of the radio queue, since a frame
+ *          there can no longer be overtaken. An alarm frame its next hop
+ *          did not acknowledge is queued again, on the route of that
+ *          time, up to ALARM_MAX_RETRIES times. Within a priority the
+ *          sources take turns, so a busy subtree does not starve the
+ *          others. A telemetry frame replaces the one of the same source
+ *          still waiting: it holds a single reading, of which only the
+ *          newest is worth sending. Batches of readings go as bulk.
+ *
+ *          A small cache of the last (source, sequence number) pairs drops
+ *          the copies of a frame, from floods or from a lost ACK; a beacon
+ *          must also be newer than the one the route was taken from.
+ *          Routes not confirmed for ROUTE_MAX_AGE beacon periods, or whose
+ *          next hop missed MAX_LINK_FAILURES frames in a row, are dropped.
+ *          The gateway route is only made the costliest then, there is no
+ *          other way to the gateway until a beacon copy brings one. The
+ *          alarms keep using the last gateway route once it expired.
+ *
  * @date 30/10/2014 18:18:00
  * @author Leo Ricupero
- */ 
+ */
 
+#include <string.h>
+#include "micro.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "soft_timer.h"
+#include "radio.h"
+#include "packet_pool.h"
+#include "radio_link.h"
+#include "radio_channel.h"
+#include "tdma.h"
 #include "mesh.h"
 
-/*
-static const routingTable[MAX_NODES_NUMBER] = {
-	// TO-DO: Fill in with the table
+#define BEACON_PERIOD 5000 // milliseconds
+#define ROUTE_MAX_AGE 3    // beacon periods
+// Frames in a row a next hop may leave unacknowledged
+#define MAX_LINK_FAILURES 3
+// Longest random delay before flooding a beacon again
+#define BEACON_JITTER_MS 16
+// Retries of an alarm frame after the radio ones, and their longest random
+// delay, out of the burst that made it fail
+#define ALARM_MAX_RETRIES 12
+#define ALARM_RETRY_JITTER_MS 16
+
+// Pipe 1 receives on the node address, this one on the broadcast address
+#define NODE_PIPE 1
+#define BROADCAST_PIPE 5
+
+#define FORWARD_QUEUE_SIZE (MESH_QUEUE_DEPTH_ALARM + MESH_QUEUE_DEPTH_CONTROL + \
+                            MESH_QUEUE_DEPTH_TELEMETRY + MESH_QUEUE_DEPTH_BULK)
+#define NO_FRAME 0xFF
+#define SEQ_CACHE_SIZE 8
+
+#define HEADER_SIZE MESH_HEADER_SIZE
+// Beacon payload: uint8 cost of the route to the gateway
+#define BEACON_SIZE (HEADER_SIZE + 1)
+
+typedef struct {
+    uint8_t next_hop;
+    uint8_t priority;    // MESH_PRIORITY_T
+    BOOL_T forwarded;    // FALSE for the frames sent by the node
+    uint8_t retries;     // alarms queued again
+    uint16_t not_before; // scheduler tick
+    uint32_t rx_time_us;
+    PACKET_T* packet;    // one reference, handed over to the radio
+} FORWARD_ENTRY_T;
+
+// Mesh frames in the radio queue, completed in order
+typedef struct {
+    uint32_t rx_time_us;
+    uint8_t next_hop;
+    uint8_t priority;
+    BOOL_T forwarded;
+    uint8_t retries;
+    PACKET_T* packet;    // one reference for the alarms, NULL otherwise
+} IN_FLIGHT_T;
+
+typedef struct {
+    uint8_t source;
+    uint8_t seq;
+} SEQ_ENTRY_T;
+
+static MESH_ROUTE_T Routes[MAX_NODES_NUMBER];
+// Sequence number of the last beacon taken, per source
+static uint8_t Beacon_Seqs[MAX_NODES_NUMBER];
+// Unacknowledged frames in a row, per next hop
+static uint8_t Link_Failures[MAX_NODES_NUMBER];
+
+static const uint8_t Forward_Depths[MESH_NUM_PRIORITIES] = {
+    MESH_QUEUE_DEPTH_ALARM,
+    MESH_QUEUE_DEPTH_CONTROL,
+    MESH_QUEUE_DEPTH_TELEMETRY,
+    MESH_QUEUE_DEPTH_BULK,
+};
+
+// In arrival order, a frame leaves once its next hop listens
+static FORWARD_ENTRY_T Forward_Queue[FORWARD_QUEUE_SIZE];
+static uint8_t Forward_Count;
+static uint8_t Forward_Counts[MESH_NUM_PRIORITIES];
+// Source of the last frame handed over to the radio, per priority
+static uint8_t Last_Source[MESH_NUM_PRIORITIES];
+
+static IN_FLIGHT_T In_Flight[RADIO_TX_QUEUE_SIZE];
+static uint8_t In_Flight_Head;
+static uint8_t In_Flight_Count;
+static uint8_t In_Flight_Low; // telemetry and bulk frames
+
+static SEQ_ENTRY_T Seq_Cache[SEQ_CACHE_SIZE];
+static uint8_t Seq_Cache_Index;
+static uint8_t Seq;
+
+static SOFT_TIMER_T Beacon_Timer;
+static MESH_RX_CALLBACK_T Rx_Callback;
+static RADIO_RX_CALLBACK_T Raw_Callback;
+static MESH_SYNC_CALLBACK_T Sync_Callback;
+static MESH_STATS_T Mesh_Stats;
+
+static void RadioReceiveCallback(uint8_t pipe);
+static void RadioSendCallback(RADIO_STATUS_T status);
+static void HandleData(PACKET_T* packet, uint32_t rx_time_us);
+static void HandleBeacon(PACKET_T* packet, uint32_t rx_time_us);
+static BOOL_T IsDuplicate(uint8_t source, uint8_t seq);
+static void LearnRoute(uint8_t destination, uint8_t next_hop, uint8_t hops);
+static void UpdateLink(uint8_t next_hop, BOOL_T acknowledged);
+static void InvalidateRoutesVia(uint8_t next_hop);
+static void AgeRoutes(void);
+static void SendBeacon(void);
+static BOOL_T SendFrame(uint8_t next_hop, PACKET_T* packet, BOOL_T forwarded, uint32_t rx_time_us, uint8_t retries);
+static BOOL_T RetryAlarm(const IN_FLIGHT_T* in_flight);
+static uint8_t GetAlarmNextHop(uint8_t destination);
+static BOOL_T QueueForward(uint8_t next_hop, PACKET_T* packet, BOOL_T forwarded, uint32_t rx_time_us, uint8_t delay_ms);
+static void WriteHeader(PACKET_T* packet, MESH_TYPE_T type, MESH_PRIORITY_T priority, uint8_t destination);
+static void ForwardFrames(void);
+static uint8_t SelectFrame(void);
+static BOOL_T ReplaceStale(uint8_t next_hop, PACKET_T* packet, uint32_t rx_time_us);
+static uint8_t AddCost(uint8_t a, uint8_t b);
+
+/**
+ * @brief Take over the radio reception. Radio__Initialize() must have been
+ *        called.
+ */
+void Mesh__Initialize(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < MAX_NODES_NUMBER; i++)
+    {
+        Routes[i].next_hop = MESH_NO_ROUTE;
+        Routes[i].age = ROUTE_MAX_AGE;
+        Beacon_Seqs[i] = 0;
+        Link_Failures[i] = 0;
+    }
+    Forward_Count = 0;
+    for (i = 0; i < MESH_NUM_PRIORITIES; i++)
+    {
+        Forward_Counts[i] = 0;
+        Last_Source[i] = RADIO_NODE_ID;
+    }
+    In_Flight_Head = 0;
+    In_Flight_Count = 0;
+    In_Flight_Low = 0;
+    // No node has the broadcast ID as source
+    memset(Seq_Cache, RADIO_BROADCAST_ID, sizeof(Seq_Cache));
+    Seq_Cache_Index = 0;
+    Seq = 0;
+    Rx_Callback = NULL;
+    Raw_Callback = NULL;
+    Sync_Callback = NULL;
+    memset(&Mesh_Stats, 0, sizeof(Mesh_Stats));
+    Mesh_Stats.latency_min_us = UINT32_MAX;
+
+    Radio__OpenPipe(BROADCAST_PIPE, RADIO_BROADCAST_ID);
+    Radio__Receive(RadioReceiveCallback);
+    SoftTimer__StartPeriodic(&Beacon_Timer, BEACON_PERIOD, NULL);
+}
+
+void Mesh__10msTask(void)
+{
+    if (SoftTimer__IsExpired(&Beacon_Timer))
+    {
+        AgeRoutes();
+        if (RADIO_NODE_ID == MESH_GATEWAY_ID)
+        {
+            SendBeacon();
+        }
+    }
+
+    ForwardFrames();
+}
+
+/**
+ * @brief Send a payload to a node, through the mesh
+ *
+ * @details The payload is copied into a pool packet, see
+ *          Mesh__SendPacket()
+ *
+ * @return FALSE if the length is not 1 to MESH_PAYLOAD_SIZE, the packet
+ *         pool is empty, there is no route or the forward queue is full
+ */
+BOOL_T Mesh__Send(uint8_t destination, const uint8_t* payload, uint8_t length, MESH_PRIORITY_T priority)
+{
+    PACKET_T* packet;
+    BOOL_T result = FALSE;
+
+    if (length > 0 && length <= MESH_PAYLOAD_SIZE)
+    {
+        packet = PacketPool__Alloc();
+        if (packet != NULL)
+        {
+            memcpy(&packet->data[HEADER_SIZE], payload, length);
+            result = Mesh__SendPacket(destination, packet, length, priority);
+            PacketPool__Release(packet);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Send the payload of a packet to a node, through the mesh
+ *
+ * @details The payload starts at MESH_HEADER_SIZE in the packet, the
+ *          header is written here. The packet waits in the forward queue,
+ *          which takes its own reference, until the next hop listens.
+ *
+ * @param length  Payload length, header excluded
+ *
+ * @return FALSE if the length is not 1 to MESH_PAYLOAD_SIZE, there is no
+ *         route or the forward queue of the priority is full
+ */
+BOOL_T Mesh__SendPacket(uint8_t destination, PACKET_T* packet, uint8_t length, MESH_PRIORITY_T priority)
+{
+    uint8_t next_hop = (priority == MESH_PRIORITY_ALARM) ? GetAlarmNextHop(destination) : Mesh__GetNextHop(destination);
+    BOOL_T result = FALSE;
+
+    if (length > 0 && length <= MESH_PAYLOAD_SIZE && destination == RADIO_NODE_ID)
+    {
+        // Delivered locally, e.g. the telemetry of the gateway to the host
+        Mesh_Stats.delivered++;
+        if (Rx_Callback != NULL)
+        {
+            Rx_Callback(RADIO_NODE_ID, &packet->data[HEADER_SIZE], length);
+        }
+        result = TRUE;
+    }
+    else if (length > 0 && length <= MESH_PAYLOAD_SIZE && next_hop != MESH_NO_ROUTE)
+    {
+        WriteHeader(packet, MESH_TYPE_DATA, priority, destination);
+        packet->length = HEADER_SIZE + length;
+        result = QueueForward(next_hop, packet, FALSE, 0, 0);
+        if (result)
+        {
+            Seq++;
+            Mesh_Stats.sent++;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @param callback  Called with the payloads addressed to this node
+ */
+void Mesh__Receive(MESH_RX_CALLBACK_T callback)
+{
+    Rx_Callback = callback;
+}
+
+/**
+ * @param callback  Called for the payloads queued on the other pipes (ACK
+ *                  payloads, pipes opened by the host), which it must read
+ */
+void Mesh__ReceiveRaw(RADIO_RX_CALLBACK_T callback)
+{
+    Raw_Callback = callback;
+}
+
+/**
+ * @brief Broadcast a sync frame to the neighbors, at once
+ *
+ * @return FALSE if the length is not 1 to MESH_PAYLOAD_SIZE, the packet
+ *         pool is empty or the radio queue is full
+ */
+BOOL_T Mesh__SendSync(const uint8_t* payload, uint8_t length)
+{
+    PACKET_T* packet;
+    BOOL_T result = FALSE;
+
+    if (length > 0 && length <= MESH_PAYLOAD_SIZE)
+    {
+        packet = PacketPool__Alloc();
+        if (packet != NULL)
+        {
+            WriteHeader(packet, MESH_TYPE_SYNC, MESH_PRIORITY_CONTROL, RADIO_BROADCAST_ID);
+            memcpy(&packet->data[HEADER_SIZE], payload, length);
+            packet->length = HEADER_SIZE + length;
+            result = SendFrame(RADIO_BROADCAST_ID, packet, FALSE, 0, 0);
+            if (result)
+            {
+                Seq++;
+            }
+            PacketPool__Release(packet);
+        }
+    }
+
+    return result;
+}
+
+void Mesh__ReceiveSync(MESH_SYNC_CALLBACK_T callback)
+{
+    Sync_Callback = callback;
+}
+
+/**
+ * @brief Next hop towards a node, towards the gateway if it is unknown
+ *
+ * @return MESH_NO_ROUTE if there is no route
+ */
+uint8_t Mesh__GetNextHop(uint8_t destination)
+{
+    uint8_t next_hop = MESH_NO_ROUTE;
+
+    if (destination < MAX_NODES_NUMBER && Routes[destination].age < ROUTE_MAX_AGE)
+    {
+        next_hop = Routes[destination].next_hop;
+    }
+    else if (destination != RADIO_NODE_ID && destination != RADIO_BROADCAST_ID &&
+             Routes[MESH_GATEWAY_ID].age < ROUTE_MAX_AGE)
+    {
+        next_hop = Routes[MESH_GATEWAY_ID].next_hop;
+    }
+
+    return next_hop;
+}
+
+/**
+ * @return FALSE if there is no valid route to the node
+ */
+BOOL_T Mesh__GetRoute(uint8_t destination, MESH_ROUTE_T* route)
+{
+    BOOL_T result = FALSE;
+
+    if (destination < MAX_NODES_NUMBER && Routes[destination].age < ROUTE_MAX_AGE)
+    {
+        *route = Routes[destination];
+        result = TRUE;
+    }
+
+    return result;
+}
+
+void Mesh__GetStats(MESH_STATS_T* stats)
+{
+    *stats = Mesh_Stats;
+}
+
+/**
+ * @brief Read a payload from the radio, handle it if it is a mesh frame
+ */
+static void RadioReceiveCallback(uint8_t pipe)
+{
+    PACKET_T* packet;
+    MESH_HEADER_T* header;
+    uint32_t rx_time_us;
+
+    if (pipe != NODE_PIPE && pipe != BROADCAST_PIPE && Raw_Callback != NULL)
+    {
+        Raw_Callback(pipe);
+        return;
+    }
+
+    rx_time_us = Timer__GetMicros();
+    packet = Radio__ReadPacket(pipe);
+    if (packet == NULL)
+    {
+        return;
+    }
+
+    header = (MESH_HEADER_T*)packet->data;
+    if ((pipe == NODE_PIPE || pipe == BROADCAST_PIPE) &&
+        packet->length >= HEADER_SIZE && header->sender < MAX_NODES_NUMBER)
+    {
+        switch (header->type & MESH_TYPE_MASK)
+        {
+            case MESH_TYPE_DATA:
+            {
+                HandleData(packet, rx_time_us);
+                break;
+            }
+            case MESH_TYPE_BEACON:
+            {
+                HandleBeacon(packet, rx_time_us);
+                break;
+            }
+            case MESH_TYPE_SYNC:
+            {
+                if (Sync_Callback != NULL)
+                {
+                    Sync_Callback(&packet->data[HEADER_SIZE], packet->length - HEADER_SIZE);
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    // The forward queue keeps its own reference
+    PacketPool__Release(packet);
+}
+
+/**
+ * @brief Completion of a mesh frame sent by the radio
+ */
+static void RadioSendCallback(RADIO_STATUS_T status)
+{
+    IN_FLIGHT_T* entry = &In_Flight[In_Flight_Head];
+    uint32_t latency;
+
+    In_Flight_Head = (In_Flight_Head + 1) % RADIO_TX_QUEUE_SIZE;
+    In_Flight_Count--;
+    if (entry->priority >= MESH_PRIORITY_TELEMETRY)
+    {
+        In_Flight_Low--;
+    }
+
+    if (entry->next_hop < MAX_NODES_NUMBER)
+    {
+        UpdateLink(entry->next_hop, (status == RADIO_STATUS_OK) ? TRUE : FALSE);
+    }
+
+    if (status != RADIO_STATUS_OK && entry->packet != NULL && RetryAlarm(entry))
+    {
+        // The forward queue took over the reference
+        entry->packet = NULL;
+    }
+    else if (status != RADIO_STATUS_OK)
+    {
+        if (entry->forwarded)
+        {
+            Mesh_Stats.forward_failures++;
+        }
+    }
+    else if (entry->forwarded)
+    {
+        Mesh_Stats.forwarded++;
+        // The floods are delayed on purpose
+        if (entry->next_hop != RADIO_BROADCAST_ID)
+        {
+            latency = Timer__GetMicros() - entry->rx_time_us;
+            if (latency < Mesh_Stats.latency_min_us)
+            {
+                Mesh_Stats.latency_min_us = latency;
+            }
+            if (latency > Mesh_Stats.latency_max_us)
+            {
+                Mesh_Stats.latency_max_us = latency;
+            }
+            Mesh_Stats.latency_total_us += latency;
+        }
+    }
+
+    if (entry->packet != NULL)
+    {
+        PacketPool__Release(entry->packet);
+        entry->packet = NULL;
+    }
+
+    // A radio queue slot is free again
+    ForwardFrames();
+}
+
+static void HandleData(PACKET_T* packet, uint32_t rx_time_us)
+{
+    MESH_HEADER_T* header = (MESH_HEADER_T*)packet->data;
+    uint8_t next_hop;
+
+    if (header->source == RADIO_NODE_ID || IsDuplicate(header->source, header->seq))
+    {
+        Mesh_Stats.duplicates++;
+        return;
+    }
+
+    LearnRoute(header->source, header->sender, header->hops + 1);
+
+    if (header->destination == RADIO_NODE_ID)
+    {
+        Mesh_Stats.delivered++;
+        if (Rx_Callback != NULL)
+        {
+            Rx_Callback(header->source, &packet->data[HEADER_SIZE], packet->length - HEADER_SIZE);
+        }
+        return;
+    }
+
+    if ((header->type >> MESH_PRIORITY_SHIFT) == MESH_PRIORITY_ALARM)
+    {
+        next_hop = GetAlarmNextHop(header->destination);
+    }
+    else
+    {
+        next_hop = Mesh__GetNextHop(header->destination);
+    }
+    // Do not send it back where it came from
+    if (next_hop == MESH_NO_ROUTE || next_hop == header->sender || header->hops + 1 >= MESH_MAX_HOPS)
+    {
+        Mesh_Stats.no_route++;
+        return;
+    }
+
+    header->hops++;
+    header->sender = RADIO_NODE_ID;
+    QueueForward(next_hop, packet, TRUE, rx_time_us, 0);
+}
+
+static void HandleBeacon(PACKET_T* packet, uint32_t rx_time_us)
+{
+    MESH_HEADER_T* header = (MESH_HEADER_T*)packet->data;
+    MESH_ROUTE_T* route;
+    uint8_t cost;
+    BOOL_T duplicate;
+
+    if (packet->length < BEACON_SIZE || header->source >= MAX_NODES_NUMBER || header->source == RADIO_NODE_ID)
+    {
+        return;
+    }
+
+    cost = AddCost(packet->data[HEADER_SIZE], RadioLink__GetCost(header->sender));
+    route = &Routes[header->source];
+    // The sequence cache alone forgets a beacon under heavy traffic, and its
+    // copy, back from the next node, would then turn the route around
+    duplicate = IsDuplicate(header->source, header->seq) ||
+                (route->age < ROUTE_MAX_AGE && (int8_t)(header->seq - Beacon_Seqs[header->source]) <= 0);
+
+    // A new beacon renews the route, a copy may only improve it
+    if (!duplicate || route->age >= ROUTE_MAX_AGE || cost < route->cost)
+    {
+        route->next_hop = header->sender;
+        route->hops = header->hops + 1;
+        route->cost = cost;
+        route->age = 0;
+        Beacon_Seqs[header->source] = header->seq;
+    }
+
+    if (!duplicate && header->hops + 1 < MESH_MAX_HOPS)
+    {
+        header->hops++;
+        header->sender = RADIO_NODE_ID;
+        packet->data[HEADER_SIZE] = cost;
+        packet->length = BEACON_SIZE;
+        QueueForward(RADIO_BROADCAST_ID, packet, TRUE, rx_time_us, RadioChannel__GetRandom() % BEACON_JITTER_MS);
+    }
+}
+
+/**
+ * @brief Look a frame up in the cache, add it if it is not there
+ */
+static BOOL_T IsDuplicate(uint8_t source, uint8_t seq)
+{
+    uint8_t i;
+
+    for (i = 0; i < SEQ_CACHE_SIZE; i++)
+    {
+        if (Seq_Cache[i].source == source && Seq_Cache[i].seq == seq)
+        {
+            return TRUE;
+        }
+    }
+
+    Seq_Cache[Seq_Cache_Index].source = source;
+    Seq_Cache[Seq_Cache_Index].seq = seq;
+    Seq_Cache_Index = (Seq_Cache_Index + 1) % SEQ_CACHE_SIZE;
+
+    return FALSE;
+}
+
+/**
+ * @brief Route back to the source of a data frame, the gateway route is
+ *        kept by the beacons
+ */
+static void LearnRoute(uint8_t destination, uint8_t next_hop, uint8_t hops)
+{
+    MESH_ROUTE_T* route;
+
+    if (destination < MAX_NODES_NUMBER && destination != MESH_GATEWAY_ID)
+    {
+        route = &Routes[destination];
+        route->next_hop = next_hop;
+        route->hops = hops;
+        route->cost = AddCost(RadioLink__GetCost(next_hop), (hops - 1) * RADIO_LINK_COST_UNIT);
+        route->age = 0;
+    }
+}
+
+/**
+ * @brief Count the frames a next hop left unacknowledged, a lost ACK or a
+ *        collision alone does not drop its routes
+ */
+static void UpdateLink(uint8_t next_hop, BOOL_T acknowledged)
+{
+    if (acknowledged)
+    {
+        Link_Failures[next_hop] = 0;
+    }
+    else if (++Link_Failures[next_hop] >= MAX_LINK_FAILURES)
+    {
+        Link_Failures[next_hop] = 0;
+        InvalidateRoutesVia(next_hop);
+    }
+}
+
+/**
+ * @brief Drop the routes through a next hop, the others fall back on the
+ *        gateway route, which is kept at the highest cost so that any
+ *        beacon copy replaces it
+ */
+static void InvalidateRoutesVia(uint8_t next_hop)
+{
+    uint8_t i;
+
+    for (i = 0; i < MAX_NODES_NUMBER; i++)
+    {
+        if (Routes[i].next_hop == next_hop && i == MESH_GATEWAY_ID)
+        {
+            Routes[i].cost = UINT8_MAX;
+        }
+        else if (Routes[i].next_hop == next_hop)
+        {
+            Routes[i].age = ROUTE_MAX_AGE;
+        }
+    }
+}
+
+static void AgeRoutes(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < MAX_NODES_NUMBER; i++)
+    {
+        if (Routes[i].age < ROUTE_MAX_AGE)
+        {
+            Routes[i].age++;
+        }
+    }
+}
+
+/**
+ * @brief Start a beacon flood, from the gateway, in the next beacon slot
+ */
+static void SendBeacon(void)
+{
+    PACKET_T* packet = PacketPool__Alloc();
+
+    if (packet != NULL)
+    {
+        WriteHeader(packet, MESH_TYPE_BEACON, MESH_PRIORITY_CONTROL, RADIO_BROADCAST_ID);
+        packet->data[HEADER_SIZE] = 0;
+        packet->length = BEACON_SIZE;
+        if (QueueForward(RADIO_BROADCAST_ID, packet, FALSE, 0, 0))
+        {
+            Seq++;
+        }
+        PacketPool__Release(packet);
+    }
+}
+
+/**
+ * @brief Header of a frame sent by the node, with the next sequence number
+ */
+static void WriteHeader(PACKET_T* packet, MESH_TYPE_T type, MESH_PRIORITY_T priority, uint8_t destination)
+{
+    MESH_HEADER_T* header = (MESH_HEADER_T*)packet->data;
+
+    header->type = type | (priority << MESH_PRIORITY_SHIFT);
+    header->source = RADIO_NODE_ID;
+    header->destination = destination;
+    header->seq = Seq;
+    header->hops = 0;
+    header->sender = RADIO_NODE_ID;
+}
+
+/**
+ * @brief Queue a frame on the radio, keeping track of it for the callback
+ *
+ * @param retries  Times an alarm was queued again, kept with the alarms
+ *                 sent to a node, which may be queued once more
+ */
+static BOOL_T SendFrame(uint8_t next_hop, PACKET_T* packet, BOOL_T forwarded, uint32_t rx_time_us, uint8_t retries)
+{
+    IN_FLIGHT_T* entry;
+    BOOL_T result;
+
+    // The radio queue holds at most RADIO_TX_QUEUE_SIZE mesh frames
+    result = Radio__SendPacket(next_hop, packet, RadioSendCallback);
+    if (result)
+    {
+        entry = &In_Flight[(In_Flight_Head + In_Flight_Count) % RADIO_TX_QUEUE_SIZE];
+        entry->rx_time_us = rx_time_us;
+        entry->next_hop = next_hop;
+        entry->priority = packet->data[0] >> MESH_PRIORITY_SHIFT;
+        entry->forwarded = forwarded;
+        entry->retries = retries;
+        entry->packet = NULL;
+        if (entry->priority == MESH_PRIORITY_ALARM && next_hop != RADIO_BROADCAST_ID)
+        {
+            entry->packet = packet;
+            PacketPool__Retain(packet);
+        }
+        In_Flight_Count++;
+        if (entry->priority >= MESH_PRIORITY_TELEMETRY)
+        {
+            In_Flight_Low++;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @param delay_ms  Random delay of the floods
+ *
+ * @return FALSE if the queue of the frame priority is full, else the queue
+ *         holds a reference to the packet
+ */
+static BOOL_T QueueForward(uint8_t next_hop, PACKET_T* packet, BOOL_T forwarded, uint32_t rx_time_us, uint8_t delay_ms)
+{
+    FORWARD_ENTRY_T* entry;
+    uint8_t priority = packet->data[0] >> MESH_PRIORITY_SHIFT;
+
+    if (priority == MESH_PRIORITY_TELEMETRY && ReplaceStale(next_hop, packet, rx_time_us))
+    {
+        ForwardFrames();
+        return TRUE;
+    }
+
+    if (Forward_Counts[priority] == Forward_Depths[priority])
+    {
+        Mesh_Stats.forward_overflows++;
+        return FALSE;
+    }
+
+    entry = &Forward_Queue[Forward_Count];
+    entry->next_hop = next_hop;
+    entry->priority = priority;
+    entry->forwarded = forwarded;
+    entry->retries = 0;
+    entry->not_before = Scheduler__GetTickCount() + delay_ms;
+    entry->rx_time_us = rx_time_us;
+    entry->packet = packet;
+    PacketPool__Retain(packet);
+    Forward_Count++;
+    Forward_Counts[priority]++;
+
+    ForwardFrames();
+
+    return TRUE;
+}
+
+/**
+ * @brief Queue an alarm frame again after the radio gave up on it, towards
+ *        the next hop of the route at this time
+ *
+ * @return FALSE if it has no retry left, no route or no room in the queue,
+ *         else the queue took over the reference of the in-flight entry
+ */
+static BOOL_T RetryAlarm(const IN_FLIGHT_T* in_flight)
+{
+    const MESH_HEADER_T* header = (const MESH_HEADER_T*)in_flight->packet->data;
+    FORWARD_ENTRY_T* entry;
+    uint8_t next_hop = GetAlarmNextHop(header->destination);
+
+    if (in_flight->retries >= ALARM_MAX_RETRIES || next_hop == MESH_NO_ROUTE ||
+        Forward_Counts[MESH_PRIORITY_ALARM] == Forward_Depths[MESH_PRIORITY_ALARM])
+    {
+        return FALSE;
+    }
+
+    entry = &Forward_Queue[Forward_Count];
+    entry->next_hop = next_hop;
+    entry->priority = MESH_PRIORITY_ALARM;
+    entry->forwarded = in_flight->forwarded;
+    entry->retries = in_flight->retries + 1;
+    entry->not_before = Scheduler__GetTickCount() + RadioChannel__GetRandom() % ALARM_RETRY_JITTER_MS;
+    entry->rx_time_us = in_flight->rx_time_us;
+    entry->packet = in_flight->packet;
+    Forward_Count++;
+    Forward_Counts[MESH_PRIORITY_ALARM]++;
+
+    return TRUE;
+}
+
+/**
+ * @brief Next hop of an alarm frame: with no valid route, the last known one
+ *        towards the gateway, the beacons that keep it alive are the first
+ *        frames lost when the channel is busy
+ */
+static uint8_t GetAlarmNextHop(uint8_t destination)
+{
+    uint8_t next_hop = Mesh__GetNextHop(destination);
+
+    if (next_hop == MESH_NO_ROUTE && destination != RADIO_NODE_ID && destination != RADIO_BROADCAST_ID)
+    {
+        next_hop = Routes[MESH_GATEWAY_ID].next_hop;
+    }
+
+    return next_hop;
+}
+
+/**
+ * @brief Put a telemetry frame in place of the queued one of the same
+ *        source and destination, if any
+ *
+ * @details The queued frame keeps its turn
+ */
+static BOOL_T ReplaceStale(uint8_t next_hop, PACKET_T* packet, uint32_t rx_time_us)
+{
+    const MESH_HEADER_T* header = (const MESH_HEADER_T*)packet->data;
+    const MESH_HEADER_T* queued;
+    FORWARD_ENTRY_T* entry;
+    uint8_t i;
+
+    for (i = 0; i < Forward_Count; i++)
+    {
+        entry = &Forward_Queue[i];
+        queued = (const MESH_HEADER_T*)entry->packet->data;
+        if (entry->priority == MESH_PRIORITY_TELEMETRY &&
+            queued->source == header->source && queued->destination == header->destination)
+        {
+            PacketPool__Release(entry->packet);
+            entry->packet = packet;
+            PacketPool__Retain(packet);
+            entry->next_hop = next_hop;
+            entry->rx_time_us = rx_time_us;
+            Mesh_Stats.replaced++;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * @brief Hand the stored frames whose next hop listens over to the radio,
+ *        in the order of SelectFrame()
+ */
+static void ForwardFrames(void)
+{
+    FORWARD_ENTRY_T* entry;
+    uint8_t i;
+
+    while ((i = SelectFrame()) != NO_FRAME)
+    {
+        entry = &Forward_Queue[i];
+        if (!SendFrame(entry->next_hop, entry->packet, entry->forwarded, entry->rx_time_us, entry->retries))
+        {
+            // The radio queue is full
+            break;
+        }
+
+        Last_Source[entry->priority] = ((MESH_HEADER_T*)entry->packet->data)->source;
+        // The radio queue took its own reference
+        PacketPool__Release(entry->packet);
+        Forward_Counts[entry->priority]--;
+        Forward_Count--;
+        memmove(entry, entry + 1, (Forward_Count - i) * sizeof(FORWARD_ENTRY_T));
+    }
+}
+
+/**
+ * @brief Next frame to hand over to the radio
+ *
+ * @details The highest priority with a frame ready goes first. Within a
+ *          priority, the next source after the last one served in node ID
+ *          order is taken, and the frames of a source leave in order. A
+ *          frame waiting for its delay or for a sleeping next hop does not
+ *          hold back the others. The queue is short enough to be scanned.
+ *
+ * @return The index in Forward_Queue, NO_FRAME if none is ready
+ */
+static uint8_t SelectFrame(void)
+{
+    FORWARD_ENTRY_T* entry;
+    uint8_t priority;
+    uint8_t best;
+    uint8_t best_turn = 0;
+    uint8_t turn;
+    uint8_t i;
+
+    for (priority = 0; priority < MESH_NUM_PRIORITIES; priority++)
+    {
+        if (Forward_Counts[priority] == 0 ||
+            (priority >= MESH_PRIORITY_TELEMETRY && In_Flight_Low >= MESH_RADIO_SLOTS_LOW))
+        {
+            continue;
+        }
+
+        best = NO_FRAME;
+        for (i = 0; i < Forward_Count; i++)
+        {
+            entry = &Forward_Queue[i];
+            if (entry->priority != priority ||
+                (int16_t)(Scheduler__GetTickCount() - entry->not_before) < 0 ||
+                Tdma__GetWakeDelay(entry->next_hop) > 0)
+            {
+                continue;
+            }
+
+            turn = ((MESH_HEADER_T*)entry->packet->data)->source - Last_Source[priority] - 1;
+            if (best == NO_FRAME || turn < best_turn)
+            {
+                best = i;
+                best_turn = turn;
+            }
+        }
+
+        if (best != NO_FRAME)
+        {
+            return best;
+        }
+    }
+
+    return NO_FRAME;
+}
+
+static uint8_t AddCost(uint8_t a, uint8_t b)
+{
+    return ((uint16_t)a + b > UINT8_MAX) ? UINT8_MAX : (uint8_t)(a + b);
 }
-*/
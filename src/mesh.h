@@ -3,14 +3,116 @@
  *
  * \date 30/10/2014 18:18:14
  * \author Leonardo Ricupero
- */ 
+ */
 
 
 #ifndef MESH_H_
 #define MESH_H_
 
+#include "micro.h"
+#include "radio.h"
+
+// Node IDs 0 to N-1 can be routed to
 #define MAX_NODES_NUMBER 16
 
+// Root of the beacon floods, the node linked to the host
+#define MESH_GATEWAY_ID 0x00
+
+#define MESH_NO_ROUTE 0xFF
+
+// Frames travel at most this many hops
+#define MESH_MAX_HOPS 8
+
+typedef enum {
+    MESH_TYPE_DATA = 0,
+    MESH_TYPE_BEACON,
+    MESH_TYPE_SYNC,   // one hop broadcast, relayed by tdma.c
+} MESH_TYPE_T;
+
+// Order in which the queued frames leave, highest first
+typedef enum {
+    MESH_PRIORITY_ALARM = 0, // faults
+    MESH_PRIORITY_CONTROL,   // relay changes, routing, sync, configuration
+    MESH_PRIORITY_TELEMETRY, // single readings, a newer one replaces a queued one
+    MESH_PRIORITY_BULK,      // host data, history uploads, batches of readings
+    MESH_NUM_PRIORITIES,
+} MESH_PRIORITY_T;
+
+// Frames waiting in the forward queue, per priority
+#ifndef MESH_QUEUE_DEPTH_ALARM
+#define MESH_QUEUE_DEPTH_ALARM 4
+#endif
+#ifndef MESH_QUEUE_DEPTH_CONTROL
+#define MESH_QUEUE_DEPTH_CONTROL 2
+#endif
+#ifndef MESH_QUEUE_DEPTH_TELEMETRY
+#define MESH_QUEUE_DEPTH_TELEMETRY 2
+#endif
+#ifndef MESH_QUEUE_DEPTH_BULK
+#define MESH_QUEUE_DEPTH_BULK 2
+#endif
+
+// Radio queue slots that the telemetry and bulk frames may take at the
+// same time, the others are left to the alarms and control frames
+#ifndef MESH_RADIO_SLOTS_LOW
+#define MESH_RADIO_SLOTS_LOW 2
+#endif
+
+// Type byte of the header: MESH_TYPE_T, MESH_PRIORITY_T in the top bits
+#define MESH_TYPE_MASK 0x0F
+#define MESH_PRIORITY_SHIFT 6
+
+// Header of every mesh frame, at the start of the radio payload
+typedef struct {
+    uint8_t type;        // MESH_TYPE_T and MESH_PRIORITY_T
+    uint8_t source;
+    uint8_t destination;
+    uint8_t seq;         // per source, for the duplicate suppression
+    uint8_t hops;        // hops travelled so far
+    uint8_t sender;      // node of the last hop
+} MESH_HEADER_T;
+
+#define MESH_HEADER_SIZE sizeof(MESH_HEADER_T)
+#define MESH_PAYLOAD_SIZE (RADIO_PAYLOAD_SIZE - MESH_HEADER_SIZE)
+
+typedef struct {
+    uint8_t next_hop;
+    uint8_t hops;
+    uint8_t cost; // sum of the link costs, RADIO_LINK_COST_UNIT per frame
+    uint8_t age;  // beacon periods since the route was last confirmed
+} MESH_ROUTE_T;
+
+typedef struct {
+    uint16_t sent;
+    uint16_t delivered;
+    uint16_t forwarded;
+    uint16_t duplicates;
+    uint16_t no_route;          // dropped, no route or too many hops
+    uint16_t forward_failures;  // dropped, the next hop did not ACK
+    uint16_t forward_overflows; // dropped or refused, forward queue full
+    uint16_t replaced;          // telemetry dropped for a newer frame
+    // Forwarding latency, from the reception to the ACK of the next hop
+    uint32_t latency_min_us;
+    uint32_t latency_max_us;
+    uint32_t latency_total_us;
+} MESH_STATS_T;
+
+// Called from the main loop with a payload addressed to this node, which
+// is only valid during the call
+typedef void (*MESH_RX_CALLBACK_T)(uint8_t source, const uint8_t* payload, uint8_t length);
+// Called with the payload of a sync frame, right after its reception
+typedef void (*MESH_SYNC_CALLBACK_T)(const uint8_t* payload, uint8_t length);
 
+void Mesh__Initialize(void);
+void Mesh__10msTask(void);
+BOOL_T Mesh__Send(uint8_t destination, const uint8_t* payload, uint8_t length, MESH_PRIORITY_T priority);
+BOOL_T Mesh__SendPacket(uint8_t destination, PACKET_T* packet, uint8_t length, MESH_PRIORITY_T priority);
+void Mesh__Receive(MESH_RX_CALLBACK_T callback);
+void Mesh__ReceiveRaw(RADIO_RX_CALLBACK_T callback);
+BOOL_T Mesh__SendSync(const uint8_t* payload, uint8_t length);
+void Mesh__ReceiveSync(MESH_SYNC_CALLBACK_T callback);
+uint8_t Mesh__GetNextHop(uint8_t destination);
+BOOL_T Mesh__GetRoute(uint8_t destination, MESH_ROUTE_T* route);
+void Mesh__GetStats(MESH_STATS_T* stats);
 
 #endif /* MESH_H_ */
\ No newline at end of file
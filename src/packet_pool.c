@@ -0,0 +1,120 @@
+/**
+ * @file packet_pool.c
+ *
+ * @brief Pool of packet buffers
+ *
+ * @details The packets are statically allocated and the free ones are
+ *          kept in a singly linked list of indexes, so both the
+ *          allocation and the release take constant time. Packets are
+ *          reference counted: a module that keeps a packet it was handed
+ *          retains it, and every holder releases it when done, so a
+ *          frame can sit in the mesh forward queue and in the radio TX
+ *          queue at the same time without being copied.
+ *
+ *          The high watermark and the exhaustion counter tell whether
+ *          PACKET_POOL_SIZE is right for the traffic: each packet costs
+ *          PACKET_SIZE + 3 bytes of SRAM.
+ *
+ * @remarks Main loop only, the pool is not used by the ISRs.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include "micro.h"
+#include "packet_pool.h"
+
+#define NO_PACKET 0xFF
+
+#if (PACKET_POOL_SIZE >= NO_PACKET)
+    #error "Packet pool too large for 8-bit indexes!!"
+#endif
+
+static PACKET_T Pool[PACKET_POOL_SIZE];
+static uint8_t Next_Free[PACKET_POOL_SIZE];
+static uint8_t Free_Head;
+static uint8_t In_Use;
+static PACKET_POOL_STATS_T Stats;
+
+void PacketPool__Initialize(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < PACKET_POOL_SIZE; i++)
+    {
+        Pool[i].refs = 0;
+        Next_Free[i] = i + 1;
+    }
+    Next_Free[PACKET_POOL_SIZE - 1] = NO_PACKET;
+    Free_Head = 0;
+    In_Use = 0;
+
+    Stats.high_watermark = 0;
+    Stats.allocated = 0;
+    Stats.exhausted = 0;
+}
+
+/**
+ * @brief Take a packet from the pool
+ *
+ * @return the packet, with one reference owned by the caller and a
+ *         length of 0, or NULL if the pool is empty
+ */
+PACKET_T* PacketPool__Alloc(void)
+{
+    PACKET_T* packet;
+
+    if (Free_Head == NO_PACKET)
+    {
+        Stats.exhausted++;
+        return NULL;
+    }
+
+    packet = &Pool[Free_Head];
+    Free_Head = Next_Free[Free_Head];
+    packet->refs = 1;
+    packet->length = 0;
+
+    In_Use++;
+    if (In_Use > Stats.high_watermark)
+    {
+        Stats.high_watermark = In_Use;
+    }
+    Stats.allocated++;
+
+    return packet;
+}
+
+void PacketPool__Retain(PACKET_T* packet)
+{
+    packet->refs++;
+}
+
+/**
+ * @brief Drop one reference, the packet goes back to the pool with the
+ *        last one
+ */
+void PacketPool__Release(PACKET_T* packet)
+{
+    uint8_t index;
+
+    if (--packet->refs == 0)
+    {
+        index = (uint8_t)(packet - Pool);
+        Next_Free[index] = Free_Head;
+        Free_Head = index;
+        In_Use--;
+    }
+}
+
+uint8_t PacketPool__GetFreeCount(void)
+{
+    return PACKET_POOL_SIZE - In_Use;
+}
+
+void PacketPool__GetStats(PACKET_POOL_STATS_T* stats)
+{
+    *stats = Stats;
+    stats->size = PACKET_POOL_SIZE;
+    stats->in_use = In_Use;
+}
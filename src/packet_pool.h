@@ -0,0 +1,50 @@
+/**
+ * @file packet_pool.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef PACKET_POOL_H_
+#define PACKET_POOL_H_
+
+#include <stddef.h>
+#include "micro.h"
+
+// Size of an nRF24L01+ payload
+#define PACKET_SIZE 32
+
+// Worst case of the radio RX queue, the radio TX queue and the mesh
+// forward queues all full (4 + 4 + 7)
+#ifndef PACKET_POOL_SIZE
+#define PACKET_POOL_SIZE 15
+#endif
+
+/**
+ * Packet buffer, passed by pointer between the radio, the mesh, the
+ * telemetry and the serial protocol.
+ * Every holder of a pointer owns one reference and releases it when
+ * done, the buffer goes back to the pool with the last reference.
+ */
+typedef struct {
+    uint8_t data[PACKET_SIZE];
+    uint8_t length;
+    uint8_t refs; // private to the pool
+} PACKET_T;
+
+typedef struct {
+    uint8_t size;
+    uint8_t in_use;
+    uint8_t high_watermark; // packets in use at the same time, at most
+    uint16_t allocated;
+    uint16_t exhausted;     // allocations failed with the pool empty
+} PACKET_POOL_STATS_T;
+
+void PacketPool__Initialize(void);
+PACKET_T* PacketPool__Alloc(void);
+void PacketPool__Retain(PACKET_T* packet);
+void PacketPool__Release(PACKET_T* packet);
+uint8_t PacketPool__GetFreeCount(void);
+void PacketPool__GetStats(PACKET_POOL_STATS_T* stats);
+
+#endif /* PACKET_POOL_H_ */
@@ -6,3 +6,17 @@
  */ 
 
 #include "parameters.h"
+
+PARAM_T config;
+
+/**
+ * @brief Load the default configuration
+ */
+void configLoadDefault(void)
+{
+    config.thermostat.mode = WINTER;
+    config.thermostat.tempSet100 = THERMOSTAT_TEMPERATURE_SET;
+    config.thermostat.hist100 = THERMOSTAT_TEMPERATURE_HISTERESYS;
+    config.reporting.deadband = REPORTING_DEADBAND;
+    config.reporting.heartbeat = REPORTING_HEARTBEAT_S;
+}
@@ -22,6 +22,9 @@
 #define THERMOSTAT_TEMPERATURE_SET          REAL_TO_FIXED_TEMPERATURE(25.0f)
 #define THERMOSTAT_TEMPERATURE_HISTERESYS   REAL_TO_FIXED_TEMPERATURE(1.5f)
 
+#define REPORTING_DEADBAND                  REAL_TO_FIXED_TEMPERATURE(0.25f)
+#define REPORTING_HEARTBEAT_S               600
+
 typedef struct
 {
 	uint8_t		active		: 1;
@@ -34,15 +37,24 @@ typedef struct
 {
 	uint8_t		mode		: 1;
 	uint8_t					: 7;
-	int16_t		tempSet100;
-	uint16_t	hist100;
+	int16_t		tempSet100;		// set point, Q12.4
+	uint16_t	hist100;		// hysteresis, Q12.4
 	state_s state;
 } config_thermostat_s;
 
+typedef struct
+{
+	uint16_t	deadband;		// Q12.4, 0 reports every sample
+	uint16_t	heartbeat;		// s, longest time without a report, 0 none
+} config_reporting_s;
+
 typedef union
 {
-	config_thermostat_s thermostat;
-	uint8_t data[sizeof(config_thermostat_s)];  	
+	struct {
+		config_thermostat_s thermostat;
+		config_reporting_s reporting;
+	};
+	uint8_t data[sizeof(config_thermostat_s) + sizeof(config_reporting_s)];  	
 } PARAM_T;
 
 extern PARAM_T config;
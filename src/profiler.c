@@ -0,0 +1,148 @@
+/**
+ * @file profiler.c
+ *
+ * @brief Execution time profiler
+ *
+ * @details Each entry keeps the number of runs, the minimum, maximum and
+ *          total duration in microseconds. Timestamps are taken from the
+ *          free running uptime clock, unless PROFILER_TIMESTAMP is defined
+ *          by the build: the simulator build (sim/host.h) uses the host
+ *          clock in nanoseconds, the simulated time does not move while
+ *          the firmware code runs.
+ *          The measured duration includes the time spent in the ISRs
+ *          preempting the profiled code.
+ *
+ *          A dump hands the entries in turn to the callback given to
+ *          Profiler__Initialize(): the firmware sends them on the serial
+ *          protocol when MSG_PROFILER_DUMP is received (see protocol.c),
+ *          the simulated nodes to the simulator report (see sim/node.c).
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <stddef.h>
+#include "micro.h"
+#include "profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+#ifndef PROFILER_TIMESTAMP
+    #include "timer.h"
+    #define PROFILER_TIMESTAMP() Timer__GetMicros()
+#endif
+
+#define DUMP_IDLE 0xFF
+
+typedef struct {
+    uint32_t start;
+    uint32_t total_us;
+    uint16_t count;
+    uint16_t min_us;
+    uint16_t max_us;
+} PROFILER_ENTRY_T;
+
+static PROFILER_ENTRY_T Profiler_Table[PROFILER_NUM_ENTRIES];
+static uint8_t Dump_Index;
+static PROFILER_DUMP_CALLBACK_T Dump_Callback;
+
+/**
+ * @param callback  Takes the entries of a dump, NULL if nobody asks for one
+ */
+void Profiler__Initialize(PROFILER_DUMP_CALLBACK_T callback)
+{
+    uint8_t i;
+
+    for (i = 0; i < PROFILER_NUM_ENTRIES; i++)
+    {
+        Profiler_Table[i].start = 0;
+        Profiler_Table[i].total_us = 0;
+        Profiler_Table[i].count = 0;
+        Profiler_Table[i].min_us = 0xFFFF;
+        Profiler_Table[i].max_us = 0;
+    }
+
+    Dump_Index = DUMP_IDLE;
+    Dump_Callback = callback;
+}
+
+void Profiler__Enter(uint8_t id)
+{
+    Profiler_Table[id].start = PROFILER_TIMESTAMP();
+}
+
+void Profiler__Exit(uint8_t id)
+{
+    PROFILER_ENTRY_T* entry = &Profiler_Table[id];
+    uint32_t elapsed;
+    uint16_t duration;
+
+    elapsed = PROFILER_TIMESTAMP() - entry->start;
+    duration = (elapsed > 0xFFFF) ? 0xFFFF : (uint16_t)elapsed;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (duration < entry->min_us)
+        {
+            entry->min_us = duration;
+        }
+        if (duration > entry->max_us)
+        {
+            entry->max_us = duration;
+        }
+        entry->total_us += duration;
+        entry->count++;
+    }
+}
+
+void Profiler__GetStats(uint8_t id, PROFILER_STATS_T* stats)
+{
+    uint32_t total;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stats->count = Profiler_Table[id].count;
+        stats->min_us = Profiler_Table[id].min_us;
+        stats->max_us = Profiler_Table[id].max_us;
+        total = Profiler_Table[id].total_us;
+    }
+
+    stats->mean_us = 0;
+    if (stats->count != 0)
+    {
+        stats->mean_us = total / stats->count;
+    }
+}
+
+void Profiler__RequestDump(void)
+{
+    Dump_Index = 0;
+}
+
+/**
+ * @brief Serve the dump requests
+ *
+ * @details The entries go to the callback until it refuses one, which
+ *          is given again at the next call.
+ */
+void Profiler__10msTask(void)
+{
+    PROFILER_STATS_T stats;
+
+    while (Dump_Index != DUMP_IDLE && Dump_Callback != NULL)
+    {
+        Profiler__GetStats(Dump_Index, &stats);
+        if (!Dump_Callback(Dump_Index, &stats))
+        {
+            break;
+        }
+
+        Dump_Index++;
+        if (Dump_Index == PROFILER_NUM_ENTRIES)
+        {
+            Dump_Index = DUMP_IDLE;
+        }
+    }
+}
+
+#endif /* PROFILER_ENABLED */
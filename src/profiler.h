@@ -0,0 +1,62 @@
+/**
+ * @file profiler.h
+ *
+ * @brief Execution time profiler
+ *
+ * @details Enabled by defining PROFILER_ENABLED at compile time.
+ *          When disabled the PROFILER_ENTER / PROFILER_EXIT macros expand
+ *          to nothing, so the instrumented code is left untouched.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "micro.h"
+#include "scheduler.h"
+
+/**
+ * Profiled entries: the scheduler tasks use their task ID,
+ * the ISRs follow
+ */
+typedef enum {
+    PROFILER_ID_ISR_TIMER0 = SCHEDULER_NUM_TASKS,
+    PROFILER_ID_ISR_TIMER1,
+    PROFILER_ID_ISR_INT0,
+    PROFILER_ID_ISR_USART_RX,
+    PROFILER_ID_ISR_SPI,
+    PROFILER_NUM_ENTRIES,
+} PROFILER_ID_T;
+
+typedef struct {
+    uint16_t count;
+    uint16_t min_us;
+    uint16_t max_us;
+    uint16_t mean_us;
+} PROFILER_STATS_T;
+
+#ifdef PROFILER_ENABLED
+
+#define PROFILER_ENTER(id) Profiler__Enter(id)
+#define PROFILER_EXIT(id) Profiler__Exit(id)
+
+// Takes one entry of a dump, FALSE to be given it again at the next call
+typedef BOOL_T (*PROFILER_DUMP_CALLBACK_T)(uint8_t id, const PROFILER_STATS_T* stats);
+
+void Profiler__Initialize(PROFILER_DUMP_CALLBACK_T callback);
+void Profiler__Enter(uint8_t id);
+void Profiler__Exit(uint8_t id);
+void Profiler__GetStats(uint8_t id, PROFILER_STATS_T* stats);
+void Profiler__RequestDump(void);
+void Profiler__10msTask(void);
+
+#else
+
+#define PROFILER_ENTER(id)
+#define PROFILER_EXIT(id)
+
+#endif /* PROFILER_ENABLED */
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,897 @@
+/**
+ * @file protocol.c
+ *
+ * @brief Framed binary protocol on the USART
+ *
+ * @details Each frame is made of a message ID, a sequence number, the
+ *          payload and a CRC-16/CCITT (MSB first), COBS encoded and
+ *          terminated by a 0x00 delimiter.
+ *
+ *          The parser decodes the COBS stream one byte at a time from
+ *          the USART RX ISR and updates the CRC on the fly, so no line
+ *          buffering is needed. Valid frames are handed over to the main
+ *          loop through EVENT_SERIAL_FRAME, using two frame buffers: one
+ *          being filled by the ISR, the other one being handled.
+ *
+ *          Frames are COBS encoded on the fly from the caller buffers,
+ *          so the radio and mesh frames go to the USART straight from
+ *          their pool packet. The UDRE ISR streams each encoded frame
+ *          from its own buffer, with no copy into the USART TX buffer:
+ *          one frame is encoded while the other one is sent, and the
+ *          end of a frame starts the next one.
+ *
+ *          Replies carry the request ID with MSG_REPLY set and the
+ *          request sequence number. Set commands reply with a status byte.
+ *
+ *          The encoder and the parser are benchmarked on the host by
+ *          src/sim/protocol_bench.c.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "micro.h"
+#include "usart.h"
+#include "crc16.h"
+#include "parameters.h"
+#include "temp_sensor.h"
+#include "relays.h"
+#include "radio.h"
+#include "packet_pool.h"
+#include "radio_link.h"
+#include "radio_channel.h"
+#include "mesh.h"
+#include "tdma.h"
+#include "telemetry.h"
+#include "spi.h"
+#include "profiler.h"
+#include "protocol.h"
+
+#define NUM_RX_FRAMES 2
+#define NUM_TX_FRAMES 2
+
+// COBS adds one byte every 254, plus the first code byte and the delimiter
+#define MAX_ENCODED_FRAME (PROTOCOL_MAX_FRAME + (PROTOCOL_MAX_FRAME / 254) + 2)
+
+#define COBS_DELIMITER 0x00
+#define COBS_MAX_CODE 0xFF
+
+// Receive side, written by the ISR
+static uint8_t Rx_Frames[NUM_RX_FRAMES][PROTOCOL_MAX_FRAME];
+static volatile uint8_t Rx_Frame_Busy[NUM_RX_FRAMES];
+static uint8_t Rx_Frame_Index;
+static uint8_t Rx_Length;
+static uint8_t Rx_Code;
+static uint8_t Rx_Code_Remaining;
+static uint16_t Rx_Crc;
+static BOOL_T Rx_Overflow;
+
+// Send side, a busy frame is released by the UDRE ISR
+static uint8_t Tx_Encoded[NUM_TX_FRAMES][MAX_ENCODED_FRAME];
+static uint8_t Tx_Lengths[NUM_TX_FRAMES];
+static volatile uint8_t Tx_Frame_Busy[NUM_TX_FRAMES];
+static uint8_t Tx_Frame_Index;          // next one to encode
+static volatile uint8_t Tx_Send_Index;  // being sent, or next one to send
+static uint8_t Tx_Out;
+static uint8_t Tx_Code_Index;
+static uint8_t Tx_Code;
+static uint16_t Tx_Crc;
+
+static PROTOCOL_STATS_T Protocol_Stats;
+
+// Sequence numbers of the queued MSG_RADIO_SEND, completed in order
+static uint8_t Radio_Send_Seqs[RADIO_TX_QUEUE_SIZE];
+static uint8_t Radio_Send_Head;
+static uint8_t Radio_Send_Count;
+
+static void ResetParser(void);
+static void AppendDecodedByte(uint8_t c);
+static void EndOfFrame(void);
+static BOOL_T SendFrame(uint8_t msg_id, uint8_t seq, const uint8_t* prefix, uint8_t prefix_length,
+                        const uint8_t* payload, uint8_t length);
+static void EncodeBytes(const uint8_t* bytes, uint8_t length);
+static void EncodeByte(uint8_t c);
+static void FrameSentCallback(void);
+static void SendStatus(uint8_t msg_id, uint8_t seq, PROTOCOL_STATUS_T status);
+static void RadioSendCallback(RADIO_STATUS_T radio_status);
+static void RadioReceiveCallback(uint8_t pipe);
+static void MeshReceiveCallback(uint8_t source, const uint8_t* payload, uint8_t length);
+static void SendMeshStats(uint8_t seq);
+static void SendRoute(uint8_t seq, uint8_t node_id);
+static void SendTdmaStats(uint8_t seq);
+static void SendTelemetryStats(uint8_t seq);
+static void SendPoolStats(uint8_t seq);
+static PROTOCOL_STATUS_T SetReporting(uint8_t node_id, const uint8_t* parameters);
+static void SendRadioStats(uint8_t seq);
+static void SendRadioLink(uint8_t seq, uint8_t node_id);
+static void SendRadioChannels(uint8_t seq);
+static void PutWord(uint8_t* buffer, uint16_t value);
+static void PutLong(uint8_t* buffer, uint32_t value);
+#ifdef SPI_BENCHMARK_ENABLED
+static void SendSpiBenchmark(uint8_t seq, SPI_CLOCK_T clock);
+#endif
+
+void Protocol__Initialize(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < NUM_RX_FRAMES; i++)
+    {
+        Rx_Frame_Busy[i] = FALSE;
+    }
+    Rx_Frame_Index = 0;
+    for (i = 0; i < NUM_TX_FRAMES; i++)
+    {
+        Tx_Frame_Busy[i] = FALSE;
+    }
+    Tx_Frame_Index = 0;
+    Tx_Send_Index = 0;
+    ResetParser();
+
+    Protocol_Stats.rx_frames = 0;
+    Protocol_Stats.rx_errors = 0;
+    Protocol_Stats.rx_dropped = 0;
+    Protocol_Stats.tx_frames = 0;
+    Protocol_Stats.tx_dropped = 0;
+    Radio_Send_Head = 0;
+    Radio_Send_Count = 0;
+
+    Usart__SetRxCallback(Protocol__ParseByte);
+    // Relay the received radio and mesh payloads to the host
+    Mesh__ReceiveRaw(RadioReceiveCallback);
+    Mesh__Receive(MeshReceiveCallback);
+}
+
+/**
+ * @brief Feed one received byte to the parser
+ *
+ * @remarks Called from the USART RX ISR
+ */
+void Protocol__ParseByte(uint8_t c)
+{
+    if (c == COBS_DELIMITER)
+    {
+        EndOfFrame();
+    }
+    else if (Rx_Code_Remaining == 0)
+    {
+        // New block: the previous one ends with an implicit zero,
+        // unless it was a maximum length block
+        if (Rx_Code != 0 && Rx_Code != COBS_MAX_CODE)
+        {
+            AppendDecodedByte(0);
+        }
+        Rx_Code = c;
+        Rx_Code_Remaining = c - 1;
+    }
+    else
+    {
+        AppendDecodedByte(c);
+        Rx_Code_Remaining--;
+    }
+}
+
+/**
+ * @brief Encode and queue a frame
+ *
+ * @return FALSE if the payload is longer than PROTOCOL_MAX_PAYLOAD or no
+ *         frame buffer is free, in which case nothing is sent
+ */
+BOOL_T Protocol__Send(uint8_t msg_id, uint8_t seq, const uint8_t* payload, uint8_t length)
+{
+    return SendFrame(msg_id, seq, NULL, 0, payload, length);
+}
+
+#ifdef PROFILER_ENABLED
+/**
+ * @brief Send one entry of a profiler dump as a MSG_PROFILER_RECORD: the
+ *        entry ID and the count, min, max and mean values, LSB first
+ *
+ * @return FALSE if no frame buffer is free
+ */
+BOOL_T Protocol__SendProfilerRecord(uint8_t id, const PROFILER_STATS_T* stats)
+{
+    uint8_t record[9];
+
+    record[0] = id;
+    PutWord(&record[1], stats->count);
+    PutWord(&record[3], stats->min_us);
+    PutWord(&record[5], stats->max_us);
+    PutWord(&record[7], stats->mean_us);
+
+    return Protocol__Send(MSG_PROFILER_RECORD, 0, record, sizeof(record));
+}
+#endif
+
+/**
+ * @brief Execute a received command
+ *
+ * @details The event argument is the frame buffer index, the payload
+ *          the decoded frame length without the CRC
+ */
+void Protocol__OnFrame(const EVENT_T* event)
+{
+    const uint8_t* frame = Rx_Frames[event->arg];
+    const uint8_t* payload = &frame[PROTOCOL_HEADER_SIZE];
+    uint8_t length = event->payload - PROTOCOL_HEADER_SIZE;
+    uint8_t msg_id = frame[0];
+    uint8_t seq = frame[1];
+    uint8_t reply[2];
+    int16_t temperature;
+    PROTOCOL_STATUS_T status = PROTOCOL_STATUS_OK;
+
+    switch (msg_id)
+    {
+        case MSG_GET_TEMPERATURE:
+        {
+            temperature = TempSensor__GetTemperature();
+            reply[0] = (uint8_t)temperature;
+            reply[1] = (uint8_t)(temperature >> 8);
+            Protocol__Send(msg_id | MSG_REPLY, seq, reply, 2);
+            break;
+        }
+        case MSG_SET_THERMOSTAT:
+        {
+            if (length != 4)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else
+            {
+                config.thermostat.tempSet100 = (int16_t)(payload[0] | (payload[1] << 8));
+                config.thermostat.hist100 = payload[2] | (payload[3] << 8);
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_SET_RELAY:
+        {
+            if (length != 2)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else if (payload[0] > RELAY_1)
+            {
+                status = PROTOCOL_STATUS_INVALID_VALUE;
+            }
+            else if (payload[1])
+            {
+                Relays__Set((RELAY_T)payload[0]);
+            }
+            else
+            {
+                Relays__Reset((RELAY_T)payload[0]);
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_RADIO_SEND:
+        {
+            if (length < 1)
+            {
+                SendStatus(msg_id, seq, PROTOCOL_STATUS_INVALID_LENGTH);
+            }
+            else if (Radio__Send(payload[0], &payload[1], length - 1, RadioSendCallback))
+            {
+                // Replied by RadioSendCallback()
+                Radio_Send_Seqs[(Radio_Send_Head + Radio_Send_Count) % RADIO_TX_QUEUE_SIZE] = seq;
+                Radio_Send_Count++;
+            }
+            else
+            {
+                SendStatus(msg_id, seq, PROTOCOL_STATUS_BUSY);
+            }
+            break;
+        }
+        case MSG_RADIO_SET_ACK:
+        {
+            if (length < 2)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else if (!Radio__SetAckPayload(payload[0], &payload[1], length - 1))
+            {
+                status = PROTOCOL_STATUS_INVALID_VALUE;
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_RADIO_SET_PIPE:
+        {
+            if (length != 3)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else if (payload[0] >= RADIO_NUM_PIPES)
+            {
+                status = PROTOCOL_STATUS_INVALID_VALUE;
+            }
+            else if (payload[1])
+            {
+                Radio__OpenPipe(payload[0], payload[2]);
+            }
+            else
+            {
+                Radio__ClosePipe(payload[0]);
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_MESH_SEND:
+        {
+            if (length < 2 || length > MESH_PAYLOAD_SIZE + 1)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else if (Mesh__GetNextHop(payload[0]) == MESH_NO_ROUTE)
+            {
+                status = PROTOCOL_STATUS_NO_ROUTE;
+            }
+            else if (!Mesh__Send(payload[0], &payload[1], length - 1, MESH_PRIORITY_BULK))
+            {
+                status = PROTOCOL_STATUS_BUSY;
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_GET_MESH_STATS:
+        {
+            SendMeshStats(seq);
+            break;
+        }
+        case MSG_GET_ROUTE:
+        {
+            if (length != 1)
+            {
+                SendStatus(msg_id, seq, PROTOCOL_STATUS_INVALID_LENGTH);
+            }
+            else
+            {
+                SendRoute(seq, payload[0]);
+            }
+            break;
+        }
+        case MSG_TDMA_SET_FRAME:
+        {
+            if (length != 3)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else if (!Tdma__SetFrame(payload[0] | ((uint16_t)payload[1] << 8), payload[2]))
+            {
+                status = PROTOCOL_STATUS_INVALID_VALUE;
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_TDMA_SET_SLOT:
+        {
+            if (length != 2)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else if (!Tdma__SetSlot(payload[0], payload[1]))
+            {
+                status = PROTOCOL_STATUS_INVALID_VALUE;
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_GET_TDMA_STATS:
+        {
+            SendTdmaStats(seq);
+            break;
+        }
+        case MSG_GET_TELEMETRY:
+        {
+            SendTelemetryStats(seq);
+            break;
+        }
+        case MSG_GET_POOL_STATS:
+        {
+            SendPoolStats(seq);
+            break;
+        }
+        case MSG_SET_REPORTING:
+        {
+            if (length != 5)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else
+            {
+                status = SetReporting(payload[0], &payload[1]);
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+        case MSG_GET_RADIO_STATS:
+        {
+            SendRadioStats(seq);
+            break;
+        }
+        case MSG_GET_RADIO_LINK:
+        {
+            if (length != 1)
+            {
+                SendStatus(msg_id, seq, PROTOCOL_STATUS_INVALID_LENGTH);
+            }
+            else if (payload[0] >= RADIO_LINK_MAX_NODES)
+            {
+                SendStatus(msg_id, seq, PROTOCOL_STATUS_INVALID_VALUE);
+            }
+            else
+            {
+                SendRadioLink(seq, payload[0]);
+            }
+            break;
+        }
+        case MSG_GET_CHANNELS:
+        {
+            SendRadioChannels(seq);
+            break;
+        }
+        case MSG_RADIO_SET_HOP:
+        {
+            if (length != 1)
+            {
+                status = PROTOCOL_STATUS_INVALID_LENGTH;
+            }
+            else if (!Tdma__SetHop(payload[0]))
+            {
+                status = PROTOCOL_STATUS_INVALID_VALUE;
+            }
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+#ifdef PROFILER_ENABLED
+        case MSG_PROFILER_DUMP:
+        {
+            Profiler__RequestDump();
+            SendStatus(msg_id, seq, status);
+            break;
+        }
+#endif
+#ifdef SPI_BENCHMARK_ENABLED
+        case MSG_SPI_BENCHMARK:
+        {
+            if (length != 1)
+            {
+                SendStatus(msg_id, seq, PROTOCOL_STATUS_INVALID_LENGTH);
+            }
+            else if (payload[0] >= SPI_NUM_CLOCKS)
+            {
+                SendStatus(msg_id, seq, PROTOCOL_STATUS_INVALID_VALUE);
+            }
+            else
+            {
+                SendSpiBenchmark(seq, (SPI_CLOCK_T)payload[0]);
+            }
+            break;
+        }
+#endif
+        default:
+        {
+            SendStatus(msg_id, seq, PROTOCOL_STATUS_UNKNOWN_MSG);
+            break;
+        }
+    }
+
+    Rx_Frame_Busy[event->arg] = FALSE;
+}
+
+void Protocol__GetStats(PROTOCOL_STATS_T* stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *stats = Protocol_Stats;
+    }
+}
+
+static void ResetParser(void)
+{
+    Rx_Length = 0;
+    Rx_Code = 0;
+    Rx_Code_Remaining = 0;
+    Rx_Crc = CRC16_INIT;
+    Rx_Overflow = FALSE;
+}
+
+static void AppendDecodedByte(uint8_t c)
+{
+    if (Rx_Length < PROTOCOL_MAX_FRAME)
+    {
+        Rx_Frames[Rx_Frame_Index][Rx_Length] = c;
+        Rx_Length++;
+        Rx_Crc = Crc16__Update(Rx_Crc, c);
+    }
+    else
+    {
+        Rx_Overflow = TRUE;
+    }
+}
+
+static void EndOfFrame(void)
+{
+    uint8_t next;
+
+    if (Rx_Length == 0 && Rx_Code == 0)
+    {
+        // Back-to-back delimiters
+    }
+    else if (Rx_Overflow ||
+             Rx_Code_Remaining != 0 ||
+             Rx_Length < PROTOCOL_HEADER_SIZE + PROTOCOL_CRC_SIZE ||
+             Rx_Crc != 0)
+    {
+        Protocol_Stats.rx_errors++;
+    }
+    else
+    {
+        next = (Rx_Frame_Index + 1) % NUM_RX_FRAMES;
+        if (Rx_Frame_Busy[next])
+        {
+            Protocol_Stats.rx_dropped++;
+        }
+        else
+        {
+            Rx_Frame_Busy[Rx_Frame_Index] = TRUE;
+            if (Events__PostFromIsr(EVENT_SERIAL_FRAME, Rx_Frame_Index, Rx_Length - PROTOCOL_CRC_SIZE))
+            {
+                Protocol_Stats.rx_frames++;
+                Rx_Frame_Index = next;
+            }
+            else
+            {
+                Rx_Frame_Busy[Rx_Frame_Index] = FALSE;
+                Protocol_Stats.rx_dropped++;
+            }
+        }
+    }
+
+    ResetParser();
+}
+
+/**
+ * @brief Encode and queue a frame whose payload is the prefix followed by
+ *        the given bytes, without gathering them first
+ *
+ * @return FALSE if the payload is longer than PROTOCOL_MAX_PAYLOAD or both
+ *         frame buffers are still waiting for the USART
+ */
+static BOOL_T SendFrame(uint8_t msg_id, uint8_t seq, const uint8_t* prefix, uint8_t prefix_length,
+                        const uint8_t* payload, uint8_t length)
+{
+    uint8_t header[PROTOCOL_HEADER_SIZE];
+    uint8_t index = Tx_Frame_Index;
+
+    if (prefix_length + length > PROTOCOL_MAX_PAYLOAD || Tx_Frame_Busy[index])
+    {
+        Protocol_Stats.tx_dropped++;
+        return FALSE;
+    }
+
+    header[0] = msg_id;
+    header[1] = seq;
+    Tx_Out = 1;
+    Tx_Code_Index = 0;
+    Tx_Code = 1;
+    Tx_Crc = CRC16_INIT;
+    EncodeBytes(header, PROTOCOL_HEADER_SIZE);
+    EncodeBytes(prefix, prefix_length);
+    EncodeBytes(payload, length);
+
+    // The CRC bytes are not part of the CRC
+    header[0] = (uint8_t)(Tx_Crc >> 8);
+    header[1] = (uint8_t)Tx_Crc;
+    EncodeByte(header[0]);
+    EncodeByte(header[1]);
+    Tx_Encoded[index][Tx_Code_Index] = Tx_Code;
+    Tx_Encoded[index][Tx_Out++] = COBS_DELIMITER;
+    Tx_Lengths[index] = Tx_Out;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Tx_Frame_Busy[index] = TRUE;
+        // Else the frame being sent starts this one when it ends
+        if (index == Tx_Send_Index)
+        {
+            Usart__WriteFrame(Tx_Encoded[index], Tx_Out, FrameSentCallback);
+        }
+    }
+    Tx_Frame_Index = (index + 1) % NUM_TX_FRAMES;
+    Protocol_Stats.tx_frames++;
+
+    return TRUE;
+}
+
+/**
+ * @brief Release the frame the USART has sent, and send the next one
+ *
+ * @remarks Called from the USART UDRE ISR
+ */
+static void FrameSentCallback(void)
+{
+    uint8_t index = Tx_Send_Index;
+
+    Tx_Frame_Busy[index] = FALSE;
+    index = (index + 1) % NUM_TX_FRAMES;
+    Tx_Send_Index = index;
+    if (Tx_Frame_Busy[index])
+    {
+        Usart__WriteFrame(Tx_Encoded[index], Tx_Lengths[index], FrameSentCallback);
+    }
+}
+
+static void EncodeBytes(const uint8_t* bytes, uint8_t length)
+{
+    uint8_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        Tx_Crc = Crc16__Update(Tx_Crc, bytes[i]);
+        EncodeByte(bytes[i]);
+    }
+}
+
+/**
+ * @brief COBS encoding of one byte into the frame buffer of Tx_Frame_Index
+ */
+static void EncodeByte(uint8_t c)
+{
+    if (c == 0)
+    {
+        Tx_Encoded[Tx_Frame_Index][Tx_Code_Index] = Tx_Code;
+        Tx_Code_Index = Tx_Out++;
+        Tx_Code = 1;
+    }
+    else
+    {
+        Tx_Encoded[Tx_Frame_Index][Tx_Out++] = c;
+        Tx_Code++;
+        if (Tx_Code == COBS_MAX_CODE)
+        {
+            Tx_Encoded[Tx_Frame_Index][Tx_Code_Index] = Tx_Code;
+            Tx_Code_Index = Tx_Out++;
+            Tx_Code = 1;
+        }
+    }
+}
+
+static void SendStatus(uint8_t msg_id, uint8_t seq, PROTOCOL_STATUS_T status)
+{
+    uint8_t reply = status;
+
+    Protocol__Send(msg_id | MSG_REPLY, seq, &reply, 1);
+}
+
+static void RadioSendCallback(RADIO_STATUS_T radio_status)
+{
+    PROTOCOL_STATUS_T status = PROTOCOL_STATUS_OK;
+
+    if (radio_status == RADIO_STATUS_NO_ACK)
+    {
+        status = PROTOCOL_STATUS_NO_ACK;
+    }
+    else if (radio_status != RADIO_STATUS_OK)
+    {
+        status = PROTOCOL_STATUS_BUSY;
+    }
+    SendStatus(MSG_RADIO_SEND, Radio_Send_Seqs[Radio_Send_Head], status);
+    Radio_Send_Head = (Radio_Send_Head + 1) % RADIO_TX_QUEUE_SIZE;
+    Radio_Send_Count--;
+}
+
+static void RadioReceiveCallback(uint8_t pipe)
+{
+    PACKET_T* packet = Radio__ReadPacket(pipe);
+
+    if (packet != NULL)
+    {
+        SendFrame(MSG_RADIO_FRAME, 0, &pipe, 1, packet->data, packet->length);
+        PacketPool__Release(packet);
+    }
+}
+
+static void MeshReceiveCallback(uint8_t source, const uint8_t* payload, uint8_t length)
+{
+    if (!Telemetry__OnMeshFrame(source, payload, length))
+    {
+        SendFrame(MSG_MESH_FRAME, 0, &source, 1, payload, length);
+    }
+}
+
+static void SendMeshStats(uint8_t seq)
+{
+    MESH_STATS_T stats;
+    uint8_t reply[28];
+
+    Mesh__GetStats(&stats);
+    PutWord(&reply[0], stats.sent);
+    PutWord(&reply[2], stats.delivered);
+    PutWord(&reply[4], stats.forwarded);
+    PutWord(&reply[6], stats.duplicates);
+    PutWord(&reply[8], stats.no_route);
+    PutWord(&reply[10], stats.forward_failures);
+    PutWord(&reply[12], stats.forward_overflows);
+    PutWord(&reply[14], stats.replaced);
+    PutLong(&reply[16], stats.latency_min_us);
+    PutLong(&reply[20], stats.latency_max_us);
+    PutLong(&reply[24], stats.latency_total_us);
+    Protocol__Send(MSG_GET_MESH_STATS | MSG_REPLY, seq, reply, sizeof(reply));
+}
+
+static void SendRoute(uint8_t seq, uint8_t node_id)
+{
+    MESH_ROUTE_T route;
+    uint8_t reply[4];
+
+    if (Mesh__GetRoute(node_id, &route))
+    {
+        reply[0] = route.next_hop;
+        reply[1] = route.hops;
+        reply[2] = route.cost;
+        reply[3] = route.age;
+        Protocol__Send(MSG_GET_ROUTE | MSG_REPLY, seq, reply, sizeof(reply));
+    }
+    else
+    {
+        SendStatus(MSG_GET_ROUTE, seq, PROTOCOL_STATUS_NO_ROUTE);
+    }
+}
+
+static void SendTdmaStats(uint8_t seq)
+{
+    TDMA_STATS_T stats;
+    uint8_t reply[14];
+
+    Tdma__GetStats(&stats);
+    PutWord(&reply[0], stats.beacons_received);
+    PutWord(&reply[2], stats.beacons_missed);
+    PutWord(&reply[4], stats.resyncs);
+    PutLong(&reply[6], stats.radio_on_ms);
+    PutLong(&reply[10], stats.elapsed_ms);
+    Protocol__Send(MSG_GET_TDMA_STATS | MSG_REPLY, seq, reply, sizeof(reply));
+}
+
+/**
+ * @brief Set the reporting parameters of this node, or send them from the
+ *        gateway to another one, which applies them in
+ *        Telemetry__OnMeshFrame()
+ */
+static PROTOCOL_STATUS_T SetReporting(uint8_t node_id, const uint8_t* parameters)
+{
+    uint8_t frame[TELEMETRY_CONFIG_SIZE];
+    PROTOCOL_STATUS_T status = PROTOCOL_STATUS_OK;
+
+    if (node_id == RADIO_NODE_ID)
+    {
+        Telemetry__SetReporting(parameters[0] | (parameters[1] << 8), parameters[2] | (parameters[3] << 8));
+    }
+    else if (RADIO_NODE_ID != MESH_GATEWAY_ID)
+    {
+        status = PROTOCOL_STATUS_INVALID_VALUE;
+    }
+    else if (Mesh__GetNextHop(node_id) == MESH_NO_ROUTE)
+    {
+        status = PROTOCOL_STATUS_NO_ROUTE;
+    }
+    else
+    {
+        frame[0] = TELEMETRY_CONFIG_TAG;
+        memcpy(&frame[1], parameters, TELEMETRY_CONFIG_SIZE - 1);
+        if (!Mesh__Send(node_id, frame, sizeof(frame), MESH_PRIORITY_CONTROL))
+        {
+            status = PROTOCOL_STATUS_BUSY;
+        }
+    }
+
+    return status;
+}
+
+static void SendTelemetryStats(uint8_t seq)
+{
+    TELEMETRY_STATS_T stats;
+    uint8_t reply[16];
+
+    Telemetry__GetStats(&stats);
+    PutWord(&reply[0], stats.records);
+    PutWord(&reply[2], stats.frames);
+    PutWord(&reply[4], stats.frames_dropped);
+    PutLong(&reply[6], stats.bytes);
+    PutWord(&reply[10], stats.reported);
+    PutWord(&reply[12], stats.suppressed);
+    PutWord(&reply[14], stats.alarms);
+    Protocol__Send(MSG_GET_TELEMETRY | MSG_REPLY, seq, reply, sizeof(reply));
+}
+
+static void SendPoolStats(uint8_t seq)
+{
+    PACKET_POOL_STATS_T stats;
+    uint8_t reply[7];
+
+    PacketPool__GetStats(&stats);
+    reply[0] = stats.size;
+    reply[1] = stats.in_use;
+    reply[2] = stats.high_watermark;
+    PutWord(&reply[3], stats.allocated);
+    PutWord(&reply[5], stats.exhausted);
+    Protocol__Send(MSG_GET_POOL_STATS | MSG_REPLY, seq, reply, sizeof(reply));
+}
+
+static void SendRadioStats(uint8_t seq)
+{
+    RADIO_STATS_T stats;
+    uint8_t reply[30];
+
+    Radio__GetStats(&stats);
+    PutWord(&reply[0], stats.tx_messages);
+    PutWord(&reply[2], stats.tx_frames);
+    PutLong(&reply[4], stats.tx_air_bytes);
+    PutLong(&reply[8], stats.tx_air_bytes_static);
+    PutWord(&reply[12], stats.rx_messages);
+    PutLong(&reply[14], stats.rx_air_bytes);
+    PutLong(&reply[18], stats.rx_air_bytes_static);
+    PutWord(&reply[22], stats.rx_errors);
+    PutWord(&reply[24], stats.ack_payloads_sent);
+    PutWord(&reply[26], stats.cca_busy);
+    PutWord(&reply[28], stats.cca_forced);
+    Protocol__Send(MSG_GET_RADIO_STATS | MSG_REPLY, seq, reply, sizeof(reply));
+}
+
+static void SendRadioLink(uint8_t seq, uint8_t node_id)
+{
+    RADIO_LINK_T link;
+    uint8_t reply[9];
+
+    RadioLink__GetLink(node_id, &link);
+    reply[0] = link.pa_level;
+    reply[1] = link.retry_delay;
+    reply[2] = link.good_messages;
+    reply[3] = link.bad_messages;
+    reply[4] = link.frames_average;
+    PutWord(&reply[5], link.messages);
+    PutWord(&reply[7], link.lost_messages);
+    Protocol__Send(MSG_GET_RADIO_LINK | MSG_REPLY, seq, reply, sizeof(reply));
+}
+
+static void SendRadioChannels(uint8_t seq)
+{
+    uint8_t reply[2 + RADIO_CHANNEL_NUM_HOPS * sizeof(RADIO_CHANNEL_T)];
+
+    reply[0] = RadioChannel__GetHop();
+    reply[1] = RadioChannel__GetBestHop();
+    RadioChannel__GetChannels((RADIO_CHANNEL_T*)&reply[2]);
+    Protocol__Send(MSG_GET_CHANNELS | MSG_REPLY, seq, reply, sizeof(reply));
+}
+
+#ifdef SPI_BENCHMARK_ENABLED
+static void SendSpiBenchmark(uint8_t seq, SPI_CLOCK_T clock)
+{
+    SPI_BENCHMARK_T result;
+    uint16_t* values = &result.register_polled;
+    uint8_t reply[sizeof(result)];
+    uint8_t i;
+
+    Spi__Benchmark(SPI_DEVICE_RADIO, clock, &result);
+    for (i = 0; i < sizeof(result) / 2; i++)
+    {
+        PutWord(&reply[2 * i], values[i]);
+    }
+    Protocol__Send(MSG_SPI_BENCHMARK | MSG_REPLY, seq, reply, sizeof(reply));
+}
+#endif
+
+static void PutWord(uint8_t* buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void PutLong(uint8_t* buffer, uint32_t value)
+{
+    PutWord(&buffer[0], (uint16_t)value);
+    PutWord(&buffer[2], (uint16_t)(value >> 16));
+}
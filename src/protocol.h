@@ -0,0 +1,83 @@
+/**
+ * @file protocol.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include "micro.h"
+#include "events.h"
+#include "profiler.h"
+
+// Decoded frame: message ID, sequence number, payload, CRC-16
+#define PROTOCOL_HEADER_SIZE 2
+#define PROTOCOL_CRC_SIZE 2
+#define PROTOCOL_MAX_PAYLOAD 33 // node ID or pipe and radio payload
+#define PROTOCOL_MAX_FRAME (PROTOCOL_HEADER_SIZE + PROTOCOL_MAX_PAYLOAD + PROTOCOL_CRC_SIZE)
+
+// Replies use the request ID with the MSG_REPLY bit set
+#define MSG_REPLY 0x80
+
+typedef enum {
+    // Host to node
+    MSG_GET_TEMPERATURE = 0x01, // reply: int16 Q12.4
+    MSG_SET_THERMOSTAT  = 0x02, // int16 set point Q12.4, uint16 hysteresis Q12.4
+    MSG_SET_RELAY       = 0x03, // uint8 relay, uint8 state (1 set, 0 reset)
+    MSG_RADIO_SEND      = 0x04, // uint8 node ID, radio payload, replied once sent
+    MSG_PROFILER_DUMP   = 0x05, // reply: one MSG_PROFILER_RECORD per entry
+    MSG_SPI_BENCHMARK   = 0x06, // uint8 SPI_CLOCK_T, reply: uint16 register polled,
+                                // interrupt, payload polled, interrupt (0.1 us)
+    MSG_RADIO_SET_ACK   = 0x07, // uint8 pipe, payload of its next auto-ACK
+    MSG_GET_RADIO_STATS = 0x08, // reply: RADIO_STATS_T fields in order
+    MSG_RADIO_SET_PIPE  = 0x09, // uint8 pipe, uint8 1 open / 0 close, uint8 node ID
+    MSG_GET_RADIO_LINK  = 0x0A, // uint8 node ID, reply: RADIO_LINK_T fields in order
+    MSG_GET_CHANNELS    = 0x0B, // reply: uint8 hop, uint8 best hop, RADIO_CHANNEL_T per hop
+    MSG_RADIO_SET_HOP   = 0x0C, // uint8 hop of the channel sequence, whole network (gateway only)
+    MSG_MESH_SEND       = 0x0D, // uint8 destination node ID, payload, sent as bulk
+    MSG_GET_MESH_STATS  = 0x0E, // reply: MESH_STATS_T fields in order
+    MSG_GET_ROUTE       = 0x0F, // uint8 node ID, reply: MESH_ROUTE_T fields in order
+    MSG_TDMA_SET_FRAME  = 0x10, // uint16 frame ms, uint8 slot ms (gateway only)
+    MSG_TDMA_SET_SLOT   = 0x11, // uint8 node ID, uint8 slot, 0xFF always on (gateway only)
+    MSG_GET_TDMA_STATS  = 0x12, // reply: TDMA_STATS_T fields in order
+    MSG_GET_TELEMETRY   = 0x13, // reply: TELEMETRY_STATS_T fields in order
+    MSG_SET_REPORTING   = 0x14, // uint8 node ID, uint16 deadband Q12.4, uint16 heartbeat s
+                                // (other nodes: gateway only)
+    MSG_GET_POOL_STATS  = 0x15, // reply: PACKET_POOL_STATS_T fields in order
+    // Node to host, unsolicited
+    MSG_RADIO_FRAME     = 0x40, // uint8 pipe, received radio payload
+    MSG_PROFILER_RECORD = 0x41, // uint8 ID, uint16 count, min, max, mean
+    MSG_TRACE           = 0x42, // trace records, see trace.c
+    MSG_MESH_FRAME      = 0x43, // uint8 source node ID, payload
+} PROTOCOL_MSG_T;
+
+typedef enum {
+    PROTOCOL_STATUS_OK = 0,
+    PROTOCOL_STATUS_UNKNOWN_MSG,
+    PROTOCOL_STATUS_INVALID_LENGTH,
+    PROTOCOL_STATUS_INVALID_VALUE,
+    PROTOCOL_STATUS_BUSY,
+    PROTOCOL_STATUS_NO_ACK,
+    PROTOCOL_STATUS_NO_ROUTE,
+} PROTOCOL_STATUS_T;
+
+typedef struct {
+    uint16_t rx_frames;
+    uint16_t rx_errors;  // CRC, length or framing errors
+    uint16_t rx_dropped; // no free frame buffer
+    uint16_t tx_frames;
+    uint16_t tx_dropped; // payload too long, or both frame buffers still sending
+} PROTOCOL_STATS_T;
+
+void Protocol__Initialize(void);
+void Protocol__ParseByte(uint8_t c);
+BOOL_T Protocol__Send(uint8_t msg_id, uint8_t seq, const uint8_t* payload, uint8_t length);
+void Protocol__OnFrame(const EVENT_T* event);
+void Protocol__GetStats(PROTOCOL_STATS_T* stats);
+#ifdef PROFILER_ENABLED
+BOOL_T Protocol__SendProfilerRecord(uint8_t id, const PROFILER_STATS_T* stats);
+#endif
+
+#endif /* PROTOCOL_H_ */
@@ -0,0 +1,214 @@
+/**
+ * @file scheduler.c
+ *
+ * @brief Table-driven cooperative scheduler
+ *
+ * @details The 1 ms timer interrupt only posts ticks through
+ *          Scheduler__PostTick(). The main loop calls Scheduler__Run(),
+ *          which releases the tasks whose period has elapsed and then
+ *          runs the released tasks one by one, highest priority first.
+ *          A task released again before its previous release has been
+ *          served counts as a missed deadline, a task whose run lasted
+ *          longer than its period counts as an overrun.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include "micro.h"
+#include "temp_sensor.h"
+#include "radio.h"
+#include "mesh.h"
+#include "tdma.h"
+#include "relays.h"
+#include "thermostat.h"
+#include "telemetry.h"
+#include "soft_timer.h"
+#include "idle.h"
+#include "profiler.h"
+#include "trace.h"
+#include "scheduler.h"
+
+#define NO_TASK 0xFF
+
+typedef struct {
+    void (*task)(void);
+    uint16_t period_ms;
+    uint16_t phase_ms; // first release, must be lower than the period
+    uint8_t priority;  // 0 is the highest priority
+} SCHEDULER_TASK_T;
+
+static const SCHEDULER_TASK_T Task_Table[SCHEDULER_NUM_TASKS] = {
+    [SCHEDULER_TASK_SOFT_TIMER]  = {SoftTimer__1msTask,    1,    0,  0},
+    [SCHEDULER_TASK_RELAYS]      = {Relays__1msTask,       1,    0,  1},
+    [SCHEDULER_TASK_TEMP_SENSOR] = {TempSensor__1msTask,   1,    0,  2},
+    [SCHEDULER_TASK_RADIO]       = {Radio__1msTask,        1,    0,  3},
+    [SCHEDULER_TASK_TDMA]        = {Tdma__1msTask,         1,    0,  4},
+    [SCHEDULER_TASK_MESH]        = {Mesh__10msTask,        10,   3,  5},
+    [SCHEDULER_TASK_THERMOSTAT]  = {Thermostat__100msTask, 100,  0,  6},
+    [SCHEDULER_TASK_TELEMETRY]   = {Telemetry__100msTask,  100,  50, 7},
+    [SCHEDULER_TASK_IDLE]        = {Idle__1000msTask,      1000, 0,  8},
+#ifdef PROFILER_ENABLED
+    [SCHEDULER_TASK_PROFILER]    = {Profiler__10msTask,    10,   5,  9},
+#endif
+#ifdef TRACE_ENABLED
+    [SCHEDULER_TASK_TRACE]       = {Trace__10msTask,       10,   0,  10},
+#endif
+};
+
+static volatile uint8_t Pending_Ticks;
+static volatile uint16_t Tick_Count;
+
+static uint16_t Task_Countdown[SCHEDULER_NUM_TASKS];
+static BOOL_T Task_Released[SCHEDULER_NUM_TASKS];
+static SCHEDULER_STATS_T Task_Stats[SCHEDULER_NUM_TASKS];
+
+static void ReleaseTasks(void);
+static uint8_t SelectReleasedTask(void);
+
+void Scheduler__Initialize(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < SCHEDULER_NUM_TASKS; i++)
+    {
+        // The countdown is decremented before being checked
+        Task_Countdown[i] = Task_Table[i].phase_ms + 1;
+        Task_Released[i] = FALSE;
+        Task_Stats[i].missed_deadlines = 0;
+        Task_Stats[i].overruns = 0;
+    }
+
+    Pending_Ticks = 0;
+    Tick_Count = 0;
+}
+
+/**
+ * @brief Post a 1 ms tick
+ *
+ * @remarks To be called from the timer ISR only
+ */
+void Scheduler__PostTick(void)
+{
+    if (Pending_Ticks != 0xFF)
+    {
+        Pending_Ticks++;
+    }
+    Tick_Count++;
+}
+
+/**
+ * @brief Run all the released tasks
+ *
+ * @details Returns once no released task is left, so that the caller
+ *          can carry on with the rest of the main loop
+ */
+void Scheduler__Run(void)
+{
+    uint8_t task_id;
+    uint16_t start;
+
+    ReleaseTasks();
+    task_id = SelectReleasedTask();
+
+    while (task_id != NO_TASK)
+    {
+        Task_Released[task_id] = FALSE;
+
+        start = Scheduler__GetTickCount();
+        PROFILER_ENTER(task_id);
+        Task_Table[task_id].task();
+        PROFILER_EXIT(task_id);
+        if ((uint16_t)(Scheduler__GetTickCount() - start) > Task_Table[task_id].period_ms)
+        {
+            Task_Stats[task_id].overruns++;
+        }
+
+        // Higher priority tasks may have been released in the meantime
+        ReleaseTasks();
+        task_id = SelectReleasedTask();
+    }
+}
+
+BOOL_T Scheduler__IsIdle(void)
+{
+    BOOL_T result = TRUE;
+
+    if (Pending_Ticks != 0 ||
+        SelectReleasedTask() != NO_TASK)
+    {
+        result = FALSE;
+    }
+
+    return result;
+}
+
+void Scheduler__GetStats(SCHEDULER_TASK_ID_T task_id, SCHEDULER_STATS_T* stats)
+{
+    *stats = Task_Stats[task_id];
+}
+
+/**
+ * @brief Number of ticks posted since the start up
+ */
+uint16_t Scheduler__GetTickCount(void)
+{
+    uint16_t result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = Tick_Count;
+    }
+
+    return result;
+}
+
+static void ReleaseTasks(void)
+{
+    uint8_t ticks;
+    uint8_t i;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = Pending_Ticks;
+        Pending_Ticks = 0;
+    }
+
+    while (ticks != 0)
+    {
+        for (i = 0; i < SCHEDULER_NUM_TASKS; i++)
+        {
+            Task_Countdown[i]--;
+            if (Task_Countdown[i] == 0)
+            {
+                Task_Countdown[i] = Task_Table[i].period_ms;
+                if (Task_Released[i])
+                {
+                    Task_Stats[i].missed_deadlines++;
+                }
+                Task_Released[i] = TRUE;
+            }
+        }
+        ticks--;
+    }
+}
+
+static uint8_t SelectReleasedTask(void)
+{
+    uint8_t i;
+    uint8_t selected = NO_TASK;
+
+    for (i = 0; i < SCHEDULER_NUM_TASKS; i++)
+    {
+        if (Task_Released[i])
+        {
+            if (selected == NO_TASK ||
+                Task_Table[i].priority < Task_Table[selected].priority)
+            {
+                selected = i;
+            }
+        }
+    }
+
+    return selected;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file scheduler.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "micro.h"
+
+/**
+ * Identifiers of the periodic tasks, also used as index in the task table
+ */
+typedef enum {
+    SCHEDULER_TASK_SOFT_TIMER = 0,
+    SCHEDULER_TASK_RELAYS,
+    SCHEDULER_TASK_TEMP_SENSOR,
+    SCHEDULER_TASK_RADIO,
+    SCHEDULER_TASK_TDMA,
+    SCHEDULER_TASK_MESH,
+    SCHEDULER_TASK_THERMOSTAT,
+    SCHEDULER_TASK_TELEMETRY,
+    SCHEDULER_TASK_IDLE,
+#ifdef PROFILER_ENABLED
+    SCHEDULER_TASK_PROFILER,
+#endif
+#ifdef TRACE_ENABLED
+    SCHEDULER_TASK_TRACE,
+#endif
+    SCHEDULER_NUM_TASKS,
+} SCHEDULER_TASK_ID_T;
+
+typedef struct {
+    uint16_t missed_deadlines; // released again before the previous run started
+    uint16_t overruns;         // a single run lasted longer than the period
+} SCHEDULER_STATS_T;
+
+void Scheduler__Initialize(void);
+void Scheduler__PostTick(void);
+void Scheduler__Run(void);
+BOOL_T Scheduler__IsIdle(void);
+uint16_t Scheduler__GetTickCount(void);
+void Scheduler__GetStats(SCHEDULER_TASK_ID_T task_id, SCHEDULER_STATS_T* stats);
+
+#endif /* SCHEDULER_H_ */
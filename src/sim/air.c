@@ -0,0 +1,273 @@
+/**
+ * @file air.c
+ *
+ * @brief Radio medium shared by the simulated nodes
+ *
+ * @details The nodes are placed by the topology, two nodes hear each
+ *          other within the range. A frame reaches the receivers after
+ *          the configured latency and is handed over once it has fully
+ *          arrived, to the nodes listening for it on its channel since
+ *          its start. It is lost there if another frame from a node in
+ *          range overlapped it on the same channel (no capture effect), or
+ *          at random with the configured loss probability, per receiver.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "air.h"
+
+// Frames on the air or recently ended, for the collisions
+#define MAX_FRAMES 256
+// Longer than any frame (42 bytes at 250 kbps)
+#define FRAME_RETENTION_US 5000
+
+struct AIR_S {
+    uint8_t num_nodes;
+    uint8_t in_range[AIR_MAX_NODES][AIR_MAX_NODES];
+    double loss;
+    uint32_t latency_us;
+    uint32_t random_state;
+    uint64_t now_us;
+    AIR_RECEIVER_T receivers[AIR_MAX_NODES];
+    AIR_FRAME_T frames[MAX_FRAMES];
+    uint16_t num_frames;
+    AIR_STATS_T stats;
+};
+
+static void Place(AIR_T* air, AIR_TOPOLOGY_T topology, double range);
+static int IsCollided(const AIR_T* air, const AIR_FRAME_T* frame, uint8_t receiver);
+static void Deliver(AIR_T* air, const AIR_FRAME_T* frame);
+static double GetRandom(AIR_T* air);
+
+/**
+ * @param range       In grid steps, ignored by AIR_TOPOLOGY_FULL
+ * @param loss        Probability of losing a frame at a receiver
+ * @param latency_us  Propagation delay, added to every frame and ACK
+ */
+AIR_T* Air__Create(uint8_t num_nodes, AIR_TOPOLOGY_T topology, double range, double loss,
+                   uint32_t latency_us, uint32_t seed)
+{
+    AIR_T* air;
+
+    if (num_nodes == 0 || num_nodes > AIR_MAX_NODES)
+    {
+        return NULL;
+    }
+
+    air = calloc(1, sizeof(AIR_T));
+    if (air != NULL)
+    {
+        air->num_nodes = num_nodes;
+        air->loss = loss;
+        air->latency_us = latency_us;
+        air->random_state = (seed != 0) ? seed : 1;
+        Place(air, topology, range);
+    }
+
+    return air;
+}
+
+void Air__Destroy(AIR_T* air)
+{
+    free(air);
+}
+
+void Air__SetReceiver(AIR_T* air, uint8_t node, const AIR_RECEIVER_T* receiver)
+{
+    air->receivers[node] = *receiver;
+}
+
+/**
+ * @brief Hand over the frames arrived by now, forget the old ones
+ */
+void Air__Step(AIR_T* air, uint64_t now_us)
+{
+    AIR_FRAME_T* frame;
+    uint16_t i;
+    uint16_t kept = 0;
+
+    air->now_us = now_us;
+
+    for (i = 0; i < air->num_frames; i++)
+    {
+        frame = &air->frames[i];
+        if (!frame->done && frame->end_us <= now_us)
+        {
+            frame->done = 1;
+            Deliver(air, frame);
+        }
+    }
+
+    // Deliver() may have added ACK frames at the end
+    for (i = 0; i < air->num_frames; i++)
+    {
+        frame = &air->frames[i];
+        if (!frame->done || frame->end_us + FRAME_RETENTION_US > now_us)
+        {
+            air->frames[kept++] = *frame;
+        }
+    }
+    air->num_frames = kept;
+}
+
+uint64_t Air__GetTime(const AIR_T* air)
+{
+    return air->now_us;
+}
+
+/**
+ * @brief Send a frame, its arrival times are set here
+ *
+ * @param start_us  Start of the transmission, at most the current time
+ */
+void Air__Transmit(AIR_T* air, const AIR_FRAME_T* frame, uint64_t start_us, uint32_t duration_us)
+{
+    AIR_FRAME_T* entry;
+
+    if (air->num_frames == MAX_FRAMES)
+    {
+        return;
+    }
+
+    entry = &air->frames[air->num_frames++];
+    *entry = *frame;
+    entry->start_us = start_us + air->latency_us;
+    entry->end_us = entry->start_us + duration_us;
+    entry->done = 0;
+
+    if (frame->is_ack)
+    {
+        air->stats.ack_frames++;
+    }
+    else
+    {
+        air->stats.frames++;
+    }
+}
+
+/**
+ * @brief Whether a frame from a node in range is arriving on the channel,
+ *        as seen by the received power detector
+ */
+int Air__IsChannelBusy(const AIR_T* air, uint8_t node, uint8_t channel)
+{
+    const AIR_FRAME_T* frame;
+    uint16_t i;
+
+    for (i = 0; i < air->num_frames; i++)
+    {
+        frame = &air->frames[i];
+        if (frame->channel == channel && frame->sender != node && air->in_range[node][frame->sender] &&
+            frame->start_us <= air->now_us && air->now_us < frame->end_us)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int Air__IsInRange(const AIR_T* air, uint8_t a, uint8_t b)
+{
+    return air->in_range[a][b];
+}
+
+void Air__GetStats(const AIR_T* air, AIR_STATS_T* stats)
+{
+    *stats = air->stats;
+}
+
+static void Place(AIR_T* air, AIR_TOPOLOGY_T topology, double range)
+{
+    double x[AIR_MAX_NODES];
+    double y[AIR_MAX_NODES];
+    uint8_t width = (uint8_t)ceil(sqrt(air->num_nodes));
+    uint8_t a;
+    uint8_t b;
+
+    for (a = 0; a < air->num_nodes; a++)
+    {
+        x[a] = (topology == AIR_TOPOLOGY_GRID) ? a % width : a;
+        y[a] = (topology == AIR_TOPOLOGY_GRID) ? a / width : 0;
+    }
+
+    for (a = 0; a < air->num_nodes; a++)
+    {
+        for (b = 0; b < air->num_nodes; b++)
+        {
+            air->in_range[a][b] = (a != b && (topology == AIR_TOPOLOGY_FULL ||
+                                   hypot(x[a] - x[b], y[a] - y[b]) <= range + 1e-9)) ? 1 : 0;
+        }
+    }
+}
+
+/**
+ * @brief Whether another frame heard by the receiver overlapped this one
+ */
+static int IsCollided(const AIR_T* air, const AIR_FRAME_T* frame, uint8_t receiver)
+{
+    const AIR_FRAME_T* other;
+    uint16_t i;
+
+    for (i = 0; i < air->num_frames; i++)
+    {
+        other = &air->frames[i];
+        if (other != frame && other->channel == frame->channel && air->in_range[receiver][other->sender] &&
+            other->start_us < frame->end_us && frame->start_us < other->end_us)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void Deliver(AIR_T* air, const AIR_FRAME_T* frame)
+{
+    AIR_RECEIVER_T* receiver;
+    uint8_t node;
+
+    for (node = 0; node < air->num_nodes; node++)
+    {
+        receiver = &air->receivers[node];
+        if (!air->in_range[node][frame->sender] || receiver->is_listening == NULL ||
+            !receiver->is_listening(receiver->context, frame))
+        {
+            continue;
+        }
+
+        if (IsCollided(air, frame, node))
+        {
+            air->stats.collisions++;
+        }
+        else if (air->loss > 0 && GetRandom(air) < air->loss)
+        {
+            air->stats.losses++;
+        }
+        else
+        {
+            // May transmit an ACK, appended to the frames
+            air->stats.received++;
+            receiver->receive(receiver->context, frame);
+        }
+    }
+}
+
+/**
+ * @return Uniform in [0, 1), xorshift32
+ */
+static double GetRandom(AIR_T* air)
+{
+    uint32_t x = air->random_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    air->random_state = x;
+
+    return (x - 1) / 4294967296.0;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file air.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef AIR_H_
+#define AIR_H_
+
+#include <stdint.h>
+
+#define AIR_MAX_NODES 64
+#define AIR_ADDRESS_SIZE 5
+#define AIR_PAYLOAD_SIZE 32
+
+typedef enum {
+    AIR_TOPOLOGY_FULL = 0, // every node hears every other one
+    AIR_TOPOLOGY_LINE,     // node i at (i, 0)
+    AIR_TOPOLOGY_GRID,     // square grid, row by row
+} AIR_TOPOLOGY_T;
+
+typedef struct {
+    uint8_t sender;
+    uint8_t channel;
+    uint8_t is_ack;
+    uint8_t no_ack;    // data frame sent with W_TX_PAYLOAD_NOACK
+    uint8_t pid;
+    uint8_t address[AIR_ADDRESS_SIZE];
+    uint8_t length;
+    uint8_t payload[AIR_PAYLOAD_SIZE];
+    uint64_t start_us; // at the receivers, latency included
+    uint64_t end_us;
+    uint8_t done;
+} AIR_FRAME_T;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t ack_frames;
+    uint32_t received;
+    uint32_t collisions; // frame for a listening node, overlapped there
+    uint32_t losses;     // frame for a listening node, lost on purpose
+} AIR_STATS_T;
+
+typedef struct AIR_S AIR_T;
+
+// Receivers of the frames, called when a frame has fully arrived
+typedef struct {
+    void* context;
+    int (*is_listening)(void* context, const AIR_FRAME_T* frame);
+    void (*receive)(void* context, const AIR_FRAME_T* frame);
+} AIR_RECEIVER_T;
+
+AIR_T* Air__Create(uint8_t num_nodes, AIR_TOPOLOGY_T topology, double range, double loss,
+                   uint32_t latency_us, uint32_t seed);
+void Air__Destroy(AIR_T* air);
+void Air__SetReceiver(AIR_T* air, uint8_t node, const AIR_RECEIVER_T* receiver);
+void Air__Step(AIR_T* air, uint64_t now_us);
+uint64_t Air__GetTime(const AIR_T* air);
+void Air__Transmit(AIR_T* air, const AIR_FRAME_T* frame, uint64_t start_us, uint32_t duration_us);
+int Air__IsChannelBusy(const AIR_T* air, uint8_t node, uint8_t channel);
+int Air__IsInRange(const AIR_T* air, uint8_t a, uint8_t b);
+void Air__GetStats(const AIR_T* air, AIR_STATS_T* stats);
+
+#endif /* AIR_H_ */
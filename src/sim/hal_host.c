@@ -0,0 +1,253 @@
+/**
+ * @file hal_host.c
+ *
+ * @brief HAL and interrupts of a simulated node
+ *
+ * @details The SPI bus, CE and IRQ pins are wired to the emulated
+ *          nRF24L01+ of the node through SIM_HOST_T. A byte written to
+ *          SPDR is exchanged at once, SPIF is set right away.
+ *
+ *          The interrupt flags (Timer0 compare match, INT0 falling edge,
+ *          SPI transfer complete) are serviced whenever the interrupts
+ *          are enabled again, after an SPI write with SPIE set, and at
+ *          each run of the node: INT0 first, then Timer0, then SPI, as
+ *          their vector order on the ATmega328P. ISRs do not nest.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include "micro.h"
+#include "hal.h"
+#include "hal_host.h"
+
+#define TICK_US 1000
+#define TIMER_COUNT_US 4
+
+ISR(INT0_vect);
+ISR(TIMER0_COMPA_vect);
+ISR(SPI_STC_vect);
+
+static const SIM_HOST_T* Host;
+static uint64_t Now_Us;
+static uint64_t Next_Tick_Us;
+
+static BOOL_T Interrupts_Enabled;
+static BOOL_T In_Isr;
+static uint8_t Pending_Ticks;
+static BOOL_T Int0_Enabled;
+static BOOL_T Int0_Flag;
+static BOOL_T Irq_Active;
+
+static BOOL_T Spi_Interrupt_Enabled;
+static BOOL_T Spif;
+static uint8_t Spdr;
+
+static void UpdateInt0(void);
+
+/**
+ * @param now_us  Node clock at the reset, it ticks on its whole milliseconds
+ */
+void HalHost__Initialize(const SIM_HOST_T* host, uint64_t now_us)
+{
+    Host = host;
+    Now_Us = now_us;
+    Next_Tick_Us = (now_us / TICK_US + 1) * TICK_US;
+    Interrupts_Enabled = FALSE;
+    In_Isr = FALSE;
+    Pending_Ticks = 0;
+    Int0_Enabled = FALSE;
+    Int0_Flag = FALSE;
+    Irq_Active = FALSE;
+    Spi_Interrupt_Enabled = FALSE;
+    Spif = FALSE;
+    Spdr = 0;
+}
+
+/**
+ * @brief Move the node clock forward, the Timer0 ticks due are pending
+ */
+void HalHost__SetTime(uint64_t now_us)
+{
+    Now_Us = now_us;
+    while (Now_Us >= Next_Tick_Us)
+    {
+        Next_Tick_Us += TICK_US;
+        Pending_Ticks++;
+    }
+}
+
+uint64_t HalHost__GetTime(void)
+{
+    return Now_Us;
+}
+
+/**
+ * @brief Run the ISRs of the pending interrupts, if they are enabled
+ */
+void HalHost__ServiceInterrupts(void)
+{
+    if (In_Isr)
+    {
+        return;
+    }
+
+    In_Isr = TRUE;
+    while (1)
+    {
+        UpdateInt0();
+        if (!Interrupts_Enabled)
+        {
+            break;
+        }
+
+        // The I flag is cleared while an ISR runs
+        Interrupts_Enabled = FALSE;
+        if (Int0_Flag && Int0_Enabled)
+        {
+            Int0_Flag = FALSE;
+            INT0_vect();
+        }
+        else if (Pending_Ticks > 0)
+        {
+            Pending_Ticks--;
+            TIMER0_COMPA_vect();
+        }
+        else if (Spif && Spi_Interrupt_Enabled)
+        {
+            // SPIF is cleared by the SPDR read of the ISR
+            SPI_STC_vect();
+        }
+        else
+        {
+            Interrupts_Enabled = TRUE;
+            break;
+        }
+        Interrupts_Enabled = TRUE;
+    }
+    In_Isr = FALSE;
+}
+
+void Host__EnableInterrupts(void)
+{
+    Interrupts_Enabled = TRUE;
+    HalHost__ServiceInterrupts();
+}
+
+void Host__DisableInterrupts(void)
+{
+    Interrupts_Enabled = FALSE;
+}
+
+uint8_t Host__SaveInterrupts(void)
+{
+    uint8_t sreg = Interrupts_Enabled;
+
+    Interrupts_Enabled = FALSE;
+    return sreg;
+}
+
+void Host__RestoreInterrupts(const uint8_t* sreg)
+{
+    if (*sreg)
+    {
+        Host__EnableInterrupts();
+    }
+}
+
+uint8_t Host__GetTimerCount(void)
+{
+    return (uint8_t)((TICK_US - (Next_Tick_Us - Now_Us)) / TIMER_COUNT_US);
+}
+
+void Hal__InitializeSpi(void)
+{
+    Spi_Interrupt_Enabled = TRUE;
+}
+
+void Hal__SetSpiClock(uint8_t spr, uint8_t spi2x)
+{
+}
+
+void Hal__SelectSpi(uint8_t csn_mask)
+{
+    if (csn_mask & HAL_CSN_RADIO)
+    {
+        Host->set_csn(Host->context, FALSE);
+    }
+}
+
+void Hal__DeselectSpi(uint8_t csn_mask)
+{
+    if (csn_mask & HAL_CSN_RADIO)
+    {
+        Host->set_csn(Host->context, TRUE);
+    }
+}
+
+void Hal__WriteSpi(uint8_t data)
+{
+    Spdr = Host->exchange_spi(Host->context, data);
+    Spif = TRUE;
+    if (Spi_Interrupt_Enabled)
+    {
+        HalHost__ServiceInterrupts();
+    }
+}
+
+uint8_t Hal__ReadSpi(void)
+{
+    Spif = FALSE;
+    return Spdr;
+}
+
+BOOL_T Hal__IsSpiDone(void)
+{
+    return Spif;
+}
+
+void Hal__EnableSpiInterrupt(void)
+{
+    Spi_Interrupt_Enabled = TRUE;
+    HalHost__ServiceInterrupts();
+}
+
+void Hal__DisableSpiInterrupt(void)
+{
+    Spi_Interrupt_Enabled = FALSE;
+}
+
+void Hal__InitializeRadioPins(void)
+{
+    Int0_Enabled = TRUE;
+    Irq_Active = Host->is_irq_active(Host->context);
+}
+
+void Hal__DriveRadioCeLow(void)
+{
+    Host->set_ce(Host->context, FALSE);
+}
+
+void Hal__DriveRadioCeHigh(void)
+{
+    Host->set_ce(Host->context, TRUE);
+}
+
+BOOL_T Hal__IsRadioIrqActive(void)
+{
+    return Host->is_irq_active(Host->context);
+}
+
+/**
+ * @brief Latch the falling edges of the IRQ line
+ */
+static void UpdateInt0(void)
+{
+    BOOL_T active = Host->is_irq_active(Host->context);
+
+    if (active && !Irq_Active)
+    {
+        Int0_Flag = TRUE;
+    }
+    Irq_Active = active;
+}
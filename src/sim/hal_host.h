@@ -0,0 +1,19 @@
+/**
+ * @file hal_host.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef HAL_HOST_H_
+#define HAL_HOST_H_
+
+#include "micro.h"
+#include "sim_node.h"
+
+void HalHost__Initialize(const SIM_HOST_T* host, uint64_t now_us);
+void HalHost__SetTime(uint64_t now_us);
+uint64_t HalHost__GetTime(void);
+void HalHost__ServiceInterrupts(void);
+
+#endif /* HAL_HOST_H_ */
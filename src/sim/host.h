@@ -0,0 +1,64 @@
+/**
+ * @file host.h
+ *
+ * @brief Stand-ins of the avr-libc definitions for the simulator build
+ *
+ * @details Included by micro.h when HOST_BUILD is defined. The ISRs
+ *          become plain functions, called by hal_host.c when their
+ *          interrupt is pending and the interrupts are enabled, in the
+ *          ATmega328P priority order. An ISR takes no simulated time.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define ISR(vector) void vector(void)
+
+#define sei() Host__EnableInterrupts()
+#define cli() Host__DisableInterrupts()
+
+// ATOMIC_BLOCK(ATOMIC_RESTORESTATE) only, as used by the firmware: the
+// interrupt state is restored however the block is left
+#define ATOMIC_RESTORESTATE \
+    uint8_t host_sreg __attribute__((__cleanup__(Host__RestoreInterrupts))) = Host__SaveInterrupts()
+#define ATOMIC_BLOCK(type) for (type, host_once = 1; host_once != 0; host_once = 0)
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+
+#define _delay_loop_2(count) ((void)(count))
+
+// Timer0 count, 4 us per count within the 1 ms tick
+#define TCNT0 Host__GetTimerCount()
+
+// The simulated time stands still while the firmware code runs, the
+// profiler reads the host clock instead, in nanoseconds
+#define PROFILER_TIMESTAMP() Host__GetNanos()
+
+// One firmware image serves all the simulated nodes
+extern uint8_t Host_Node_Id;
+#define RADIO_NODE_ID Host_Node_Id
+
+void Host__EnableInterrupts(void);
+void Host__DisableInterrupts(void);
+uint8_t Host__SaveInterrupts(void);
+void Host__RestoreInterrupts(const uint8_t* sreg);
+uint8_t Host__GetTimerCount(void);
+
+static inline uint32_t Host__GetNanos(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec);
+}
+
+#endif /* HOST_H_ */
@@ -0,0 +1,213 @@
+/**
+ * @file node.c
+ *
+ * @brief Firmware of a simulated node, built as a shared library
+ *
+ * @details The real SPI, packet pool, radio, mesh, TDMA, scheduler, soft
+ *          timer and event modules run on the HAL of hal_host.c. The
+ *          modules of the other peripherals (sensors, relays, USART, UI)
+ *          are left out, their tasks and event handlers are empty here.
+ *          Built with PROFILER_ENABLED and profiler.c, the node profiles
+ *          its tasks and ISRs on the host clock, and its table is
+ *          dumped to the simulator instead of the serial protocol.
+ *          The node starts as main() does and runs one pass of the main
+ *          loop per simulation step; the code itself takes no simulated
+ *          time.
+ *
+ *          The simulator loads one copy of the library per node, so that
+ *          every node has its own static variables (see sim.c).
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <string.h>
+#include "micro.h"
+#include "timer.h"
+#include "spi.h"
+#include "packet_pool.h"
+#include "radio.h"
+#include "mesh.h"
+#include "tdma.h"
+#include "scheduler.h"
+#include "soft_timer.h"
+#include "events.h"
+#include "profiler.h"
+#include "hal_host.h"
+#include "sim_node.h"
+
+uint8_t Host_Node_Id;
+volatile uint32_t Timer_Millis;
+
+static const SIM_HOST_T* Host;
+static uint64_t Boot_Us;
+static int16_t Clock_Ppm;
+
+static void Initialize(uint8_t node_id, uint64_t now_us, int16_t clock_ppm, const SIM_HOST_T* host);
+static void Run(uint64_t now_us);
+static BOOL_T Send(uint8_t destination, const uint8_t* payload, uint8_t length, MESH_PRIORITY_T priority);
+static void GetStats(SIM_NODE_STATS_T* stats);
+static void SetTdma(BOOL_T enabled);
+static void DumpProfile(void);
+static void MeshReceiveCallback(uint8_t source, const uint8_t* payload, uint8_t length);
+#ifdef PROFILER_ENABLED
+static BOOL_T ProfilerDumpCallback(uint8_t id, const PROFILER_STATS_T* stats);
+
+// Names of the profiled entries, the IDs depend on the build options
+static const char* const Profiler_Names[PROFILER_NUM_ENTRIES] = {
+    [SCHEDULER_TASK_SOFT_TIMER]  = "soft timer task",
+    [SCHEDULER_TASK_RELAYS]      = "relays task",
+    [SCHEDULER_TASK_TEMP_SENSOR] = "temp sensor task",
+    [SCHEDULER_TASK_RADIO]       = "radio task",
+    [SCHEDULER_TASK_TDMA]        = "TDMA task",
+    [SCHEDULER_TASK_MESH]        = "mesh task",
+    [SCHEDULER_TASK_THERMOSTAT]  = "thermostat task",
+    [SCHEDULER_TASK_TELEMETRY]   = "telemetry task",
+    [SCHEDULER_TASK_IDLE]        = "idle task",
+    [SCHEDULER_TASK_PROFILER]    = "profiler task",
+#ifdef TRACE_ENABLED
+    [SCHEDULER_TASK_TRACE]       = "trace task",
+#endif
+    [PROFILER_ID_ISR_TIMER0]     = "timer0 ISR",
+    [PROFILER_ID_ISR_TIMER1]     = "timer1 ISR",
+    [PROFILER_ID_ISR_INT0]       = "INT0 ISR",
+    [PROFILER_ID_ISR_USART_RX]   = "USART RX ISR",
+    [PROFILER_ID_ISR_SPI]        = "SPI ISR",
+};
+#endif
+
+static const SIM_NODE_T Sim_Node = {
+    .initialize = Initialize,
+    .run = Run,
+    .send = Send,
+    .get_stats = GetStats,
+    .set_tdma = SetTdma,
+    .dump_profile = DumpProfile,
+};
+
+const SIM_NODE_T* SimNode__Get(void)
+{
+    return &Sim_Node;
+}
+
+uint32_t Timer__GetMillis(void)
+{
+    return Timer_Millis;
+}
+
+uint32_t Timer__GetMicros(void)
+{
+    return (uint32_t)HalHost__GetTime();
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+    PROFILER_ENTER(PROFILER_ID_ISR_TIMER0);
+    Timer__IncrementMillis();
+    Scheduler__PostTick();
+    PROFILER_EXIT(PROFILER_ID_ISR_TIMER0);
+}
+
+// Modules not simulated
+void Relays__1msTask(void) {}
+void TempSensor__1msTask(void) {}
+void Thermostat__100msTask(void) {}
+void Telemetry__100msTask(void) {}
+void Idle__1000msTask(void) {}
+void Thermostat__OnTemperatureReady(const EVENT_T* event) {}
+void Telemetry__OnTemperatureReady(const EVENT_T* event) {}
+void Telemetry__OnRelayDone(const EVENT_T* event) {}
+void Telemetry__OnSensorFault(const EVENT_T* event) {}
+void Ui__OnRadioIrq(const EVENT_T* event) {}
+void Protocol__OnFrame(const EVENT_T* event) {}
+
+/**
+ * @param now_us  Simulation time of the power-up, the node clock starts
+ *                from it
+ */
+static void Initialize(uint8_t node_id, uint64_t now_us, int16_t clock_ppm, const SIM_HOST_T* host)
+{
+    Host = host;
+    Host_Node_Id = node_id;
+    Boot_Us = now_us;
+    Clock_Ppm = clock_ppm;
+    Timer_Millis = 0;
+    HalHost__Initialize(host, 0);
+
+    Scheduler__Initialize();
+    SoftTimer__Initialize();
+    Events__Initialize();
+    Spi__Initialize();
+    PacketPool__Initialize();
+    Radio__Initialize();
+    Mesh__Initialize();
+    Tdma__Initialize();
+#ifdef PROFILER_ENABLED
+    Profiler__Initialize(ProfilerDumpCallback);
+#endif
+    Mesh__Receive(MeshReceiveCallback);
+    Micro__EnableInterrupts();
+
+    Radio__TurnOn();
+}
+
+/**
+ * @param now_us  Simulation time, the node clock runs Clock_Ppm faster
+ */
+static void Run(uint64_t now_us)
+{
+    uint64_t elapsed_us = now_us - Boot_Us;
+
+    HalHost__SetTime(elapsed_us + (int64_t)elapsed_us * Clock_Ppm / 1000000);
+    HalHost__ServiceInterrupts();
+
+    Scheduler__Run();
+    Events__Dispatch();
+}
+
+static BOOL_T Send(uint8_t destination, const uint8_t* payload, uint8_t length, MESH_PRIORITY_T priority)
+{
+    return Mesh__Send(destination, payload, length, priority);
+}
+
+static void GetStats(SIM_NODE_STATS_T* stats)
+{
+    Radio__GetStats(&stats->radio);
+    Mesh__GetStats(&stats->mesh);
+    Tdma__GetStats(&stats->tdma);
+    PacketPool__GetStats(&stats->pool);
+    stats->events_lost = Events__GetLostCount();
+}
+
+static void SetTdma(BOOL_T enabled)
+{
+    uint8_t i;
+
+    for (i = 0; i < MAX_NODES_NUMBER; i++)
+    {
+        Tdma__SetSlot(i, enabled ? i : TDMA_NO_SLOT);
+    }
+}
+
+static void DumpProfile(void)
+{
+#ifdef PROFILER_ENABLED
+    // The dump task takes all the entries at once
+    Profiler__RequestDump();
+    Profiler__10msTask();
+#endif
+}
+
+static void MeshReceiveCallback(uint8_t source, const uint8_t* payload, uint8_t length)
+{
+    Host->on_delivered(Host->context, source, payload, length);
+}
+
+#ifdef PROFILER_ENABLED
+static BOOL_T ProfilerDumpCallback(uint8_t id, const PROFILER_STATS_T* stats)
+{
+    Host->on_profile(Host->context, Profiler_Names[id], stats);
+
+    return TRUE;
+}
+#endif
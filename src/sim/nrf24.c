@@ -0,0 +1,869 @@
+/**
+ * @file nrf24.c
+ *
+ * @brief Emulated nRF24L01+
+ *
+ * @details Register file, 3-level TX and RX FIFOs and the SPI commands
+ *          used by the driver, with the Enhanced ShockBurst behaviour on
+ *          the simulated air:
+ *          - TX: 130 us settling, the frame, then listening for the ACK
+ *            until ARD after its end; ARC retransmits of the same PID,
+ *            then MAX_RT with the payload left at the head of the FIFO.
+ *            With CE high the FIFO is sent back to back.
+ *          - RX: frames on the channel for an enabled pipe address are
+ *            put in the RX FIFO, unless the PID and CRC repeat the last
+ *            one (lost ACK), and acknowledged 130 us after their end with
+ *            the ACK payload of the pipe, if any. A full RX FIFO drops the
+ *            frame without ACK.
+ *          - RPD: set while listening when a frame from a node in range
+ *            is on the channel, cleared when entering RX.
+ *          Payloads always have a dynamic length; the static widths, the
+ *          address width, PLOS_CNT and REUSE_TX_PL are not emulated.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "radio.h"
+#include "nrf24.h"
+
+#define FIFO_DEPTH 3
+#define NUM_REGISTERS 0x20
+#define ADDRESS_SIZE AIR_ADDRESS_SIZE
+
+#define SETTLING_US 130
+#define POWER_UP_US 1500
+#define ARD_STEP_US 250
+
+#define STATUS_FLAGS_MASK ((1 << BIT_RX_DR) | (1 << BIT_TX_DS) | (1 << BIT_MAX_RT))
+#define RX_P_NO_EMPTY 0x07
+
+// Preamble and address, the 9 bits packet control field apart
+#define FRAME_HEADER_BYTES (1 + ADDRESS_SIZE)
+#define PCF_BITS 9
+
+typedef enum {
+    STATE_POWER_DOWN = 0,
+    STATE_START_UP,
+    STATE_STANDBY,
+    STATE_RX_SETTLING,
+    STATE_RX,
+    STATE_TX_SETTLING,
+    STATE_TX,
+    STATE_WAIT_ACK,
+    STATE_ACK_SETTLING, // RX, acknowledging a frame
+    STATE_ACK_TX,
+} STATE_T;
+
+typedef struct {
+    uint8_t length;
+    uint8_t pipe;           // RX: pipe received on, TX: pipe of an ACK payload
+    uint8_t is_ack_payload;
+    uint8_t no_ack;
+    uint64_t written_us;
+    uint8_t data[AIR_PAYLOAD_SIZE];
+} PAYLOAD_T;
+
+typedef struct {
+    PAYLOAD_T entries[FIFO_DEPTH];
+    uint8_t count;
+} FIFO_T;
+
+struct NRF24_S {
+    uint8_t node;
+    AIR_T* air;
+    uint8_t registers[NUM_REGISTERS];
+    uint8_t rx_address_p0[ADDRESS_SIZE];
+    uint8_t rx_address_p1[ADDRESS_SIZE];
+    uint8_t tx_address[ADDRESS_SIZE];
+    FIFO_T tx_fifo;
+    FIFO_T rx_fifo;
+    STATE_T state;
+    uint64_t until_us;
+    int ce;
+
+    int selected;
+    uint8_t command;
+    uint8_t index;
+    uint8_t buffer[AIR_PAYLOAD_SIZE];
+
+    uint8_t pid;
+    uint8_t arc_cnt;
+    uint8_t tx_channel;
+    uint64_t listen_since_us;
+    uint8_t rx_channel;
+    int rpd;
+    int last_valid;
+    uint8_t last_pid;
+    uint16_t last_crc;
+    uint8_t ack_pipe;
+    uint8_t ack_address[ADDRESS_SIZE];
+    int ack_with_payload;
+
+    NRF24_ACK_CALLBACK_T ack_callback;
+    void* ack_context;
+    NRF24_STATS_T stats;
+};
+
+static void Reset(NRF24_T* nrf);
+static uint8_t GetStatus(const NRF24_T* nrf);
+static uint8_t ReadRegister(const NRF24_T* nrf, uint8_t reg, uint8_t index);
+static void WriteRegister(NRF24_T* nrf, uint8_t reg, uint8_t index, uint8_t value);
+static void ExecuteCommand(NRF24_T* nrf);
+static void UpdateMode(NRF24_T* nrf, uint64_t time_us);
+static uint32_t GetAirtime(const NRF24_T* nrf, uint8_t length);
+static void SendHead(NRF24_T* nrf, uint64_t time_us);
+static void EndFrame(NRF24_T* nrf, uint64_t time_us);
+static void Retransmit(NRF24_T* nrf, uint64_t time_us);
+static void SendAck(NRF24_T* nrf, uint64_t time_us);
+static void EndAck(NRF24_T* nrf, uint64_t time_us);
+static int MatchPipe(const NRF24_T* nrf, const uint8_t* address);
+static uint16_t GetCrc(const uint8_t* data, uint8_t length);
+static void Push(FIFO_T* fifo, const PAYLOAD_T* payload);
+static void Pop(FIFO_T* fifo, uint8_t index);
+static int IsListening(void* context, const AIR_FRAME_T* frame);
+static void Receive(void* context, const AIR_FRAME_T* frame);
+static void ReceiveAck(NRF24_T* nrf, const AIR_FRAME_T* frame);
+static void ReceiveData(NRF24_T* nrf, const AIR_FRAME_T* frame);
+
+NRF24_T* Nrf24__Create(uint8_t node, AIR_T* air)
+{
+    NRF24_T* nrf = calloc(1, sizeof(NRF24_T));
+    AIR_RECEIVER_T receiver = {
+        .is_listening = IsListening,
+        .receive = Receive,
+    };
+
+    if (nrf != NULL)
+    {
+        nrf->node = node;
+        nrf->air = air;
+        Reset(nrf);
+        receiver.context = nrf;
+        Air__SetReceiver(air, node, &receiver);
+    }
+
+    return nrf;
+}
+
+void Nrf24__Destroy(NRF24_T* nrf)
+{
+    free(nrf);
+}
+
+void Nrf24__SetAckCallback(NRF24_T* nrf, NRF24_ACK_CALLBACK_T callback, void* context)
+{
+    nrf->ack_callback = callback;
+    nrf->ack_context = context;
+}
+
+/**
+ * @brief Go through the state changes due by now, each one from the
+ *        exact time it was due
+ */
+void Nrf24__Step(NRF24_T* nrf, uint64_t now_us)
+{
+    while (nrf->until_us <= now_us)
+    {
+        switch (nrf->state)
+        {
+            case STATE_START_UP:
+            {
+                nrf->state = STATE_STANDBY;
+                UpdateMode(nrf, nrf->until_us);
+                continue;
+            }
+            case STATE_RX_SETTLING:
+            {
+                nrf->state = STATE_RX;
+                nrf->listen_since_us = nrf->until_us;
+                nrf->rx_channel = nrf->registers[REG_RF_CH];
+                nrf->until_us = UINT64_MAX;
+                continue;
+            }
+            case STATE_TX_SETTLING:
+            {
+                nrf->pid = (nrf->pid + 1) & 0x03;
+                nrf->arc_cnt = 0;
+                SendHead(nrf, nrf->until_us);
+                continue;
+            }
+            case STATE_TX:
+            {
+                EndFrame(nrf, nrf->until_us);
+                continue;
+            }
+            case STATE_WAIT_ACK:
+            {
+                Retransmit(nrf, nrf->until_us);
+                continue;
+            }
+            case STATE_ACK_SETTLING:
+            {
+                SendAck(nrf, nrf->until_us);
+                continue;
+            }
+            case STATE_ACK_TX:
+            {
+                EndAck(nrf, nrf->until_us);
+                continue;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        break;
+    }
+
+    if (nrf->state == STATE_RX && Air__IsChannelBusy(nrf->air, nrf->node, nrf->rx_channel))
+    {
+        nrf->rpd = 1;
+    }
+}
+
+/**
+ * @brief Shift a byte in on MOSI, return the one shifted out on MISO
+ */
+uint8_t Nrf24__ExchangeSpi(NRF24_T* nrf, uint8_t mosi)
+{
+    const PAYLOAD_T* top = &nrf->rx_fifo.entries[0];
+    uint8_t miso = 0x00;
+    uint8_t i;
+
+    if (!nrf->selected)
+    {
+        return 0xFF;
+    }
+
+    if (nrf->index == 0)
+    {
+        nrf->command = mosi;
+        miso = GetStatus(nrf);
+    }
+    else
+    {
+        i = nrf->index - 1;
+        if (nrf->command <= (CMD_R_REGISTER | CMD_REGISTER_MASK))
+        {
+            miso = ReadRegister(nrf, nrf->command & CMD_REGISTER_MASK, i);
+        }
+        else if (nrf->command <= (CMD_W_REGISTER | CMD_REGISTER_MASK))
+        {
+            WriteRegister(nrf, nrf->command & CMD_REGISTER_MASK, i, mosi);
+        }
+        else if (nrf->command == CMD_R_RX_PL_WID)
+        {
+            miso = (nrf->rx_fifo.count > 0) ? top->length : 0;
+        }
+        else if (nrf->command == CMD_R_RX_PAYLOAD)
+        {
+            miso = (nrf->rx_fifo.count > 0 && i < top->length) ? top->data[i] : 0;
+        }
+        else if (i < AIR_PAYLOAD_SIZE)
+        {
+            nrf->buffer[i] = mosi;
+        }
+    }
+
+    if (nrf->index < UINT8_MAX)
+    {
+        nrf->index++;
+    }
+
+    return miso;
+}
+
+/**
+ * @brief CSN rising edge ends the command, falling edge starts one
+ */
+void Nrf24__SetCsn(NRF24_T* nrf, int high)
+{
+    if (high && nrf->selected)
+    {
+        nrf->selected = 0;
+        if (nrf->index > 0)
+        {
+            ExecuteCommand(nrf);
+        }
+    }
+    else if (!high && !nrf->selected)
+    {
+        nrf->selected = 1;
+        nrf->index = 0;
+    }
+}
+
+void Nrf24__SetCe(NRF24_T* nrf, int high)
+{
+    nrf->ce = high;
+    UpdateMode(nrf, Air__GetTime(nrf->air));
+}
+
+/**
+ * @brief The IRQ pin is active low, on the unmasked STATUS flags
+ */
+int Nrf24__IsIrqActive(const NRF24_T* nrf)
+{
+    return (nrf->registers[REG_STATUS] & STATUS_FLAGS_MASK & ~nrf->registers[REG_CONFIG]) ? 1 : 0;
+}
+
+void Nrf24__GetStats(const NRF24_T* nrf, NRF24_STATS_T* stats)
+{
+    *stats = nrf->stats;
+}
+
+/**
+ * @brief Power-on reset values
+ */
+static void Reset(NRF24_T* nrf)
+{
+    uint8_t pipe;
+
+    memset(nrf->registers, 0, sizeof(nrf->registers));
+    nrf->registers[REG_CONFIG] = (1 << BIT_EN_CRC);
+    nrf->registers[REG_EN_AA] = 0x3F;
+    nrf->registers[REG_EN_RXADDR] = 0x03;
+    nrf->registers[REG_SETUP_AW] = 0x03;
+    nrf->registers[REG_SETUP_RETR] = 0x03;
+    nrf->registers[REG_RF_CH] = 0x02;
+    nrf->registers[REG_RF_SETUP] = 0x0E;
+    for (pipe = 2; pipe < RADIO_NUM_PIPES; pipe++)
+    {
+        nrf->registers[REG_RX_ADDR_P0 + pipe] = 0xC1 + pipe;
+    }
+    memset(nrf->rx_address_p0, 0xE7, ADDRESS_SIZE);
+    memset(nrf->rx_address_p1, 0xC2, ADDRESS_SIZE);
+    memset(nrf->tx_address, 0xE7, ADDRESS_SIZE);
+    nrf->state = STATE_POWER_DOWN;
+    nrf->until_us = UINT64_MAX;
+}
+
+static uint8_t GetStatus(const NRF24_T* nrf)
+{
+    uint8_t pipe = (nrf->rx_fifo.count > 0) ? nrf->rx_fifo.entries[0].pipe : RX_P_NO_EMPTY;
+
+    return (nrf->registers[REG_STATUS] & STATUS_FLAGS_MASK) | (pipe << BIT_RX_P_NO) |
+           ((nrf->tx_fifo.count == FIFO_DEPTH) ? (1 << BIT_TX_FULL) : 0);
+}
+
+static uint8_t ReadRegister(const NRF24_T* nrf, uint8_t reg, uint8_t index)
+{
+    uint8_t value = 0;
+
+    if (index >= ADDRESS_SIZE)
+    {
+        return 0;
+    }
+
+    switch (reg)
+    {
+        case REG_RX_ADDR_P0: value = nrf->rx_address_p0[index]; break;
+        case REG_RX_ADDR_P1: value = nrf->rx_address_p1[index]; break;
+        case REG_TX_ADDR:    value = nrf->tx_address[index]; break;
+        default:
+        {
+            if (index > 0)
+            {
+                break;
+            }
+            switch (reg)
+            {
+                case REG_STATUS:     value = GetStatus(nrf); break;
+                case REG_OBSERVE_TX: value = nrf->arc_cnt & 0x0F; break;
+                case RPD:            value = nrf->rpd ? 0x01 : 0x00; break;
+                case REG_FIFO_STATUS:
+                {
+                    value = ((nrf->tx_fifo.count == FIFO_DEPTH) ? (1 << BIT_FIFO_FULL) : 0) |
+                            ((nrf->tx_fifo.count == 0) ? (1 << BIT_TX_EMPTY) : 0) |
+                            ((nrf->rx_fifo.count == FIFO_DEPTH) ? (1 << BIT_RX_FULL) : 0) |
+                            ((nrf->rx_fifo.count == 0) ? (1 << BIT_RX_EMPTY) : 0);
+                    break;
+                }
+                default:             value = nrf->registers[reg]; break;
+            }
+            break;
+        }
+    }
+
+    return value;
+}
+
+static void WriteRegister(NRF24_T* nrf, uint8_t reg, uint8_t index, uint8_t value)
+{
+    uint64_t now_us = Air__GetTime(nrf->air);
+
+    if (index >= ADDRESS_SIZE)
+    {
+        return;
+    }
+
+    switch (reg)
+    {
+        case REG_RX_ADDR_P0: nrf->rx_address_p0[index] = value; return;
+        case REG_RX_ADDR_P1: nrf->rx_address_p1[index] = value; return;
+        case REG_TX_ADDR:    nrf->tx_address[index] = value; return;
+        default:             break;
+    }
+
+    if (index > 0)
+    {
+        return;
+    }
+
+    switch (reg)
+    {
+        case REG_STATUS:
+        {
+            // Flags are cleared writing 1
+            nrf->registers[REG_STATUS] &= ~(value & STATUS_FLAGS_MASK);
+            UpdateMode(nrf, now_us);
+            break;
+        }
+        case REG_OBSERVE_TX:
+        case RPD:
+        case REG_FIFO_STATUS:
+        {
+            break;
+        }
+        case REG_RF_CH:
+        {
+            nrf->registers[REG_RF_CH] = value & 0x7F;
+            // The PLL locks on the new channel
+            if (nrf->state == STATE_RX || nrf->state == STATE_RX_SETTLING)
+            {
+                nrf->state = STATE_RX_SETTLING;
+                nrf->until_us = now_us + SETTLING_US;
+                nrf->rpd = 0;
+            }
+            break;
+        }
+        case REG_CONFIG:
+        {
+            nrf->registers[REG_CONFIG] = value;
+            UpdateMode(nrf, now_us);
+            break;
+        }
+        default:
+        {
+            nrf->registers[reg] = value;
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Complete the command once CSN is high again
+ */
+static void ExecuteCommand(NRF24_T* nrf)
+{
+    PAYLOAD_T payload;
+    uint8_t length = nrf->index - 1;
+
+    if (length > AIR_PAYLOAD_SIZE)
+    {
+        length = AIR_PAYLOAD_SIZE;
+    }
+
+    memset(&payload, 0, sizeof(payload));
+    payload.length = length;
+    payload.written_us = Air__GetTime(nrf->air);
+    memcpy(payload.data, nrf->buffer, length);
+
+    if (nrf->command == CMD_R_RX_PAYLOAD && length > 0 && nrf->rx_fifo.count > 0)
+    {
+        Pop(&nrf->rx_fifo, 0);
+    }
+    else if ((nrf->command == CMD_W_TX_PAYLOAD || nrf->command == CMD_W_TX_PAYLOAD_NOACK) && length > 0)
+    {
+        payload.no_ack = (nrf->command == CMD_W_TX_PAYLOAD_NOACK) ? 1 : 0;
+        Push(&nrf->tx_fifo, &payload);
+    }
+    else if ((nrf->command & ~0x07) == CMD_W_ACK_PAYLOAD && (nrf->command & 0x07) < RADIO_NUM_PIPES &&
+             length > 0)
+    {
+        payload.is_ack_payload = 1;
+        payload.pipe = nrf->command & 0x07;
+        Push(&nrf->tx_fifo, &payload);
+    }
+    else if (nrf->command == CMD_FLUSH_TX)
+    {
+        nrf->tx_fifo.count = 0;
+    }
+    else if (nrf->command == CMD_FLUSH_RX)
+    {
+        nrf->rx_fifo.count = 0;
+    }
+
+    UpdateMode(nrf, Air__GetTime(nrf->air));
+}
+
+/**
+ * @brief Follow PWR_UP, PRIM_RX and CE from standby and RX. A frame being
+ *        sent or acknowledged is completed first.
+ */
+static void UpdateMode(NRF24_T* nrf, uint64_t time_us)
+{
+    uint8_t config = nrf->registers[REG_CONFIG];
+    int prim_rx = (config & (1 << BIT_PRIM_RX)) ? 1 : 0;
+
+    if (!(config & (1 << BIT_PWR_UP)))
+    {
+        nrf->state = STATE_POWER_DOWN;
+        nrf->until_us = UINT64_MAX;
+        return;
+    }
+
+    switch (nrf->state)
+    {
+        case STATE_POWER_DOWN:
+        {
+            nrf->state = STATE_START_UP;
+            nrf->until_us = time_us + POWER_UP_US;
+            break;
+        }
+        case STATE_RX_SETTLING:
+        case STATE_RX:
+        {
+            if (!nrf->ce || !prim_rx)
+            {
+                nrf->state = STATE_STANDBY;
+                nrf->until_us = UINT64_MAX;
+                UpdateMode(nrf, time_us);
+            }
+            break;
+        }
+        case STATE_STANDBY:
+        {
+            if (nrf->ce && prim_rx)
+            {
+                nrf->state = STATE_RX_SETTLING;
+                nrf->until_us = time_us + SETTLING_US;
+                nrf->rpd = 0;
+            }
+            else if (nrf->ce && !prim_rx && nrf->tx_fifo.count > 0 &&
+                     !(nrf->registers[REG_STATUS] & (1 << BIT_MAX_RT)))
+            {
+                nrf->state = STATE_TX_SETTLING;
+                nrf->until_us = time_us + SETTLING_US;
+            }
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @return Microseconds on the air of a frame with the given payload length
+ */
+static uint32_t GetAirtime(const NRF24_T* nrf, uint8_t length)
+{
+    uint8_t config = nrf->registers[REG_CONFIG];
+    uint8_t rf_setup = nrf->registers[REG_RF_SETUP];
+    uint8_t crc_bytes = (config & (1 << BIT_EN_CRC)) ? ((config & (1 << BIT_CRCO)) ? 2 : 1) : 0;
+    uint32_t bits = 8UL * (FRAME_HEADER_BYTES + length + crc_bytes) + PCF_BITS;
+    uint32_t rate_kbps = 1000;
+
+    if (rf_setup & (1 << RF_DR_LOW))
+    {
+        rate_kbps = 250;
+    }
+    else if (rf_setup & (1 << RF_DR_HIGH))
+    {
+        rate_kbps = 2000;
+    }
+
+    return (bits * 1000 + rate_kbps - 1) / rate_kbps;
+}
+
+static void SendHead(NRF24_T* nrf, uint64_t time_us)
+{
+    const PAYLOAD_T* head = &nrf->tx_fifo.entries[0];
+    AIR_FRAME_T frame;
+    uint32_t airtime = GetAirtime(nrf, head->length);
+
+    if (nrf->tx_fifo.count == 0)
+    {
+        // Flushed while settling
+        nrf->state = STATE_STANDBY;
+        nrf->until_us = UINT64_MAX;
+        return;
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.sender = nrf->node;
+    frame.channel = nrf->registers[REG_RF_CH];
+    frame.no_ack = head->no_ack;
+    frame.pid = nrf->pid;
+    memcpy(frame.address, nrf->tx_address, ADDRESS_SIZE);
+    frame.length = head->length;
+    memcpy(frame.payload, head->data, head->length);
+    Air__Transmit(nrf->air, &frame, time_us, airtime);
+
+    nrf->stats.frames_sent++;
+    nrf->tx_channel = frame.channel;
+    nrf->state = STATE_TX;
+    nrf->until_us = time_us + airtime;
+}
+
+/**
+ * @brief End of a data frame: done if no ACK is expected, otherwise
+ *        listen for it until the retransmit delay
+ */
+static void EndFrame(NRF24_T* nrf, uint64_t time_us)
+{
+    uint8_t ard = nrf->registers[REG_SETUP_RETR] >> BIT_ARD;
+
+    if (nrf->tx_fifo.count > 0 && (nrf->tx_fifo.entries[0].no_ack || !(nrf->registers[REG_EN_AA] & (1 << 0))))
+    {
+        Pop(&nrf->tx_fifo, 0);
+        nrf->stats.payloads_sent++;
+        nrf->registers[REG_STATUS] |= (1 << BIT_TX_DS);
+        nrf->state = STATE_STANDBY;
+        nrf->until_us = UINT64_MAX;
+        UpdateMode(nrf, time_us);
+    }
+    else
+    {
+        nrf->listen_since_us = time_us + SETTLING_US;
+        nrf->state = STATE_WAIT_ACK;
+        nrf->until_us = time_us + (uint32_t)(ard + 1) * ARD_STEP_US;
+    }
+}
+
+/**
+ * @brief No ACK within ARD: send again, or give up after ARC retransmits
+ */
+static void Retransmit(NRF24_T* nrf, uint64_t time_us)
+{
+    uint8_t arc = nrf->registers[REG_SETUP_RETR] & 0x0F;
+
+    if (nrf->arc_cnt < arc && nrf->tx_fifo.count > 0)
+    {
+        nrf->arc_cnt++;
+        nrf->stats.retransmits++;
+        SendHead(nrf, time_us);
+    }
+    else
+    {
+        nrf->stats.max_rt++;
+        nrf->registers[REG_STATUS] |= (1 << BIT_MAX_RT);
+        nrf->state = STATE_STANDBY;
+        nrf->until_us = UINT64_MAX;
+        UpdateMode(nrf, time_us);
+    }
+}
+
+static void SendAck(NRF24_T* nrf, uint64_t time_us)
+{
+    AIR_FRAME_T frame;
+    uint8_t i;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.sender = nrf->node;
+    frame.channel = nrf->rx_channel;
+    frame.is_ack = 1;
+    memcpy(frame.address, nrf->ack_address, ADDRESS_SIZE);
+
+    nrf->ack_with_payload = 0;
+    for (i = 0; i < nrf->tx_fifo.count; i++)
+    {
+        if (nrf->tx_fifo.entries[i].is_ack_payload && nrf->tx_fifo.entries[i].pipe == nrf->ack_pipe)
+        {
+            frame.length = nrf->tx_fifo.entries[i].length;
+            memcpy(frame.payload, nrf->tx_fifo.entries[i].data, frame.length);
+            Pop(&nrf->tx_fifo, i);
+            nrf->ack_with_payload = 1;
+            break;
+        }
+    }
+
+    Air__Transmit(nrf->air, &frame, time_us, GetAirtime(nrf, frame.length));
+    nrf->stats.acks_sent++;
+    nrf->state = STATE_ACK_TX;
+    nrf->until_us = time_us + GetAirtime(nrf, frame.length);
+}
+
+/**
+ * @brief Back to RX after an ACK, TX_DS if it carried a payload
+ */
+static void EndAck(NRF24_T* nrf, uint64_t time_us)
+{
+    if (nrf->ack_with_payload)
+    {
+        nrf->stats.ack_payloads_sent++;
+        nrf->registers[REG_STATUS] |= (1 << BIT_TX_DS);
+    }
+    nrf->state = STATE_STANDBY;
+    nrf->until_us = UINT64_MAX;
+    UpdateMode(nrf, time_us);
+}
+
+/**
+ * @return The enabled pipe receiving on the address, -1 if none
+ */
+static int MatchPipe(const NRF24_T* nrf, const uint8_t* address)
+{
+    uint8_t pipe;
+
+    for (pipe = 0; pipe < RADIO_NUM_PIPES; pipe++)
+    {
+        if (!(nrf->registers[REG_EN_RXADDR] & (1 << pipe)))
+        {
+            continue;
+        }
+        if (pipe == 0)
+        {
+            if (memcmp(address, nrf->rx_address_p0, ADDRESS_SIZE) == 0)
+            {
+                return pipe;
+            }
+        }
+        else if (memcmp(&address[1], &nrf->rx_address_p1[1], ADDRESS_SIZE - 1) == 0 &&
+                 address[0] == ((pipe == 1) ? nrf->rx_address_p1[0] : nrf->registers[REG_RX_ADDR_P0 + pipe]))
+        {
+            return pipe;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Stands for the frame CRC in the duplicate detection
+ */
+static uint16_t GetCrc(const uint8_t* data, uint8_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        crc = (uint16_t)((crc << 5) + (crc >> 11)) ^ data[i];
+    }
+
+    return crc;
+}
+
+static void Push(FIFO_T* fifo, const PAYLOAD_T* payload)
+{
+    if (fifo->count < FIFO_DEPTH)
+    {
+        fifo->entries[fifo->count++] = *payload;
+    }
+}
+
+static void Pop(FIFO_T* fifo, uint8_t index)
+{
+    fifo->count--;
+    memmove(&fifo->entries[index], &fifo->entries[index + 1], (fifo->count - index) * sizeof(PAYLOAD_T));
+}
+
+static int IsListening(void* context, const AIR_FRAME_T* frame)
+{
+    NRF24_T* nrf = context;
+
+    if (nrf->state == STATE_WAIT_ACK)
+    {
+        return (frame->is_ack && frame->channel == nrf->tx_channel && frame->start_us >= nrf->listen_since_us &&
+                frame->end_us <= nrf->until_us && memcmp(frame->address, nrf->tx_address, ADDRESS_SIZE) == 0);
+    }
+
+    return (nrf->state == STATE_RX && !frame->is_ack && frame->channel == nrf->rx_channel &&
+            frame->start_us >= nrf->listen_since_us && MatchPipe(nrf, frame->address) >= 0);
+}
+
+static void Receive(void* context, const AIR_FRAME_T* frame)
+{
+    NRF24_T* nrf = context;
+
+    if (frame->is_ack)
+    {
+        ReceiveAck(nrf, frame);
+    }
+    else
+    {
+        ReceiveData(nrf, frame);
+    }
+}
+
+/**
+ * @brief The head payload is acknowledged, the ACK payload goes to pipe 0
+ */
+static void ReceiveAck(NRF24_T* nrf, const AIR_FRAME_T* frame)
+{
+    PAYLOAD_T payload;
+
+    if (nrf->ack_callback != NULL)
+    {
+        nrf->ack_callback(nrf->ack_context, (uint32_t)(frame->end_us - nrf->tx_fifo.entries[0].written_us),
+                          nrf->arc_cnt);
+    }
+    Pop(&nrf->tx_fifo, 0);
+    nrf->stats.payloads_sent++;
+    nrf->registers[REG_STATUS] |= (1 << BIT_TX_DS);
+
+    if (frame->length > 0 && nrf->rx_fifo.count < FIFO_DEPTH)
+    {
+        memset(&payload, 0, sizeof(payload));
+        payload.length = frame->length;
+        payload.pipe = 0;
+        memcpy(payload.data, frame->payload, frame->length);
+        Push(&nrf->rx_fifo, &payload);
+        nrf->stats.received++;
+        nrf->registers[REG_STATUS] |= (1 << BIT_RX_DR);
+    }
+
+    nrf->state = STATE_STANDBY;
+    nrf->until_us = UINT64_MAX;
+    UpdateMode(nrf, frame->end_us);
+}
+
+static void ReceiveData(NRF24_T* nrf, const AIR_FRAME_T* frame)
+{
+    PAYLOAD_T payload;
+    int pipe = MatchPipe(nrf, frame->address);
+    uint16_t crc = GetCrc(frame->payload, frame->length);
+    int acknowledged = (!frame->no_ack && (nrf->registers[REG_EN_AA] & (1 << pipe))) ? 1 : 0;
+
+    nrf->rpd = 1;
+    if (nrf->rx_fifo.count == FIFO_DEPTH)
+    {
+        nrf->stats.rx_overflows++;
+        return;
+    }
+
+    if (acknowledged && nrf->last_valid && frame->pid == nrf->last_pid && crc == nrf->last_crc)
+    {
+        nrf->stats.duplicates++;
+    }
+    else
+    {
+        memset(&payload, 0, sizeof(payload));
+        payload.length = frame->length;
+        payload.pipe = (uint8_t)pipe;
+        memcpy(payload.data, frame->payload, frame->length);
+        Push(&nrf->rx_fifo, &payload);
+        nrf->stats.received++;
+        nrf->registers[REG_STATUS] |= (1 << BIT_RX_DR);
+        if (acknowledged)
+        {
+            nrf->last_valid = 1;
+            nrf->last_pid = frame->pid;
+            nrf->last_crc = crc;
+        }
+    }
+
+    if (acknowledged)
+    {
+        nrf->ack_pipe = (uint8_t)pipe;
+        memcpy(nrf->ack_address, frame->address, ADDRESS_SIZE);
+        nrf->state = STATE_ACK_SETTLING;
+        nrf->until_us = frame->end_us + SETTLING_US;
+    }
+}
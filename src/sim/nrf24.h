@@ -0,0 +1,42 @@
+/**
+ * @file nrf24.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef NRF24_H_
+#define NRF24_H_
+
+#include <stdint.h>
+#include "air.h"
+
+typedef struct {
+    uint32_t frames_sent;       // data frames, retransmits included
+    uint32_t payloads_sent;     // acknowledged, or sent without ACK
+    uint32_t retransmits;
+    uint32_t max_rt;            // payloads given up
+    uint32_t acks_sent;
+    uint32_t ack_payloads_sent;
+    uint32_t received;          // payloads put in the RX FIFO
+    uint32_t duplicates;        // same PID and CRC again, ACKed and dropped
+    uint32_t rx_overflows;      // RX FIFO full, dropped without ACK
+} NRF24_STATS_T;
+
+typedef struct NRF24_S NRF24_T;
+
+// Called for every acknowledged payload, from its write in the TX FIFO
+// to the end of its ACK
+typedef void (*NRF24_ACK_CALLBACK_T)(void* context, uint32_t latency_us, uint8_t retransmits);
+
+NRF24_T* Nrf24__Create(uint8_t node, AIR_T* air);
+void Nrf24__Destroy(NRF24_T* nrf);
+void Nrf24__SetAckCallback(NRF24_T* nrf, NRF24_ACK_CALLBACK_T callback, void* context);
+void Nrf24__Step(NRF24_T* nrf, uint64_t now_us);
+uint8_t Nrf24__ExchangeSpi(NRF24_T* nrf, uint8_t mosi);
+void Nrf24__SetCsn(NRF24_T* nrf, int high);
+void Nrf24__SetCe(NRF24_T* nrf, int high);
+int Nrf24__IsIrqActive(const NRF24_T* nrf);
+void Nrf24__GetStats(const NRF24_T* nrf, NRF24_STATS_T* stats);
+
+#endif /* NRF24_H_ */
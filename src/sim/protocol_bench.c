@@ -0,0 +1,248 @@
+/**
+ * @file protocol_bench.c
+ *
+ * @brief Loopback benchmark of the serial protocol encoder and parser
+ *
+ * @details The real protocol.c runs on the host. A loopback stand-in of
+ *          the USART stores the frames encoded by Protocol__Send() on a
+ *          wire buffer, which is then fed to Protocol__ParseByte() one
+ *          byte at a time, as the RX ISR does. The payloads have random
+ *          lengths and contents, zeros included, so that the COBS blocks
+ *          vary.
+ *
+ *          The stand-in of the event queue checks the length of each
+ *          decoded frame and refuses the event, so the parser frees its
+ *          buffer at once and no command runs: the parse cost covers the
+ *          COBS decoding, the CRC and the end of frame checks only.
+ *
+ *          The report gives the frames/s and the cost per byte of the
+ *          encoder and of the parser on the host, and the frames/s the
+ *          USART carries at USART_BAUDRATE for the same frames.
+ *
+ *          Build, from the repository root, with gcc on Linux:
+ *
+ *          gcc -std=gnu99 -O2 -DHOST_BUILD -Isrc -Isrc/drivers -Isrc/sim
+ *              src/sim/protocol_bench.c src/protocol.c src/parameters.c
+ *              -o protocol_bench
+ *
+ *          e.g. ./protocol_bench --frames 100000
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "micro.h"
+#include "usart.h"
+#include "temp_sensor.h"
+#include "relays.h"
+#include "radio.h"
+#include "radio_link.h"
+#include "radio_channel.h"
+#include "mesh.h"
+#include "tdma.h"
+#include "telemetry.h"
+#include "packet_pool.h"
+#include "protocol.h"
+
+#define DEFAULT_FRAMES 10000
+#define BENCH_MSG_ID MSG_MESH_FRAME
+
+// COBS adds one byte every 254, plus the first code byte and the delimiter
+#define MAX_ENCODED_FRAME (PROTOCOL_MAX_FRAME + (PROTOCOL_MAX_FRAME / 254) + 2)
+
+// 8 data bits, start and stop bits
+#define USART_BITS_PER_BYTE 10
+
+uint8_t Host_Node_Id;
+
+static uint8_t* Wire;
+static size_t Wire_Length;
+static size_t Wire_Size;
+
+static uint8_t* Payloads;
+static uint8_t* Lengths;
+static uint32_t Num_Frames;
+static uint32_t Decoded;
+static uint32_t Mismatches;
+
+static double GetSeconds(void);
+
+/*
+ * Stand-ins of the drivers and modules protocol.c talks to
+ */
+
+void Host__EnableInterrupts(void) {}
+void Host__DisableInterrupts(void) {}
+uint8_t Host__SaveInterrupts(void) { return 0; }
+void Host__RestoreInterrupts(const uint8_t* sreg) {}
+
+void Usart__SetRxCallback(USART_RX_CALLBACK_T callback) {}
+
+/**
+ * @brief Send the frame at once, as the UDRE ISR would over time
+ */
+BOOL_T Usart__WriteFrame(const uint8_t* data, uint8_t length, USART_TX_CALLBACK_T callback)
+{
+    if (Wire_Size - Wire_Length < length)
+    {
+        return FALSE;
+    }
+    memcpy(&Wire[Wire_Length], data, length);
+    Wire_Length += length;
+    if (callback != NULL)
+    {
+        callback();
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief Check the decoded frame against the one sent, then refuse it
+ *
+ * @param payload  Frame length without the CRC
+ */
+BOOL_T Events__PostFromIsr(EVENT_TYPE_T type, uint8_t arg, uint16_t payload)
+{
+    if (type != EVENT_SERIAL_FRAME || Decoded >= Num_Frames ||
+        payload != PROTOCOL_HEADER_SIZE + Lengths[Decoded])
+    {
+        Mismatches++;
+    }
+    Decoded++;
+
+    return FALSE;
+}
+
+int16_t TempSensor__GetTemperature(void) { return 0; }
+void Relays__Set(RELAY_T relay) {}
+void Relays__Reset(RELAY_T relay) {}
+BOOL_T Radio__Send(uint8_t node_id, const uint8_t* payload, uint8_t length, RADIO_TX_CALLBACK_T callback) { return FALSE; }
+BOOL_T Radio__OpenPipe(uint8_t pipe, uint8_t node_id) { return FALSE; }
+void Radio__ClosePipe(uint8_t pipe) {}
+PACKET_T* Radio__ReadPacket(uint8_t pipe) { return NULL; }
+BOOL_T Radio__SetAckPayload(uint8_t pipe, const uint8_t* payload, uint8_t length) { return FALSE; }
+void Radio__GetStats(RADIO_STATS_T* stats) { memset(stats, 0, sizeof(*stats)); }
+uint8_t RadioChannel__GetHop(void) { return 0; }
+uint8_t RadioChannel__GetBestHop(void) { return 0; }
+void RadioChannel__GetChannels(RADIO_CHANNEL_T* channels) {}
+BOOL_T RadioLink__GetLink(uint8_t node_id, RADIO_LINK_T* link) { return FALSE; }
+BOOL_T Mesh__Send(uint8_t destination, const uint8_t* payload, uint8_t length, MESH_PRIORITY_T priority) { return FALSE; }
+void Mesh__Receive(MESH_RX_CALLBACK_T callback) {}
+void Mesh__ReceiveRaw(RADIO_RX_CALLBACK_T callback) {}
+uint8_t Mesh__GetNextHop(uint8_t destination) { return MESH_NO_ROUTE; }
+BOOL_T Mesh__GetRoute(uint8_t destination, MESH_ROUTE_T* route) { return FALSE; }
+void Mesh__GetStats(MESH_STATS_T* stats) { memset(stats, 0, sizeof(*stats)); }
+BOOL_T Tdma__SetFrame(uint16_t frame_ms, uint8_t slot_ms) { return FALSE; }
+BOOL_T Tdma__SetSlot(uint8_t node_id, uint8_t slot) { return FALSE; }
+BOOL_T Tdma__SetHop(uint8_t hop) { return FALSE; }
+void Tdma__GetStats(TDMA_STATS_T* stats) { memset(stats, 0, sizeof(*stats)); }
+void Telemetry__SetReporting(uint16_t deadband, uint16_t heartbeat_s) {}
+void Telemetry__GetStats(TELEMETRY_STATS_T* stats) { memset(stats, 0, sizeof(*stats)); }
+BOOL_T Telemetry__OnMeshFrame(uint8_t source, const uint8_t* payload, uint8_t length) { return FALSE; }
+void PacketPool__Release(PACKET_T* packet) {}
+void PacketPool__GetStats(PACKET_POOL_STATS_T* stats) { memset(stats, 0, sizeof(*stats)); }
+
+int main(int argc, char** argv)
+{
+    static const struct option Long_Options[] = {
+        {"frames", required_argument, NULL, 'f'},
+        {"seed", required_argument, NULL, 's'},
+        {NULL, 0, NULL, 0},
+    };
+    PROTOCOL_STATS_T stats;
+    size_t payload_bytes = 0;
+    double encode_s;
+    double parse_s;
+    double start;
+    uint32_t seed = 1;
+    uint32_t i;
+    size_t j;
+    uint8_t k;
+    int option;
+
+    Num_Frames = DEFAULT_FRAMES;
+    while ((option = getopt_long(argc, argv, "", Long_Options, NULL)) != -1)
+    {
+        switch (option)
+        {
+            case 'f': Num_Frames = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [--frames N (default %u)] [--seed N (default 1)]\n",
+                        argv[0], DEFAULT_FRAMES);
+                return 1;
+        }
+    }
+
+    Wire_Size = (size_t)Num_Frames * MAX_ENCODED_FRAME + 1;
+    Wire = malloc(Wire_Size);
+    Payloads = malloc((size_t)Num_Frames * PROTOCOL_MAX_PAYLOAD + 1);
+    Lengths = malloc(Num_Frames + 1);
+    if (Num_Frames == 0 || Wire == NULL || Payloads == NULL || Lengths == NULL)
+    {
+        fprintf(stderr, "Cannot allocate %u frames\n", Num_Frames);
+        return 1;
+    }
+
+    // Payloads of about one zero byte in eight
+    srand(seed);
+    for (i = 0; i < Num_Frames; i++)
+    {
+        Lengths[i] = (uint8_t)(rand() % (PROTOCOL_MAX_PAYLOAD + 1));
+        for (k = 0; k < Lengths[i]; k++)
+        {
+            Payloads[(size_t)i * PROTOCOL_MAX_PAYLOAD + k] = (rand() % 8 == 0) ? 0 : (uint8_t)rand();
+        }
+        payload_bytes += Lengths[i];
+    }
+
+    Protocol__Initialize();
+
+    start = GetSeconds();
+    for (i = 0; i < Num_Frames; i++)
+    {
+        Protocol__Send(BENCH_MSG_ID, (uint8_t)i, &Payloads[(size_t)i * PROTOCOL_MAX_PAYLOAD], Lengths[i]);
+    }
+    encode_s = GetSeconds() - start;
+
+    start = GetSeconds();
+    for (j = 0; j < Wire_Length; j++)
+    {
+        Protocol__ParseByte(Wire[j]);
+    }
+    parse_s = GetSeconds() - start;
+
+    Protocol__GetStats(&stats);
+
+    printf("Frames\n");
+    printf("  sent / decoded         %u / %u\n", Num_Frames, Decoded);
+    printf("  errors / mismatches    %u / %u\n", stats.rx_errors, Mismatches);
+    printf("  payload / on the wire  %.1f / %.1f bytes per frame\n",
+           (double)payload_bytes / Num_Frames, (double)Wire_Length / Num_Frames);
+    printf("\nEncoder (Protocol__Send)\n");
+    printf("  frames/s               %.0f\n", Num_Frames / encode_s);
+    printf("  cost per wire byte     %.2f ns\n", encode_s * 1e9 / Wire_Length);
+    printf("\nParser (Protocol__ParseByte)\n");
+    printf("  frames/s               %.0f\n", Num_Frames / parse_s);
+    printf("  cost per wire byte     %.2f ns\n", parse_s * 1e9 / Wire_Length);
+    printf("\nUSART at %lu baud\n", (unsigned long)USART_BAUDRATE);
+    printf("  frames/s               %.1f\n",
+           USART_BAUDRATE / (USART_BITS_PER_BYTE * (double)Wire_Length / Num_Frames));
+
+    return (Decoded == Num_Frames && Mismatches == 0 && stats.rx_errors == 0) ? 0 : 1;
+}
+
+static double GetSeconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
@@ -0,0 +1,916 @@
+/**
+ * @file sim.c
+ *
+ * @brief Multi-node network simulator and benchmark
+ *
+ * @details Every node runs the firmware library (node.c) on its own
+ *          emulated nRF24L01+ (nrf24.c), all of them sharing the air
+ *          (air.c). Node 0 is the gateway; the other nodes send payloads
+ *          to it through the mesh at a fixed rate, after a warm-up long
+ *          enough for the first beacons to set the routes up.
+ *
+ *          The nodes are powered up at random times during the first
+ *          second, their clocks off by up to the given drift.
+ *
+ *          Time advances in fixed steps: the air hands over the frames
+ *          arrived, the radios go through their state changes, then each
+ *          node runs its pending ISRs and one pass of its main loop.
+ *
+ *          The report covers the measurement window (after the warm-up):
+ *          - driver: the radio.c counters (messages, frames, CCA)
+ *          - MAC: the ACKs and retransmits of the emulated radios, the
+ *            collisions and losses on the air, and the latency from the
+ *            write of a payload in the TX FIFO to the end of its ACK
+ *          - mesh: delivered packets/s and end-to-end latency at the
+ *            gateway, and the per-hop forwarding latency of mesh.c
+ *          - alarms: the share of the alarm payloads, sent on top of the
+ *            traffic with the alarm priority, delivered to the gateway,
+ *            those the mesh refused counted as failures, the copies
+ *            left by a retry after a lost ACK counted apart, and the
+ *            end-to-end latency of the delivered ones
+ *          - profiler: with a node library built with PROFILER_ENABLED,
+ *            the runs and the host time of each task and ISR, summed
+ *            over the nodes
+ *          The per-node resyncs, packet pool figures (high watermark
+ *          over size, failed allocations) and the profiler cover the
+ *          whole run.
+ *
+ *          The firmware code takes no simulated time, and the node count
+ *          is bounded by MAX_NODES_NUMBER, the mesh ignores the others.
+ *
+ *          Build, from the repository root, with gcc on Linux:
+ *
+ *          gcc -std=gnu99 -O2 -DHOST_BUILD -fPIC -shared -Wl,-Bsymbolic
+ *              -Isrc -Isrc/drivers -Isrc/sim src/sim/node.c
+ *              src/sim/hal_host.c src/drivers/spi.c src/drivers/radio.c
+ *              src/drivers/radio_link.c src/drivers/radio_channel.c
+ *              src/mesh.c src/tdma.c src/soft_timer.c src/events.c
+ *              src/scheduler.c src/packet_pool.c -o sim_node.so
+ *          gcc -std=gnu99 -O2 -DHOST_BUILD -Isrc -Isrc/drivers -Isrc/sim
+ *              src/sim/sim.c src/sim/nrf24.c src/sim/air.c -o radio_sim
+ *              -ldl -lm
+ *
+ *          e.g. ./radio_sim --nodes 16 --topology grid --range 1.5 --rate 2
+ *
+ *          Profiled nodes: build the library with -DPROFILER_ENABLED and
+ *          src/profiler.c added, e.g. as sim_profile.so, then
+ *          ./radio_sim --node-library ./sim_profile.so ...
+ *
+ *          Multi-hop TDMA delivery, the sync relayed down the line (about
+ *          one frame of latency per hop):
+ *          ./radio_sim --nodes 4 --topology line --duration 30
+ *          ./radio_sim --nodes 6 --topology line --duration 30
+ *
+ *          Worst-case alarm latency under a saturated bulk load, against
+ *          the same load sent with the alarm priority (no priority):
+ *          ./radio_sim --nodes 4 --topology line --no-tdma --rate 400
+ *              --payload 26 --alarms 2 --duration 30
+ *          ./radio_sim ... --priority alarm
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim_node.h"
+#include "nrf24.h"
+#include "air.h"
+
+#define DEFAULT_NODE_LIBRARY "./sim_node.so"
+#define DRAIN_US 2000000ULL
+
+// Traffic payload: uint16 sequence number, uint32 send time (us), uint8
+// kind, padding
+#define TRAFFIC_HEADER_SIZE 7
+#define TRAFFIC_KIND_OFFSET 6
+
+// Last alarm sequence numbers delivered per node: a copy, from a retry
+// after a lost ACK, is counted once
+#define ALARM_HISTORY 16
+
+// Rows of the profiler table, one per task or ISR name
+#define PROFILE_ROWS 32
+
+typedef enum {
+    TRAFFIC_DATA = 0,
+    TRAFFIC_ALARM,
+} TRAFFIC_KIND_T;
+
+typedef struct {
+    uint32_t* values;
+    size_t count;
+    size_t size;
+} SAMPLES_T;
+
+typedef struct {
+    RADIO_STATS_T radio;
+    MESH_STATS_T mesh;
+    NRF24_STATS_T nrf;
+} COUNTERS_T;
+
+// Profiler entries of the same name summed over the nodes
+typedef struct {
+    const char* name;
+    uint32_t count;
+    uint16_t min_ns;
+    uint16_t max_ns;
+    uint64_t total_ns;
+} PROFILE_ROW_T;
+
+typedef struct SIM_S SIM_T;
+
+typedef struct {
+    SIM_T* sim;
+    uint8_t id;
+    void* library;
+    const SIM_NODE_T* node;
+    NRF24_T* nrf;
+    SIM_HOST_T host;
+    uint64_t boot_us;
+    int16_t clock_ppm;
+    uint64_t next_send_us;
+    uint64_t next_alarm_us;
+    uint16_t seq;
+    uint32_t offered;
+    uint32_t refused;
+    uint32_t delivered;
+    uint32_t alarms_offered;
+    uint32_t alarms_refused;
+    uint32_t alarms_delivered;
+    uint32_t alarms_duplicated;
+    uint16_t alarm_seqs[ALARM_HISTORY];
+    uint32_t alarm_seqs_count;
+    COUNTERS_T start;
+} NODE_T;
+
+typedef struct {
+    uint8_t num_nodes;
+    AIR_TOPOLOGY_T topology;
+    double range;
+    double loss;
+    uint32_t latency_us;
+    uint16_t drift_ppm;
+    double duration_s;
+    double warmup_s;
+    double rate;
+    uint8_t payload;
+    MESH_PRIORITY_T priority;
+    double alarm_rate;
+    uint32_t seed;
+    uint32_t step_us;
+    int tdma;
+    const char* library;
+} OPTIONS_T;
+
+struct SIM_S {
+    OPTIONS_T options;
+    AIR_T* air;
+    NODE_T nodes[MAX_NODES_NUMBER];
+    uint64_t now_us;
+    uint64_t start_us;
+    uint64_t stop_us;
+    SAMPLES_T end_to_end;
+    SAMPLES_T alarm_latency;
+    SAMPLES_T fifo_to_ack;
+    uint32_t ack_retransmits[16];
+    AIR_STATS_T air_start;
+    PROFILE_ROW_T profile[PROFILE_ROWS];
+    uint8_t profile_rows;
+};
+
+static const char* Topology_Names[] = {"full", "line", "grid"};
+static const char* Priority_Names[] = {"alarm", "control", "telemetry", "bulk"};
+
+static void Usage(const char* program);
+static int ParseOptions(int argc, char** argv, OPTIONS_T* options);
+static int LoadNode(NODE_T* node, const char* library);
+static void Run(SIM_T* sim);
+static void SendTraffic(SIM_T* sim, NODE_T* node, TRAFFIC_KIND_T kind);
+static void TakeCounters(NODE_T* node, COUNTERS_T* counters);
+static void Report(SIM_T* sim);
+static void AddSample(SAMPLES_T* samples, uint32_t value);
+static uint32_t GetPercentile(SAMPLES_T* samples, double percentile);
+static void PrintLatencies(const char* name, SAMPLES_T* samples);
+static void PrintProfile(SIM_T* sim);
+static int CompareSamples(const void* a, const void* b);
+static uint8_t ExchangeSpi(void* context, uint8_t data);
+static void SetCsn(void* context, BOOL_T high);
+static void SetCe(void* context, BOOL_T high);
+static BOOL_T IsIrqActive(void* context);
+static void OnDelivered(void* context, uint8_t source, const uint8_t* payload, uint8_t length);
+static BOOL_T IsAlarmCopy(NODE_T* node, const uint8_t* payload);
+static void OnAck(void* context, uint32_t latency_us, uint8_t retransmits);
+static void OnProfile(void* context, const char* name, const PROFILER_STATS_T* stats);
+
+int main(int argc, char** argv)
+{
+    SIM_T* sim = calloc(1, sizeof(SIM_T));
+    NODE_T* node;
+    uint8_t i;
+
+    if (sim == NULL || ParseOptions(argc, argv, &sim->options) != 0)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    srand(sim->options.seed);
+    sim->air = Air__Create(sim->options.num_nodes, sim->options.topology, sim->options.range,
+                           sim->options.loss, sim->options.latency_us, sim->options.seed);
+    if (sim->air == NULL)
+    {
+        fprintf(stderr, "Cannot create the air\n");
+        return 1;
+    }
+
+    for (i = 0; i < sim->options.num_nodes; i++)
+    {
+        node = &sim->nodes[i];
+        node->sim = sim;
+        node->id = i;
+        node->nrf = Nrf24__Create(i, sim->air);
+        if (node->nrf == NULL || LoadNode(node, sim->options.library) != 0)
+        {
+            return 1;
+        }
+        Nrf24__SetAckCallback(node->nrf, OnAck, sim);
+        node->host = (SIM_HOST_T){
+            .context = node,
+            .exchange_spi = ExchangeSpi,
+            .set_csn = SetCsn,
+            .set_ce = SetCe,
+            .is_irq_active = IsIrqActive,
+            .on_delivered = OnDelivered,
+            .on_profile = OnProfile,
+        };
+        node->boot_us = (uint64_t)(rand() % 1000000);
+        node->clock_ppm = (int16_t)(rand() % (2 * sim->options.drift_ppm + 1) - sim->options.drift_ppm);
+    }
+
+    Run(sim);
+    Report(sim);
+
+    return 0;
+}
+
+static void Usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --nodes N          nodes, gateway included, 2 to %u (default 8)\n"
+            "  --topology T       full, line or grid (default full)\n"
+            "  --range R          hearing range in grid steps (default 1)\n"
+            "  --loss P           frame loss probability per receiver (default 0)\n"
+            "  --latency US       air latency of every frame (default 0)\n"
+            "  --drift PPM        largest clock error of the nodes (default 30)\n"
+            "  --duration S       measurement time (default 30)\n"
+            "  --warmup S         time before sending, for the routes (default 12)\n"
+            "  --rate R           payloads/s sent by every node (default 1)\n"
+            "  --payload B        payload length, %u to %u (default 16)\n"
+            "  --priority P       of the payloads: alarm, control, telemetry or bulk\n"
+            "                     (default bulk)\n"
+            "  --alarms R         alarms/s sent by every node on top, with the alarm\n"
+            "                     priority (default 0)\n"
+            "  --seed N           random seed (default 1)\n"
+            "  --step US          simulation step (default 10)\n"
+            "  --no-tdma          keep all the radios on\n"
+            "  --node-library F   firmware library (default %s)\n",
+            program, MAX_NODES_NUMBER, TRAFFIC_HEADER_SIZE, (unsigned)MESH_PAYLOAD_SIZE, DEFAULT_NODE_LIBRARY);
+}
+
+static int ParseOptions(int argc, char** argv, OPTIONS_T* options)
+{
+    static const struct option long_options[] = {
+        {"nodes", required_argument, NULL, 'n'},
+        {"topology", required_argument, NULL, 't'},
+        {"range", required_argument, NULL, 'r'},
+        {"loss", required_argument, NULL, 'l'},
+        {"latency", required_argument, NULL, 'L'},
+        {"drift", required_argument, NULL, 'D'},
+        {"duration", required_argument, NULL, 'd'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"rate", required_argument, NULL, 'R'},
+        {"payload", required_argument, NULL, 'p'},
+        {"priority", required_argument, NULL, 'P'},
+        {"alarms", required_argument, NULL, 'A'},
+        {"seed", required_argument, NULL, 's'},
+        {"step", required_argument, NULL, 'S'},
+        {"no-tdma", no_argument, NULL, 'T'},
+        {"node-library", required_argument, NULL, 'f'},
+        {NULL, 0, NULL, 0},
+    };
+    int option;
+    int value;
+    uint8_t i;
+
+    *options = (OPTIONS_T){
+        .num_nodes = 8,
+        .topology = AIR_TOPOLOGY_FULL,
+        .range = 1.0,
+        .drift_ppm = 30,
+        .duration_s = 30.0,
+        .warmup_s = 12.0,
+        .rate = 1.0,
+        .payload = 16,
+        .priority = MESH_PRIORITY_BULK,
+        .seed = 1,
+        .step_us = 10,
+        .tdma = 1,
+        .library = DEFAULT_NODE_LIBRARY,
+    };
+
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+            {
+                value = atoi(optarg);
+                if (value < 2 || value > MAX_NODES_NUMBER)
+                {
+                    return -1;
+                }
+                options->num_nodes = (uint8_t)value;
+                break;
+            }
+            case 't':
+            {
+                for (i = 0; i < 3 && strcmp(optarg, Topology_Names[i]) != 0; i++)
+                {
+                }
+                if (i == 3)
+                {
+                    return -1;
+                }
+                options->topology = (AIR_TOPOLOGY_T)i;
+                break;
+            }
+            case 'r': options->range = atof(optarg); break;
+            case 'l': options->loss = atof(optarg); break;
+            case 'L': options->latency_us = (uint32_t)atol(optarg); break;
+            case 'D': options->drift_ppm = (uint16_t)atoi(optarg); break;
+            case 'd': options->duration_s = atof(optarg); break;
+            case 'w': options->warmup_s = atof(optarg); break;
+            case 'R': options->rate = atof(optarg); break;
+            case 'p':
+            {
+                value = atoi(optarg);
+                if (value < TRAFFIC_HEADER_SIZE || value > (int)MESH_PAYLOAD_SIZE)
+                {
+                    return -1;
+                }
+                options->payload = (uint8_t)value;
+                break;
+            }
+            case 'P':
+            {
+                for (i = 0; i < MESH_NUM_PRIORITIES && strcmp(optarg, Priority_Names[i]) != 0; i++)
+                {
+                }
+                if (i == MESH_NUM_PRIORITIES)
+                {
+                    return -1;
+                }
+                options->priority = (MESH_PRIORITY_T)i;
+                break;
+            }
+            case 'A': options->alarm_rate = atof(optarg); break;
+            case 's': options->seed = (uint32_t)atol(optarg); break;
+            case 'S': options->step_us = (uint32_t)atol(optarg); break;
+            case 'T': options->tdma = 0; break;
+            case 'f': options->library = optarg; break;
+            default: return -1;
+        }
+    }
+
+    return (optind == argc && options->step_us > 0 && options->rate > 0 && options->duration_s > 0 &&
+            options->alarm_rate >= 0 && options->loss >= 0 && options->loss < 1 && options->drift_ppm <= 1000) ? 0 : -1;
+}
+
+/**
+ * @brief Load a private copy of the firmware library
+ *
+ * @details dlopen() returns the same handle for the same file, so the
+ *          library is copied first: every node gets its own static
+ *          variables
+ */
+static int LoadNode(NODE_T* node, const char* library)
+{
+    char path[] = "/tmp/sim_node_XXXXXX";
+    char buffer[65536];
+    SIM_NODE_ENTRY_T entry;
+    FILE* source;
+    FILE* copy;
+    size_t length;
+    int fd;
+
+    source = fopen(library, "rb");
+    fd = mkstemp(path);
+    copy = (fd >= 0) ? fdopen(fd, "wb") : NULL;
+    if (source == NULL || copy == NULL)
+    {
+        fprintf(stderr, "Cannot copy %s\n", library);
+        return -1;
+    }
+    while ((length = fread(buffer, 1, sizeof(buffer), source)) > 0)
+    {
+        fwrite(buffer, 1, length, copy);
+    }
+    fclose(source);
+    fclose(copy);
+
+    node->library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    unlink(path);
+    if (node->library == NULL)
+    {
+        fprintf(stderr, "%s\n", dlerror());
+        return -1;
+    }
+
+    entry = (SIM_NODE_ENTRY_T)dlsym(node->library, SIM_NODE_ENTRY);
+    if (entry == NULL)
+    {
+        fprintf(stderr, "%s\n", dlerror());
+        return -1;
+    }
+    node->node = entry();
+
+    return 0;
+}
+
+static void Run(SIM_T* sim)
+{
+    OPTIONS_T* options = &sim->options;
+    uint64_t interval_us = (uint64_t)(1e6 / options->rate);
+    uint64_t alarm_interval_us = (options->alarm_rate > 0) ? (uint64_t)(1e6 / options->alarm_rate) : 0;
+    uint64_t end_us;
+    NODE_T* node;
+    uint8_t i;
+
+    sim->start_us = (uint64_t)(options->warmup_s * 1e6);
+    sim->stop_us = sim->start_us + (uint64_t)(options->duration_s * 1e6);
+    end_us = sim->stop_us + DRAIN_US;
+    for (i = 1; i < options->num_nodes; i++)
+    {
+        sim->nodes[i].next_send_us = sim->start_us + (uint64_t)rand() % interval_us;
+        sim->nodes[i].next_alarm_us = (alarm_interval_us > 0) ? sim->start_us + (uint64_t)rand() % alarm_interval_us
+                                                              : UINT64_MAX;
+    }
+
+    for (sim->now_us = 0; sim->now_us <= end_us; sim->now_us += options->step_us)
+    {
+        if (sim->now_us == sim->start_us - sim->start_us % options->step_us)
+        {
+            Air__GetStats(sim->air, &sim->air_start);
+            for (i = 0; i < options->num_nodes; i++)
+            {
+                TakeCounters(&sim->nodes[i], &sim->nodes[i].start);
+            }
+        }
+
+        Air__Step(sim->air, sim->now_us);
+        for (i = 0; i < options->num_nodes; i++)
+        {
+            Nrf24__Step(sim->nodes[i].nrf, sim->now_us);
+        }
+        for (i = 0; i < options->num_nodes; i++)
+        {
+            node = &sim->nodes[i];
+            if (sim->now_us < node->boot_us)
+            {
+                continue;
+            }
+            if (sim->now_us < node->boot_us + options->step_us)
+            {
+                node->node->initialize(i, sim->now_us, node->clock_ppm, &node->host);
+                if (i == MESH_GATEWAY_ID)
+                {
+                    node->node->set_tdma(options->tdma ? TRUE : FALSE);
+                }
+            }
+            node->node->run(sim->now_us);
+            if (i != MESH_GATEWAY_ID && sim->now_us >= node->next_alarm_us && sim->now_us < sim->stop_us)
+            {
+                SendTraffic(sim, node, TRAFFIC_ALARM);
+                node->next_alarm_us += alarm_interval_us;
+            }
+            if (i != MESH_GATEWAY_ID && sim->now_us >= node->next_send_us && sim->now_us < sim->stop_us)
+            {
+                SendTraffic(sim, node, TRAFFIC_DATA);
+                node->next_send_us += interval_us;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Send a payload to the gateway, an alarm is as short as possible
+ */
+static void SendTraffic(SIM_T* sim, NODE_T* node, TRAFFIC_KIND_T kind)
+{
+    uint8_t payload[MESH_PAYLOAD_SIZE];
+    uint32_t sent_us = (uint32_t)sim->now_us;
+    BOOL_T alarm = (kind == TRAFFIC_ALARM) ? TRUE : FALSE;
+
+    memset(payload, 0, sizeof(payload));
+    memcpy(&payload[0], &node->seq, sizeof(node->seq));
+    memcpy(&payload[2], &sent_us, sizeof(sent_us));
+    payload[TRAFFIC_KIND_OFFSET] = kind;
+
+    if (alarm)
+    {
+        node->alarms_offered++;
+    }
+    else
+    {
+        node->offered++;
+    }
+
+    if (node->node->send(MESH_GATEWAY_ID, payload, alarm ? TRAFFIC_HEADER_SIZE : sim->options.payload,
+                         alarm ? MESH_PRIORITY_ALARM : sim->options.priority))
+    {
+        node->seq++;
+    }
+    else if (alarm)
+    {
+        node->alarms_refused++;
+    }
+    else
+    {
+        node->refused++;
+    }
+}
+
+static void TakeCounters(NODE_T* node, COUNTERS_T* counters)
+{
+    SIM_NODE_STATS_T stats;
+
+    node->node->get_stats(&stats);
+    counters->radio = stats.radio;
+    counters->mesh = stats.mesh;
+    Nrf24__GetStats(node->nrf, &counters->nrf);
+}
+
+static void Report(SIM_T* sim)
+{
+    OPTIONS_T* options = &sim->options;
+    COUNTERS_T total;
+    COUNTERS_T now;
+    COUNTERS_T* start;
+    SIM_NODE_STATS_T stats;
+    AIR_STATS_T air;
+    NODE_T* node;
+    uint32_t offered = 0;
+    uint32_t refused = 0;
+    uint32_t delivered = 0;
+    uint32_t alarms_offered = 0;
+    uint32_t alarms_refused = 0;
+    uint32_t alarms_delivered = 0;
+    uint32_t alarms_duplicated = 0;
+    uint32_t latency_min = UINT32_MAX;
+    uint32_t latency_max = 0;
+    uint32_t tx_messages;
+    uint32_t tx_frames;
+    uint8_t i;
+
+    memset(&total, 0, sizeof(total));
+    Air__GetStats(sim->air, &air);
+
+    printf("%u nodes, %s topology, range %.1f, loss %.3f, latency %u us, %s, %.0f s at %.2f payloads/s "
+           "of %u bytes (%s) and %.2f alarms/s per node\n\n",
+           options->num_nodes, Topology_Names[options->topology], options->range, options->loss,
+           options->latency_us, options->tdma ? "TDMA" : "radios always on", options->duration_s, options->rate,
+           options->payload, Priority_Names[options->priority], options->alarm_rate);
+
+    printf("node  offered refused delivered  frames retransmits cca_busy resyncs radio_on pool exhausted\n");
+    for (i = 0; i < options->num_nodes; i++)
+    {
+        node = &sim->nodes[i];
+        start = &node->start;
+        TakeCounters(node, &now);
+        node->node->get_stats(&stats);
+
+        tx_messages = (uint16_t)(now.radio.tx_messages - start->radio.tx_messages);
+        tx_frames = (uint16_t)(now.radio.tx_frames - start->radio.tx_frames);
+        total.radio.tx_messages += tx_messages;
+        total.radio.tx_frames += tx_frames;
+        total.radio.rx_messages += (uint16_t)(now.radio.rx_messages - start->radio.rx_messages);
+        total.radio.rx_errors += (uint16_t)(now.radio.rx_errors - start->radio.rx_errors);
+        total.radio.cca_busy += (uint16_t)(now.radio.cca_busy - start->radio.cca_busy);
+        total.radio.cca_forced += (uint16_t)(now.radio.cca_forced - start->radio.cca_forced);
+        total.radio.tx_air_bytes += now.radio.tx_air_bytes - start->radio.tx_air_bytes;
+
+        total.nrf.frames_sent += now.nrf.frames_sent - start->nrf.frames_sent;
+        total.nrf.payloads_sent += now.nrf.payloads_sent - start->nrf.payloads_sent;
+        total.nrf.retransmits += now.nrf.retransmits - start->nrf.retransmits;
+        total.nrf.max_rt += now.nrf.max_rt - start->nrf.max_rt;
+        total.nrf.acks_sent += now.nrf.acks_sent - start->nrf.acks_sent;
+        total.nrf.duplicates += now.nrf.duplicates - start->nrf.duplicates;
+        total.nrf.rx_overflows += now.nrf.rx_overflows - start->nrf.rx_overflows;
+
+        total.mesh.sent += (uint16_t)(now.mesh.sent - start->mesh.sent);
+        total.mesh.forwarded += (uint16_t)(now.mesh.forwarded - start->mesh.forwarded);
+        total.mesh.duplicates += (uint16_t)(now.mesh.duplicates - start->mesh.duplicates);
+        total.mesh.no_route += (uint16_t)(now.mesh.no_route - start->mesh.no_route);
+        total.mesh.forward_failures += (uint16_t)(now.mesh.forward_failures - start->mesh.forward_failures);
+        total.mesh.forward_overflows += (uint16_t)(now.mesh.forward_overflows - start->mesh.forward_overflows);
+        total.mesh.replaced += (uint16_t)(now.mesh.replaced - start->mesh.replaced);
+        // Extremes of the whole run, warm-up included. No average: the
+        // count of the unicast forwards is not kept apart from the floods
+        if (now.mesh.latency_min_us < latency_min)
+        {
+            latency_min = now.mesh.latency_min_us;
+        }
+        if (now.mesh.latency_max_us > latency_max)
+        {
+            latency_max = now.mesh.latency_max_us;
+        }
+
+        offered += node->offered;
+        refused += node->refused;
+        delivered += node->delivered;
+        alarms_offered += node->alarms_offered;
+        alarms_refused += node->alarms_refused;
+        alarms_delivered += node->alarms_delivered;
+        alarms_duplicated += node->alarms_duplicated;
+
+        printf("%4u %8u %7u %9u %7u %11u %8u %7u %7.1f%% %2u/%-2u %9u\n", i, node->offered, node->refused,
+               node->delivered, tx_frames, tx_frames - tx_messages,
+               (uint16_t)(now.radio.cca_busy - start->radio.cca_busy), stats.tdma.resyncs,
+               (stats.tdma.elapsed_ms > 0) ? 100.0 * stats.tdma.radio_on_ms / stats.tdma.elapsed_ms : 0.0,
+               stats.pool.high_watermark, stats.pool.size, stats.pool.exhausted);
+    }
+
+    printf("\nDriver (radio.c)\n");
+    printf("  messages sent          %u\n", total.radio.tx_messages);
+    printf("  frames sent            %u\n", total.radio.tx_frames);
+    printf("  retransmits            %u (%.3f per message)\n", total.radio.tx_frames - total.radio.tx_messages,
+           total.radio.tx_messages ? (double)(total.radio.tx_frames - total.radio.tx_messages) /
+                                     total.radio.tx_messages : 0.0);
+    printf("  messages received      %u\n", total.radio.rx_messages);
+    printf("  invalid widths         %u\n", total.radio.rx_errors);
+    printf("  CCA backoffs / forced  %u / %u\n", total.radio.cca_busy, total.radio.cca_forced);
+    printf("  throughput             %.1f messages/s\n", total.radio.tx_messages / options->duration_s);
+
+    printf("\nMAC (emulated nRF24L01+ and air)\n");
+    printf("  data frames / ACKs     %u / %u\n", total.nrf.frames_sent, total.nrf.acks_sent);
+    printf("  payloads sent          %u (%.1f/s)\n", total.nrf.payloads_sent,
+           total.nrf.payloads_sent / options->duration_s);
+    printf("  retransmits            %u\n", total.nrf.retransmits);
+    printf("  MAX_RT                 %u\n", total.nrf.max_rt);
+    printf("  duplicates dropped     %u\n", total.nrf.duplicates);
+    printf("  RX FIFO overflows      %u\n", total.nrf.rx_overflows);
+    printf("  collisions / losses    %u / %u\n", air.collisions - sim->air_start.collisions,
+           air.losses - sim->air_start.losses);
+    PrintLatencies("FIFO to ACK", &sim->fifo_to_ack);
+    printf("  retransmits per ACKed payload:");
+    for (i = 0; i < 16; i++)
+    {
+        if (sim->ack_retransmits[i] > 0)
+        {
+            printf(" %u:%u", i, sim->ack_retransmits[i]);
+        }
+    }
+    printf("\n");
+
+    printf("\nMesh (mesh.c)\n");
+    printf("  offered / refused      %u / %u\n", offered, refused);
+    printf("  delivered              %u (%.1f%% of the accepted, %.2f packets/s)\n", delivered,
+           (offered > refused) ? 100.0 * delivered / (offered - refused) : 0.0, delivered / options->duration_s);
+    PrintLatencies("end to end", &sim->end_to_end);
+    printf("  forwarded              %u\n", total.mesh.forwarded);
+    if (latency_max > 0)
+    {
+        printf("  per hop latency        min %u max %u us\n", latency_min, latency_max);
+    }
+    printf("  duplicates / no route  %u / %u\n", total.mesh.duplicates, total.mesh.no_route);
+    printf("  forward failures       %u\n", total.mesh.forward_failures);
+    printf("  forward overflows      %u\n", total.mesh.forward_overflows);
+    printf("  telemetry replaced     %u\n", total.mesh.replaced);
+
+    if (options->alarm_rate > 0)
+    {
+        printf("\nAlarms\n");
+        // A refused alarm is lost as much as one dropped on the way
+        printf("  delivered / offered    %u / %u (%.1f%%)\n", alarms_delivered, alarms_offered,
+               (alarms_offered > 0) ? 100.0 * alarms_delivered / alarms_offered : 0.0);
+        printf("  refused / lost         %u / %u\n", alarms_refused,
+               alarms_offered - alarms_refused - alarms_delivered);
+        printf("  copies                 %u\n", alarms_duplicated);
+        PrintLatencies("end to end", &sim->alarm_latency);
+    }
+
+    PrintProfile(sim);
+}
+
+static void AddSample(SAMPLES_T* samples, uint32_t value)
+{
+    uint32_t* values;
+
+    if (samples->count == samples->size)
+    {
+        samples->size = (samples->size > 0) ? samples->size * 2 : 1024;
+        values = realloc(samples->values, samples->size * sizeof(uint32_t));
+        if (values == NULL)
+        {
+            return;
+        }
+        samples->values = values;
+    }
+    samples->values[samples->count++] = value;
+}
+
+/**
+ * @remarks Sorts the samples
+ */
+static uint32_t GetPercentile(SAMPLES_T* samples, double percentile)
+{
+    size_t index;
+
+    if (samples->count == 0)
+    {
+        return 0;
+    }
+
+    qsort(samples->values, samples->count, sizeof(uint32_t), CompareSamples);
+    index = (size_t)(percentile / 100.0 * (samples->count - 1) + 0.5);
+
+    return samples->values[index];
+}
+
+static void PrintLatencies(const char* name, SAMPLES_T* samples)
+{
+    printf("  %-22s p50 %u p90 %u p99 %u max %u us (%zu samples)\n", name, GetPercentile(samples, 50),
+           GetPercentile(samples, 90), GetPercentile(samples, 99), GetPercentile(samples, 100), samples->count);
+}
+
+/**
+ * @brief Profiler table of the nodes built with PROFILER_ENABLED, over
+ *        the whole run, the warm-up included
+ */
+static void PrintProfile(SIM_T* sim)
+{
+    PROFILE_ROW_T* row;
+    uint8_t i;
+
+    for (i = 0; i < sim->options.num_nodes; i++)
+    {
+        sim->nodes[i].node->dump_profile();
+    }
+    if (sim->profile_rows == 0)
+    {
+        return;
+    }
+
+    printf("\nProfiler (host clock, all nodes)\n");
+    printf("  %-22s %10s %7s %7s %7s ns\n", "entry", "runs", "min", "max", "mean");
+    for (i = 0; i < sim->profile_rows; i++)
+    {
+        row = &sim->profile[i];
+        printf("  %-22s %10u %7u %7u %7u\n", row->name, row->count, row->min_ns, row->max_ns,
+               (uint32_t)(row->total_ns / row->count));
+    }
+}
+
+static int CompareSamples(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint8_t ExchangeSpi(void* context, uint8_t data)
+{
+    return Nrf24__ExchangeSpi(((NODE_T*)context)->nrf, data);
+}
+
+static void SetCsn(void* context, BOOL_T high)
+{
+    Nrf24__SetCsn(((NODE_T*)context)->nrf, high);
+}
+
+static void SetCe(void* context, BOOL_T high)
+{
+    Nrf24__SetCe(((NODE_T*)context)->nrf, high);
+}
+
+static BOOL_T IsIrqActive(void* context)
+{
+    return Nrf24__IsIrqActive(((NODE_T*)context)->nrf) ? TRUE : FALSE;
+}
+
+/**
+ * @brief A traffic payload reached the gateway
+ */
+static void OnDelivered(void* context, uint8_t source, const uint8_t* payload, uint8_t length)
+{
+    NODE_T* gateway = context;
+    SIM_T* sim = gateway->sim;
+    uint32_t sent_us;
+
+    if (length < TRAFFIC_HEADER_SIZE || source >= sim->options.num_nodes)
+    {
+        return;
+    }
+
+    memcpy(&sent_us, &payload[2], sizeof(sent_us));
+    if (payload[TRAFFIC_KIND_OFFSET] == TRAFFIC_ALARM && IsAlarmCopy(&sim->nodes[source], payload))
+    {
+        sim->nodes[source].alarms_duplicated++;
+    }
+    else if (payload[TRAFFIC_KIND_OFFSET] == TRAFFIC_ALARM)
+    {
+        sim->nodes[source].alarms_delivered++;
+        AddSample(&sim->alarm_latency, (uint32_t)sim->now_us - sent_us);
+    }
+    else
+    {
+        sim->nodes[source].delivered++;
+        AddSample(&sim->end_to_end, (uint32_t)sim->now_us - sent_us);
+    }
+}
+
+/**
+ * @brief Look the sequence number of an alarm up in the last ones of its
+ *        source, add it if it is not there
+ */
+static BOOL_T IsAlarmCopy(NODE_T* node, const uint8_t* payload)
+{
+    uint16_t seq;
+    uint8_t i;
+
+    memcpy(&seq, &payload[0], sizeof(seq));
+    for (i = 0; i < node->alarm_seqs_count && i < ALARM_HISTORY; i++)
+    {
+        if (node->alarm_seqs[i] == seq)
+        {
+            return TRUE;
+        }
+    }
+    node->alarm_seqs[node->alarm_seqs_count % ALARM_HISTORY] = seq;
+    node->alarm_seqs_count++;
+
+    return FALSE;
+}
+
+static void OnAck(void* context, uint32_t latency_us, uint8_t retransmits)
+{
+    SIM_T* sim = context;
+
+    if (sim->now_us >= sim->start_us && sim->now_us < sim->stop_us)
+    {
+        AddSample(&sim->fifo_to_ack, latency_us);
+        sim->ack_retransmits[retransmits & 0x0F]++;
+    }
+}
+
+/**
+ * @brief One entry of the profiler table of a node, added to the row of
+ *        the same name
+ */
+static void OnProfile(void* context, const char* name, const PROFILER_STATS_T* stats)
+{
+    SIM_T* sim = ((NODE_T*)context)->sim;
+    PROFILE_ROW_T* row = NULL;
+    uint8_t i;
+
+    if (stats->count == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < sim->profile_rows && row == NULL; i++)
+    {
+        if (strcmp(sim->profile[i].name, name) == 0)
+        {
+            row = &sim->profile[i];
+        }
+    }
+    if (row == NULL && sim->profile_rows < PROFILE_ROWS)
+    {
+        row = &sim->profile[sim->profile_rows++];
+        row->name = name;
+        row->min_ns = UINT16_MAX;
+    }
+    if (row == NULL)
+    {
+        return;
+    }
+
+    row->count += stats->count;
+    row->total_ns += (uint64_t)stats->mean_us * stats->count;
+    if (stats->min_us < row->min_ns)
+    {
+        row->min_ns = stats->min_us;
+    }
+    if (stats->max_us > row->max_ns)
+    {
+        row->max_ns = stats->max_us;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file sim_node.h
+ *
+ * @brief Interface between the simulator and a simulated node
+ *
+ * @details A node is the firmware built for the host (node.c), loaded
+ *          once per node so that each one has its own copy of the static
+ *          variables. Its pins and SPI bus are wired by the simulator to
+ *          an emulated nRF24L01+ through SIM_HOST_T.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef SIM_NODE_H_
+#define SIM_NODE_H_
+
+#include "micro.h"
+#include "packet_pool.h"
+#include "radio.h"
+#include "mesh.h"
+#include "tdma.h"
+#include "profiler.h"
+
+// Symbol looked up in the node library
+#define SIM_NODE_ENTRY "SimNode__Get"
+
+typedef struct {
+    void* context;
+    uint8_t (*exchange_spi)(void* context, uint8_t data);
+    void (*set_csn)(void* context, BOOL_T high);
+    void (*set_ce)(void* context, BOOL_T high);
+    BOOL_T (*is_irq_active)(void* context);
+    // A payload sent with SimNode send() reached the gateway
+    void (*on_delivered)(void* context, uint8_t source, const uint8_t* payload, uint8_t length);
+    // One entry of the profiler table of the node, durations in host ns
+    void (*on_profile)(void* context, const char* name, const PROFILER_STATS_T* stats);
+} SIM_HOST_T;
+
+typedef struct {
+    RADIO_STATS_T radio;
+    MESH_STATS_T mesh;
+    TDMA_STATS_T tdma;
+    PACKET_POOL_STATS_T pool;
+    uint16_t events_lost;
+} SIM_NODE_STATS_T;
+
+typedef struct {
+    // Power the node up at the given time. clock_ppm: error of the node
+    // crystal, the clocks of the nodes drift apart
+    void (*initialize)(uint8_t node_id, uint64_t now_us, int16_t clock_ppm, const SIM_HOST_T* host);
+    // Run the ISRs due and one pass of the main loop at the given time
+    void (*run)(uint64_t now_us);
+    BOOL_T (*send)(uint8_t destination, const uint8_t* payload, uint8_t length, MESH_PRIORITY_T priority);
+    void (*get_stats)(SIM_NODE_STATS_T* stats);
+    // From the gateway: duty-cycle the nodes or keep their radios on
+    void (*set_tdma)(BOOL_T enabled);
+    // Hand the profiler table to on_profile, nothing unless the node is
+    // built with PROFILER_ENABLED
+    void (*dump_profile)(void);
+} SIM_NODE_T;
+
+typedef const SIM_NODE_T* (*SIM_NODE_ENTRY_T)(void);
+
+const SIM_NODE_T* SimNode__Get(void);
+
+#endif /* SIM_NODE_H_ */
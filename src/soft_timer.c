@@ -0,0 +1,165 @@
+/**
+ * @file soft_timer.c
+ *
+ * @brief Software timer service
+ *
+ * @details The armed timers are kept in a delta list: each timer stores
+ *          the number of ticks after the expiration of the previous one,
+ *          so the periodic task only has to update the head of the list,
+ *          whatever the number of armed timers. The list walk is only
+ *          done when a timer is started or reloaded.
+ *
+ *          When a timer expires its expired flag is set and its callback,
+ *          if any, is called from the scheduler context. Periodic timers
+ *          are reloaded before the callback is called, so the callback
+ *          may stop them.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include "micro.h"
+#include "scheduler.h"
+#include "soft_timer.h"
+
+static SOFT_TIMER_T* Timer_List;
+static uint16_t Last_Tick;
+
+static void Insert(SOFT_TIMER_T* timer, uint16_t delay);
+static void Remove(SOFT_TIMER_T* timer);
+
+void SoftTimer__Initialize(void)
+{
+    Timer_List = NULL;
+    Last_Tick = Scheduler__GetTickCount();
+}
+
+/**
+ * @brief Start or restart a timer
+ *
+ * @param timer     timer to start
+ * @param delay_ms  delay before the first expiration
+ * @param period_ms reload value, 0 for a one-shot timer
+ * @param callback  called at each expiration, can be NULL
+ */
+void SoftTimer__Start(SOFT_TIMER_T* timer, uint16_t delay_ms, uint16_t period_ms, SOFT_TIMER_CALLBACK_T callback)
+{
+    if (timer->running)
+    {
+        Remove(timer);
+    }
+
+    if (delay_ms == 0)
+    {
+        delay_ms = 1;
+    }
+
+    timer->period = period_ms;
+    timer->callback = callback;
+    timer->expired = FALSE;
+    Insert(timer, delay_ms);
+}
+
+void SoftTimer__Stop(SOFT_TIMER_T* timer)
+{
+    if (timer->running)
+    {
+        Remove(timer);
+    }
+    timer->expired = FALSE;
+}
+
+/**
+ * @brief Check whether the timer expired
+ *
+ * @remarks The expired flag is cleared by this call
+ */
+BOOL_T SoftTimer__IsExpired(SOFT_TIMER_T* timer)
+{
+    BOOL_T result = timer->expired;
+
+    timer->expired = FALSE;
+
+    return result;
+}
+
+/**
+ * @brief Advance the timers by the ticks elapsed since the last call
+ *
+ * @details Ticks are taken from the scheduler, so none is lost if the
+ *          task is released late
+ */
+void SoftTimer__1msTask(void)
+{
+    SOFT_TIMER_T* head;
+    uint16_t now;
+    uint16_t elapsed;
+
+    now = Scheduler__GetTickCount();
+    elapsed = now - Last_Tick;
+    Last_Tick = now;
+
+    while (Timer_List != NULL)
+    {
+        head = Timer_List;
+        if (head->delta > elapsed)
+        {
+            head->delta -= elapsed;
+            break;
+        }
+
+        elapsed -= head->delta;
+        Timer_List = head->next;
+        head->running = FALSE;
+        head->expired = TRUE;
+
+        if (head->period != 0)
+        {
+            Insert(head, head->period);
+        }
+        if (head->callback != NULL)
+        {
+            head->callback();
+        }
+    }
+}
+
+static void Insert(SOFT_TIMER_T* timer, uint16_t delay)
+{
+    SOFT_TIMER_T** link = &Timer_List;
+
+    while (*link != NULL && (*link)->delta <= delay)
+    {
+        delay -= (*link)->delta;
+        link = &(*link)->next;
+    }
+
+    timer->delta = delay;
+    timer->next = *link;
+    if (timer->next != NULL)
+    {
+        timer->next->delta -= delay;
+    }
+    *link = timer;
+    timer->running = TRUE;
+}
+
+static void Remove(SOFT_TIMER_T* timer)
+{
+    SOFT_TIMER_T** link = &Timer_List;
+
+    while (*link != NULL && *link != timer)
+    {
+        link = &(*link)->next;
+    }
+
+    if (*link != NULL)
+    {
+        if (timer->next != NULL)
+        {
+            timer->next->delta += timer->delta;
+        }
+        *link = timer->next;
+    }
+    timer->running = FALSE;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file soft_timer.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef SOFT_TIMER_H_
+#define SOFT_TIMER_H_
+
+#include <stddef.h>
+#include "micro.h"
+
+typedef void (*SOFT_TIMER_CALLBACK_T)(void);
+
+/**
+ * Software timer, owned by the client module.
+ * The fields are private to the service.
+ */
+typedef struct SOFT_TIMER_S {
+    struct SOFT_TIMER_S* next;
+    uint16_t delta;  // ticks after the previous timer in the list
+    uint16_t period; // 0 for one-shot timers
+    SOFT_TIMER_CALLBACK_T callback;
+    BOOL_T running;
+    BOOL_T expired;
+} SOFT_TIMER_T;
+
+#define SoftTimer__StartOneShot(timer, delay_ms, callback) SoftTimer__Start(timer, delay_ms, 0, callback)
+#define SoftTimer__StartPeriodic(timer, period_ms, callback) SoftTimer__Start(timer, period_ms, period_ms, callback)
+#define SoftTimer__IsRunning(timer) ((timer)->running)
+
+void SoftTimer__Initialize(void);
+void SoftTimer__Start(SOFT_TIMER_T* timer, uint16_t delay_ms, uint16_t period_ms, SOFT_TIMER_CALLBACK_T callback);
+void SoftTimer__Stop(SOFT_TIMER_T* timer);
+BOOL_T SoftTimer__IsExpired(SOFT_TIMER_T* timer);
+void SoftTimer__1msTask(void);
+
+#endif /* SOFT_TIMER_H_ */
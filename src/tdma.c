@@ -0,0 +1,459 @@
+/**
+ * @file tdma.c
+ *
+ * @brief Time-slotted duty cycling of the radio
+ *
+ * @details Time is split in frames of Frame_Ms, made of slots of Slot_Ms.
+ *          The gateway keeps its radio on and starts each frame with a
+ *          sync beacon in slot 0, which carries the frame and slot lengths
+ *          and the slot of every node. The nodes hearing it align their
+ *          frame on its reception, on the Timer0 millisecond clock, and
+ *          then power the radio up only around the beacon slot, their own
+ *          slot and while they have messages to send.
+ *
+ *          The sync spreads hop by hop, like the routing beacons: each
+ *          node relays it once per sequence number, after a short random
+ *          delay, with its own frame time at sending, which the receivers
+ *          subtract. The beacon slot of a node lasts SYNC_HOP_MS longer
+ *          per hop, for the relays before it.
+ *
+ *          Messages to a duty-cycled node are held by the mesh until the
+ *          slot of that node (Tdma__GetWakeDelay()), broadcasts until the
+ *          beacon slot. The latency to a node is bounded by one frame.
+ *
+ *          A node missing MAX_MISSED_BEACONS beacons in a row loses the
+ *          sync and keeps its radio on until it hears the next one. The
+ *          schedule is set on the gateway and spreads with the beacons.
+ *
+ *          So does a change of the hop of the channel sequence: the sync
+ *          announces the hop for HOP_FRAMES frames, counting them down,
+ *          and all the nodes switch at the start of the same frame. A node
+ *          missing all those syncs is left behind and loses the sync.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <string.h>
+#include "micro.h"
+#include "timer.h"
+#include "radio.h"
+#include "radio_channel.h"
+#include "mesh.h"
+#include "tdma.h"
+
+// Radio power-up (Tpd2stby) plus the clock error between two beacons
+#define WAKE_LEAD_MS 6
+#define GUARD_MS 2
+// Sending to a node stops this long before the end of its slot, for the
+// retransmits
+#define TX_MARGIN_MS 5
+// From the beacon written by a node to its reception
+#define SYNC_DELAY_MS 1
+#define MAX_MISSED_BEACONS 4
+// Longest random delay before relaying a sync, and the time it adds to
+// the beacon slot per hop, radio power-up and channel assessment included
+#define SYNC_JITTER_MS 4
+#define SYNC_HOP_MS 6
+// Largest delay of the frame start taken from a sync, more than the
+// clock drift over a frame
+#define SYNC_DRIFT_MS 1
+// Frames a hop change is announced for, more than the beacons a node may
+// miss
+#define HOP_FRAMES (MAX_MISSED_BEACONS + 2)
+
+#define MAX_FRAME_MS 60000
+
+// Sync beacon payload: uint16 frame length, uint8 slot length, uint8
+// sequence number, uint8 hops from the gateway, uint16 frame time of the
+// sender when written, uint8 next hop of the channel sequence, uint8
+// frames before the hop change (0: none), slots
+#define SYNC_SLOTS_OFFSET 9
+#define SYNC_SIZE (SYNC_SLOTS_OFFSET + MAX_NODES_NUMBER)
+
+static uint16_t Frame_Ms;
+static uint8_t Slot_Ms;
+static uint8_t Slots[MAX_NODES_NUMBER];
+
+static BOOL_T Synchronized;
+static BOOL_T Beacon_Received;
+static uint8_t Missed_Beacons;
+// Last sync taken, the gateway counts the frames
+static uint8_t Sync_Seq;
+static uint8_t Sync_Hops;
+static BOOL_T Relay_Pending;
+static uint16_t Relay_Time;
+// Hop change in progress, switched at the start of the frame it reaches 0
+static uint8_t Hop_Target;
+static uint8_t Hop_Frames;
+static uint32_t Frame_Start_Ms;
+static uint16_t Last_Frame_Time;
+static BOOL_T Radio_Awake;
+
+static TDMA_STATS_T Tdma_Stats;
+
+static uint16_t GetFrameTime(void);
+static BOOL_T IsInWindow(uint16_t time, uint16_t start, uint16_t length);
+static BOOL_T IsValidSchedule(uint16_t frame_ms, uint8_t slot_ms, uint8_t slot);
+static void SendSync(void);
+static void SyncCallback(const uint8_t* payload, uint8_t length);
+static void StartNewFrame(void);
+static void SetRadioAwake(BOOL_T awake);
+
+void Tdma__Initialize(void)
+{
+    uint8_t i;
+
+    Frame_Ms = TDMA_FRAME_MS;
+    Slot_Ms = TDMA_SLOT_MS;
+    for (i = 0; i < MAX_NODES_NUMBER; i++)
+    {
+        Slots[i] = i;
+    }
+
+    // The gateway is the time reference
+    Synchronized = (RADIO_NODE_ID == MESH_GATEWAY_ID) ? TRUE : FALSE;
+    Beacon_Received = FALSE;
+    Missed_Beacons = 0;
+    Sync_Seq = 0;
+    Sync_Hops = 0;
+    Relay_Pending = FALSE;
+    Relay_Time = 0;
+    Hop_Target = 0;
+    Hop_Frames = 0;
+    Frame_Start_Ms = Timer__GetMillis();
+    Last_Frame_Time = 0;
+    Radio_Awake = TRUE;
+    memset(&Tdma_Stats, 0, sizeof(Tdma_Stats));
+
+    Mesh__ReceiveSync(SyncCallback);
+}
+
+void Tdma__1msTask(void)
+{
+    uint16_t time = GetFrameTime();
+    BOOL_T awake;
+
+    if (time < Last_Frame_Time)
+    {
+        StartNewFrame();
+    }
+    Last_Frame_Time = time;
+
+    if (Relay_Pending && time >= Relay_Time && !Radio__IsTxPending())
+    {
+        SendSync();
+    }
+
+    if (RADIO_NODE_ID == MESH_GATEWAY_ID || RADIO_NODE_ID >= MAX_NODES_NUMBER || !Synchronized ||
+        Slots[RADIO_NODE_ID] == TDMA_NO_SLOT)
+    {
+        awake = TRUE;
+    }
+    else
+    {
+        awake = IsInWindow(time, 0, Slot_Ms + Sync_Hops * SYNC_HOP_MS) ||
+                IsInWindow(time, Slots[RADIO_NODE_ID] * Slot_Ms, Slot_Ms) ||
+                Relay_Pending || Radio__IsTxPending();
+    }
+    SetRadioAwake(awake);
+
+    Tdma_Stats.elapsed_ms++;
+    if (awake)
+    {
+        Tdma_Stats.radio_on_ms++;
+    }
+}
+
+/**
+ * @brief Set the frame of the network, from the gateway
+ *
+ * @return FALSE if the slots assigned would not fit in the frame
+ */
+BOOL_T Tdma__SetFrame(uint16_t frame_ms, uint8_t slot_ms)
+{
+    BOOL_T result = FALSE;
+    uint8_t i;
+
+    for (i = 0; i < MAX_NODES_NUMBER && IsValidSchedule(frame_ms, slot_ms, Slots[i]); i++)
+    {
+    }
+
+    if (RADIO_NODE_ID == MESH_GATEWAY_ID && i == MAX_NODES_NUMBER)
+    {
+        Frame_Ms = frame_ms;
+        Slot_Ms = slot_ms;
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Move the network to another hop of the channel sequence, from
+ *        the gateway
+ *
+ * @details Announced by the sync, all the nodes switch together after
+ *          HOP_FRAMES frames
+ *
+ * @return FALSE if not the gateway or if the hop is not valid
+ */
+BOOL_T Tdma__SetHop(uint8_t hop)
+{
+    BOOL_T result = FALSE;
+
+    if (RADIO_NODE_ID == MESH_GATEWAY_ID && hop < RADIO_CHANNEL_NUM_HOPS)
+    {
+        Hop_Target = hop;
+        Hop_Frames = HOP_FRAMES;
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Assign a slot to a node, from the gateway
+ *
+ * @param slot  1 to the last slot of the frame, TDMA_NO_SLOT to keep the
+ *              node radio on. Nodes may share a slot.
+ */
+BOOL_T Tdma__SetSlot(uint8_t node_id, uint8_t slot)
+{
+    BOOL_T result = FALSE;
+
+    if (RADIO_NODE_ID == MESH_GATEWAY_ID && node_id < MAX_NODES_NUMBER && node_id != MESH_GATEWAY_ID &&
+        slot != 0 && IsValidSchedule(Frame_Ms, Slot_Ms, slot))
+    {
+        Slots[node_id] = slot;
+        result = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Time until a node listens and can be sent to
+ *
+ * @param node_id  RADIO_BROADCAST_ID for all the nodes, in the beacon slot
+ *
+ * @return milliseconds, 0 if the node listens now or is not duty-cycled
+ */
+uint16_t Tdma__GetWakeDelay(uint8_t node_id)
+{
+    uint8_t slot = TDMA_NO_SLOT;
+    uint16_t offset;
+    uint16_t delay = 0;
+
+    if (node_id == RADIO_BROADCAST_ID)
+    {
+        slot = 0;
+    }
+    else if (node_id < MAX_NODES_NUMBER && node_id != MESH_GATEWAY_ID)
+    {
+        slot = Slots[node_id];
+    }
+
+    if (Synchronized && slot != TDMA_NO_SLOT)
+    {
+        offset = (GetFrameTime() + Frame_Ms - slot * Slot_Ms) % Frame_Ms;
+        if (offset + TX_MARGIN_MS >= Slot_Ms)
+        {
+            delay = Frame_Ms - offset;
+        }
+    }
+
+    return delay;
+}
+
+BOOL_T Tdma__IsSynchronized(void)
+{
+    return Synchronized;
+}
+
+void Tdma__GetStats(TDMA_STATS_T* stats)
+{
+    *stats = Tdma_Stats;
+}
+
+static uint16_t GetFrameTime(void)
+{
+    return (uint16_t)((Timer__GetMillis() - Frame_Start_Ms) % Frame_Ms);
+}
+
+/**
+ * @brief Whether the radio must be on for a slot, with the wake-up lead
+ *        and the guard time, which may wrap around the frame end
+ */
+static BOOL_T IsInWindow(uint16_t time, uint16_t start, uint16_t length)
+{
+    uint16_t offset = (time + Frame_Ms + WAKE_LEAD_MS - start) % Frame_Ms;
+
+    return (offset < WAKE_LEAD_MS + length + GUARD_MS) ? TRUE : FALSE;
+}
+
+static BOOL_T IsValidSchedule(uint16_t frame_ms, uint8_t slot_ms, uint8_t slot)
+{
+    return (frame_ms <= MAX_FRAME_MS && slot_ms > TX_MARGIN_MS &&
+            (slot == TDMA_NO_SLOT || (uint32_t)(slot + 1) * slot_ms <= frame_ms)) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Beacon of the gateway at the start of each frame, or relay of
+ *        the last sync taken
+ */
+static void SendSync(void)
+{
+    uint8_t payload[SYNC_SIZE];
+    uint16_t time = GetFrameTime();
+    uint8_t i;
+
+    payload[0] = (uint8_t)Frame_Ms;
+    payload[1] = (uint8_t)(Frame_Ms >> 8);
+    payload[2] = Slot_Ms;
+    payload[3] = Sync_Seq;
+    payload[4] = (RADIO_NODE_ID == MESH_GATEWAY_ID) ? 0 : Sync_Hops + 1;
+    payload[5] = (uint8_t)time;
+    payload[6] = (uint8_t)(time >> 8);
+    payload[7] = Hop_Target;
+    payload[8] = Hop_Frames;
+    for (i = 0; i < MAX_NODES_NUMBER; i++)
+    {
+        payload[SYNC_SLOTS_OFFSET + i] = Slots[i];
+    }
+    if (Mesh__SendSync(payload, sizeof(payload)))
+    {
+        Relay_Pending = FALSE;
+    }
+}
+
+/**
+ * @brief Align the frame on a sync and take its schedule, then relay it
+ *
+ * @details A sync is always late, by the queueing and the channel
+ *          assessments between its writing and its sending: the earliest
+ *          frame start seen wins, a later one is only followed within
+ *          SYNC_DRIFT_MS, the clock drift of a frame
+ */
+static void SyncCallback(const uint8_t* payload, uint8_t length)
+{
+    uint16_t frame_ms;
+    uint8_t slot_ms;
+    uint8_t seq;
+    uint8_t hops;
+    uint16_t time;
+    uint32_t start;
+    int32_t shift;
+    uint8_t i;
+
+    if (RADIO_NODE_ID == MESH_GATEWAY_ID || length < SYNC_SIZE)
+    {
+        return;
+    }
+
+    frame_ms = payload[0] | ((uint16_t)payload[1] << 8);
+    slot_ms = payload[2];
+    seq = payload[3];
+    hops = payload[4];
+    time = payload[5] | ((uint16_t)payload[6] << 8);
+    if (!IsValidSchedule(frame_ms, slot_ms, 0) || time >= frame_ms ||
+        payload[7] >= RADIO_CHANNEL_NUM_HOPS)
+    {
+        return;
+    }
+
+    // Shift of the frame start, within half a frame
+    start = Timer__GetMillis() - SYNC_DELAY_MS - time;
+    shift = (int32_t)(start - Frame_Start_Ms) % Frame_Ms;
+    if (shift > (int32_t)(Frame_Ms / 2))
+    {
+        shift -= Frame_Ms;
+    }
+    else if (shift < -(int32_t)(Frame_Ms / 2))
+    {
+        shift += Frame_Ms;
+    }
+
+    if (!Synchronized || frame_ms != Frame_Ms || shift <= SYNC_DRIFT_MS)
+    {
+        Frame_Start_Ms = start;
+    }
+
+    if (!Synchronized || seq != Sync_Seq)
+    {
+        Frame_Ms = frame_ms;
+        Slot_Ms = slot_ms;
+        for (i = 0; i < MAX_NODES_NUMBER; i++)
+        {
+            Slots[i] = payload[SYNC_SLOTS_OFFSET + i];
+        }
+        Sync_Seq = seq;
+        Sync_Hops = hops;
+        Hop_Target = payload[7];
+        Hop_Frames = payload[8];
+        // Relayed once per sequence number
+        Relay_Pending = (hops + 1 < MESH_MAX_HOPS) ? TRUE : FALSE;
+        Relay_Time = GetFrameTime() + 1 + RadioChannel__GetRandom() % SYNC_JITTER_MS;
+        Tdma_Stats.beacons_received++;
+    }
+    else if (hops < Sync_Hops)
+    {
+        Sync_Hops = hops;
+    }
+
+    Last_Frame_Time = GetFrameTime();
+    Synchronized = TRUE;
+    Beacon_Received = TRUE;
+    Missed_Beacons = 0;
+}
+
+static void StartNewFrame(void)
+{
+    // A sync not relayed by now would come too late
+    Relay_Pending = FALSE;
+
+    if (Hop_Frames > 0)
+    {
+        Hop_Frames--;
+        if (Hop_Frames == 0)
+        {
+            Radio__SetHop(Hop_Target);
+        }
+    }
+
+    if (RADIO_NODE_ID == MESH_GATEWAY_ID)
+    {
+        Sync_Seq++;
+        SendSync();
+    }
+    else if (Synchronized)
+    {
+        if (!Beacon_Received)
+        {
+            Tdma_Stats.beacons_missed++;
+            Missed_Beacons++;
+            if (Missed_Beacons >= MAX_MISSED_BEACONS)
+            {
+                Synchronized = FALSE;
+                Tdma_Stats.resyncs++;
+            }
+        }
+        Beacon_Received = FALSE;
+    }
+}
+
+static void SetRadioAwake(BOOL_T awake)
+{
+    if (awake != Radio_Awake)
+    {
+        Radio_Awake = awake;
+        if (awake)
+        {
+            Radio__TurnOn();
+        }
+        else
+        {
+            Radio__TurnOff();
+        }
+    }
+}
@@ -0,0 +1,37 @@
+/**
+ * @file tdma.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef TDMA_H_
+#define TDMA_H_
+
+#include "micro.h"
+
+// Default frame: the beacon slot, then one slot per node ID
+#define TDMA_FRAME_MS 1000
+#define TDMA_SLOT_MS 20
+
+// Slot of the nodes that keep the radio on
+#define TDMA_NO_SLOT 0xFF
+
+typedef struct {
+    uint16_t beacons_received;
+    uint16_t beacons_missed;
+    uint16_t resyncs;        // sync lost, radio kept on until the next beacon
+    uint32_t radio_on_ms;
+    uint32_t elapsed_ms;
+} TDMA_STATS_T;
+
+void Tdma__Initialize(void);
+void Tdma__1msTask(void);
+BOOL_T Tdma__SetFrame(uint16_t frame_ms, uint8_t slot_ms);
+BOOL_T Tdma__SetSlot(uint8_t node_id, uint8_t slot);
+BOOL_T Tdma__SetHop(uint8_t hop);
+uint16_t Tdma__GetWakeDelay(uint8_t node_id);
+BOOL_T Tdma__IsSynchronized(void);
+void Tdma__GetStats(TDMA_STATS_T* stats);
+
+#endif /* TDMA_H_ */
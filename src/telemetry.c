@@ -0,0 +1,501 @@
+/**
+ * @file telemetry.c
+ *
+ * @brief Batching of the sensor readings into mesh frames to the gateway
+ *
+ * @details Temperature samples, relay changes and status counters are
+ *          appended as records to the current frame, which is sent to the
+ *          gateway when no other record fits or TELEMETRY_MAX_AGE_MS after
+ *          its first record. A frame of readings costs a single radio
+ *          transaction instead of one per reading. A frame the mesh does
+ *          not accept keeps its records and is sent again from the 100 ms
+ *          task, until a new record does not fit: the older records are
+ *          then dropped, the newest readings are worth more.
+ *
+ *          Reports are by exception: a temperature is recorded only when
+ *          it moves more than the deadband from the last one recorded, a
+ *          relay change always, and both send the frame at once. When no
+ *          frame has been sent for the heartbeat period, the next sample
+ *          is reported anyway, or an empty frame is sent if none comes.
+ *          The deadband and heartbeat are per node parameters, set from
+ *          the gateway with a TELEMETRY_CONFIG_TAG frame, which no other
+ *          node may send. A deadband of 0 records every sample, sent when
+ *          the frame is full or old.
+ *
+ *          Frames with a relay change are sent with the control
+ *          priority. A frame of a single temperature is sent with the
+ *          telemetry priority, so that the mesh keeps only the newest of
+ *          them when they queue up. The other ones, batches of samples,
+ *          counters and empty heartbeats, go with the bulk priority,
+ *          which the mesh never replaces.
+ *
+ *          A sensor fault is not batched: an alarm frame is sent at once
+ *          with the alarm priority, ahead of any other traffic. An alarm
+ *          the mesh refuses, e.g. at boot before any route exists, stays
+ *          pending and is sent again from the 100 ms task.
+ *
+ *          Frame: TELEMETRY_FRAME_TAG, varint age of the first record when
+ *          the frame is sent, then the records. Record: a tag byte (type
+ *          in the high nibble, index in the low one), varint time from the
+ *          previous record, then the value if the type has one.
+ *          Times are in TELEMETRY_TIME_UNIT_MS, the first record of a frame
+ *          has time 0. Temperatures are zigzag varint deltas from the
+ *          previous temperature of the frame, the first one from 0.
+ *          Counters are plain varints, sent when they change, so that a
+ *          lost frame does not offset the next ones.
+ *          The varints are little-endian groups of 7 bits, the top bit of
+ *          each byte set if more follow. See tools/telemetry_decode.py.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include <string.h>
+#include "micro.h"
+#include "timer.h"
+#include "events.h"
+#include "parameters.h"
+#include "packet_pool.h"
+#include "mesh.h"
+#include "telemetry.h"
+
+#define VARINT_MAX_SIZE 5
+// Tag and age, clamped to 3 varint bytes
+#define HEADER_MAX_SIZE 4
+#define MAX_AGE_UNITS 0x1FFFFFUL
+#define RECORDS_SIZE (MESH_PAYLOAD_SIZE - HEADER_MAX_SIZE)
+#define RECORD_MAX_SIZE (1 + 2 * VARINT_MAX_SIZE)
+// Tag and time, a relay change
+#define RECORD_MIN_SIZE 2
+
+#define RELAY_SET_FLAG 0x08
+
+#define COUNTERS_PERIOD_MS 10000
+#define COUNTERS_PERIOD_TICKS (COUNTERS_PERIOD_MS / 100)
+
+// An empty heartbeat frame is sent if no sample comes this long after the
+// heartbeat was due
+#define HEARTBEAT_GRACE_MS 10000
+
+static uint8_t Records[RECORDS_SIZE];
+static uint8_t Records_Length;
+static MESH_PRIORITY_T Records_Priority;
+// The last flush was refused by the mesh, retried at the next task run
+static BOOL_T Flush_Refused;
+static uint32_t First_Record_Ms;
+static uint32_t Last_Units;
+static int16_t Last_Temperature;
+// The frame has a temperature, which becomes the reported one once sent
+static BOOL_T Records_Temperature;
+
+static BOOL_T Reported_Valid;
+static int16_t Reported_Temperature;
+static uint32_t Last_Frame_Ms;
+
+// One bit per sensor, alarms not accepted by the mesh yet
+static uint8_t Alarms_Pending;
+
+static uint16_t Counters[TELEMETRY_NUM_COUNTERS];
+static uint8_t Counters_Countdown;
+
+static TELEMETRY_STATS_T Telemetry_Stats;
+
+static void ClearRecords(void);
+static void AddRecord(TELEMETRY_RECORD_T type, uint8_t index, uint32_t time_ms, uint16_t value);
+static uint8_t EncodeRecord(uint8_t* record, uint8_t tag, uint32_t units, uint16_t value);
+static uint8_t PutVarint(uint8_t* buffer, uint32_t value);
+static void SampleCounters(void);
+static BOOL_T IsHeartbeatDue(uint32_t grace_ms);
+static void SendHeartbeat(void);
+static void SendAlarms(void);
+
+void Telemetry__Initialize(void)
+{
+    uint8_t i;
+
+    Records_Length = 0;
+    Records_Priority = MESH_PRIORITY_TELEMETRY;
+    Flush_Refused = FALSE;
+    First_Record_Ms = 0;
+    Last_Units = 0;
+    Last_Temperature = 0;
+    Records_Temperature = FALSE;
+    Reported_Valid = FALSE;
+    Reported_Temperature = 0;
+    Last_Frame_Ms = Timer__GetMillis();
+    Alarms_Pending = 0;
+    for (i = 0; i < TELEMETRY_NUM_COUNTERS; i++)
+    {
+        Counters[i] = 0;
+    }
+    Counters_Countdown = COUNTERS_PERIOD_TICKS;
+    memset(&Telemetry_Stats, 0, sizeof(Telemetry_Stats));
+}
+
+void Telemetry__100msTask(void)
+{
+    if (Alarms_Pending != 0)
+    {
+        SendAlarms();
+    }
+
+    if (--Counters_Countdown == 0)
+    {
+        Counters_Countdown = COUNTERS_PERIOD_TICKS;
+        SampleCounters();
+    }
+
+    if (Records_Length > 0 &&
+        (Flush_Refused || Timer__GetMillis() - First_Record_Ms >= TELEMETRY_MAX_AGE_MS))
+    {
+        Telemetry__Flush();
+    }
+    else if (IsHeartbeatDue(HEARTBEAT_GRACE_MS))
+    {
+        SendHeartbeat();
+    }
+}
+
+void Telemetry__OnTemperatureReady(const EVENT_T* event)
+{
+    int16_t temperature = (int16_t)event->payload;
+    int32_t change = (int32_t)temperature - Reported_Temperature;
+    uint16_t deadband = config.reporting.deadband;
+
+    // The reported temperature only moves once the mesh accepts the frame
+    if (deadband == 0)
+    {
+        AddRecord(TELEMETRY_RECORD_TEMPERATURE, 0, event->timestamp_ms, event->payload);
+        Telemetry_Stats.reported++;
+    }
+    else if (!Reported_Valid || change > deadband || change < -(int32_t)deadband || IsHeartbeatDue(0))
+    {
+        AddRecord(TELEMETRY_RECORD_TEMPERATURE, 0, event->timestamp_ms, event->payload);
+        Telemetry__Flush();
+        Telemetry_Stats.reported++;
+    }
+    else
+    {
+        Telemetry_Stats.suppressed++;
+    }
+}
+
+void Telemetry__OnRelayDone(const EVENT_T* event)
+{
+    AddRecord(TELEMETRY_RECORD_RELAY, event->arg | (event->payload ? RELAY_SET_FLAG : 0), event->timestamp_ms, 0);
+    Telemetry__Flush();
+    Telemetry_Stats.reported++;
+}
+
+/**
+ * @brief Send an alarm frame to the gateway, ahead of the readings
+ */
+void Telemetry__OnSensorFault(const EVENT_T* event)
+{
+    if (event->arg < 8)
+    {
+        Alarms_Pending |= (uint8_t)(1 << event->arg);
+        SendAlarms();
+    }
+}
+
+/**
+ * @brief Send the current frame to the gateway, if it has any record
+ *
+ * @details The frame is written straight into a pool packet, after the
+ *          room of the mesh header
+ *
+ * @return FALSE if the mesh did not accept the frame, which keeps its
+ *         records
+ */
+BOOL_T Telemetry__Flush(void)
+{
+    PACKET_T* packet;
+    uint8_t* frame;
+    uint32_t age;
+    uint8_t length = 0;
+    BOOL_T result = FALSE;
+
+    if (Records_Length == 0)
+    {
+        return TRUE;
+    }
+
+    age = Timer__GetMillis() / TELEMETRY_TIME_UNIT_MS - First_Record_Ms / TELEMETRY_TIME_UNIT_MS;
+    if (age > MAX_AGE_UNITS)
+    {
+        age = MAX_AGE_UNITS;
+    }
+
+    packet = PacketPool__Alloc();
+    if (packet != NULL)
+    {
+        frame = &packet->data[MESH_HEADER_SIZE];
+        frame[0] = TELEMETRY_FRAME_TAG;
+        length = 1 + PutVarint(&frame[1], age);
+        memcpy(&frame[length], Records, Records_Length);
+        length += Records_Length;
+
+        result = Mesh__SendPacket(MESH_GATEWAY_ID, packet, length, Records_Priority);
+        PacketPool__Release(packet);
+    }
+
+    if (result)
+    {
+        if (Records_Temperature)
+        {
+            Reported_Valid = TRUE;
+            Reported_Temperature = Last_Temperature;
+        }
+        Last_Frame_Ms = Timer__GetMillis();
+        Telemetry_Stats.frames++;
+        Telemetry_Stats.bytes += length;
+        ClearRecords();
+    }
+    else
+    {
+        Flush_Refused = TRUE;
+    }
+
+    return result;
+}
+
+/**
+ * @param deadband     Q12.4, change of the temperature from the last report
+ *                     that is reported, 0 to record every sample
+ * @param heartbeat_s  longest time without a frame, 0 for no heartbeat
+ */
+void Telemetry__SetReporting(uint16_t deadband, uint16_t heartbeat_s)
+{
+    config.reporting.deadband = deadband;
+    config.reporting.heartbeat = heartbeat_s;
+    // The next sample is reported, with the new deadband
+    Reported_Valid = FALSE;
+}
+
+/**
+ * @brief Apply a reporting configuration frame from the gateway
+ *
+ * @return FALSE if the payload is not one, for the other consumers of the
+ *         mesh payloads
+ */
+BOOL_T Telemetry__OnMeshFrame(uint8_t source, const uint8_t* payload, uint8_t length)
+{
+    BOOL_T result = FALSE;
+
+    if (source == MESH_GATEWAY_ID && length == TELEMETRY_CONFIG_SIZE && payload[0] == TELEMETRY_CONFIG_TAG)
+    {
+        Telemetry__SetReporting(payload[1] | (payload[2] << 8), payload[3] | (payload[4] << 8));
+        result = TRUE;
+    }
+
+    return result;
+}
+
+void Telemetry__GetStats(TELEMETRY_STATS_T* stats)
+{
+    *stats = Telemetry_Stats;
+}
+
+static void ClearRecords(void)
+{
+    Records_Length = 0;
+    Records_Priority = MESH_PRIORITY_TELEMETRY;
+    Flush_Refused = FALSE;
+    Last_Temperature = 0;
+    Records_Temperature = FALSE;
+}
+
+/**
+ * @brief Append a record to the frame, sending the frame first if the
+ *        record does not fit and afterwards if nothing else would fit
+ */
+static void AddRecord(TELEMETRY_RECORD_T type, uint8_t index, uint32_t time_ms, uint16_t value)
+{
+    uint8_t record[RECORD_MAX_SIZE];
+    uint8_t tag = (uint8_t)(type << 4) | index;
+    uint32_t units = time_ms / TELEMETRY_TIME_UNIT_MS;
+    uint8_t length;
+
+    // Events of the ISR and main loop queues may be slightly out of order
+    if (Records_Length > 0 && units < Last_Units)
+    {
+        units = Last_Units;
+    }
+
+    length = EncodeRecord(record, tag, units, value);
+    if (Records_Length + length > RECORDS_SIZE)
+    {
+        if (!Telemetry__Flush())
+        {
+            ClearRecords();
+            Telemetry_Stats.frames_dropped++;
+        }
+        length = EncodeRecord(record, tag, units, value);
+    }
+
+    // Only a frame of a single temperature may be replaced in the mesh
+    if (type == TELEMETRY_RECORD_RELAY)
+    {
+        Records_Priority = MESH_PRIORITY_CONTROL;
+    }
+    else if (Records_Priority != MESH_PRIORITY_CONTROL)
+    {
+        Records_Priority = (Records_Length == 0 && type == TELEMETRY_RECORD_TEMPERATURE) ?
+                           MESH_PRIORITY_TELEMETRY : MESH_PRIORITY_BULK;
+    }
+
+    if (Records_Length == 0)
+    {
+        First_Record_Ms = time_ms;
+    }
+    memcpy(&Records[Records_Length], record, length);
+    Records_Length += length;
+    Last_Units = units;
+    if (type == TELEMETRY_RECORD_TEMPERATURE)
+    {
+        Last_Temperature = (int16_t)value;
+        Records_Temperature = TRUE;
+    }
+    Telemetry_Stats.records++;
+
+    if (Records_Length + RECORD_MIN_SIZE > RECORDS_SIZE)
+    {
+        Telemetry__Flush();
+    }
+}
+
+/**
+ * @brief Encode a record against the previous one of the current frame
+ *
+ * @return length of the record
+ */
+static uint8_t EncodeRecord(uint8_t* record, uint8_t tag, uint32_t units, uint16_t value)
+{
+    int32_t delta;
+    uint8_t length = 0;
+
+    record[length++] = tag;
+    length += PutVarint(&record[length], (Records_Length > 0) ? units - Last_Units : 0);
+
+    switch (tag >> 4)
+    {
+        case TELEMETRY_RECORD_TEMPERATURE:
+        {
+            delta = (int32_t)(int16_t)value - Last_Temperature;
+            // Zigzag: small negative deltas get small codes too
+            length += PutVarint(&record[length], ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            break;
+        }
+        case TELEMETRY_RECORD_COUNTER:
+        {
+            length += PutVarint(&record[length], value);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    return length;
+}
+
+static uint8_t PutVarint(uint8_t* buffer, uint32_t value)
+{
+    uint8_t length = 0;
+
+    while (value >= 0x80)
+    {
+        buffer[length++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    buffer[length++] = (uint8_t)value;
+
+    return length;
+}
+
+static BOOL_T IsHeartbeatDue(uint32_t grace_ms)
+{
+    return (config.reporting.heartbeat != 0 &&
+            Timer__GetMillis() - Last_Frame_Ms >= config.reporting.heartbeat * 1000UL + grace_ms) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Frame with the pending records, if any, or with none at all
+ */
+static void SendHeartbeat(void)
+{
+    uint8_t frame[2];
+
+    if (Records_Length > 0)
+    {
+        Telemetry__Flush();
+    }
+    else
+    {
+        frame[0] = TELEMETRY_FRAME_TAG;
+        frame[1] = 0;
+        // Must not replace a queued frame with records
+        if (Mesh__Send(MESH_GATEWAY_ID, frame, sizeof(frame), MESH_PRIORITY_BULK))
+        {
+            Telemetry_Stats.frames++;
+            Telemetry_Stats.bytes += sizeof(frame);
+        }
+        else
+        {
+            Telemetry_Stats.frames_dropped++;
+        }
+        // Retried at the next heartbeat period, not at every task run
+        Last_Frame_Ms = Timer__GetMillis();
+    }
+}
+
+/**
+ * @brief Alarm frame of each pending sensor, until the mesh refuses one
+ */
+static void SendAlarms(void)
+{
+    uint8_t frame[TELEMETRY_ALARM_SIZE];
+    uint8_t i;
+
+    frame[0] = TELEMETRY_ALARM_TAG;
+    frame[1] = TELEMETRY_ALARM_SENSOR_FAULT;
+    for (i = 0; i < 8 && Alarms_Pending != 0; i++)
+    {
+        if (Alarms_Pending & (1 << i))
+        {
+            frame[2] = i;
+            if (!Mesh__Send(MESH_GATEWAY_ID, frame, sizeof(frame), MESH_PRIORITY_ALARM))
+            {
+                break;
+            }
+            Alarms_Pending &= (uint8_t)~(1 << i);
+            Telemetry_Stats.alarms++;
+        }
+    }
+}
+
+/**
+ * @brief Record the status counters changed since they were last sent
+ */
+static void SampleCounters(void)
+{
+    MESH_STATS_T mesh_stats;
+    uint16_t values[TELEMETRY_NUM_COUNTERS];
+    uint8_t i;
+
+    Mesh__GetStats(&mesh_stats);
+    values[TELEMETRY_COUNTER_EVENTS_LOST] = Events__GetLostCount();
+    values[TELEMETRY_COUNTER_FORWARD_FAILURES] = mesh_stats.forward_failures;
+    values[TELEMETRY_COUNTER_FRAMES_DROPPED] = Telemetry_Stats.frames_dropped;
+
+    for (i = 0; i < TELEMETRY_NUM_COUNTERS; i++)
+    {
+        if (values[i] != Counters[i])
+        {
+            Counters[i] = values[i];
+            AddRecord(TELEMETRY_RECORD_COUNTER, i, Timer__GetMillis(), values[i]);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file telemetry.h
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "micro.h"
+#include "events.h"
+
+// First byte of a telemetry frame, in the mesh payload
+#define TELEMETRY_FRAME_TAG 0x54
+
+// First byte of an alarm frame: uint8 TELEMETRY_ALARM_T, uint8 index
+#define TELEMETRY_ALARM_TAG 0x41
+#define TELEMETRY_ALARM_SIZE 3
+
+// First byte of a reporting configuration frame from the gateway:
+// uint16 deadband Q12.4, uint16 heartbeat s
+#define TELEMETRY_CONFIG_TAG 0x52
+#define TELEMETRY_CONFIG_SIZE 5
+
+// Resolution of the record timestamps
+#define TELEMETRY_TIME_UNIT_MS 100
+
+// A frame is sent at the latest this long after its first record
+#define TELEMETRY_MAX_AGE_MS 60000
+
+typedef enum {
+    TELEMETRY_RECORD_TEMPERATURE = 0, // index: sensor, value: Q12.4 delta
+    TELEMETRY_RECORD_RELAY,           // index: relay | 0x08 if set, no value
+    TELEMETRY_RECORD_COUNTER,         // index: TELEMETRY_COUNTER_T, value: count
+} TELEMETRY_RECORD_T;
+
+typedef enum {
+    TELEMETRY_ALARM_SENSOR_FAULT = 0, // index: sensor
+} TELEMETRY_ALARM_T;
+
+typedef enum {
+    TELEMETRY_COUNTER_EVENTS_LOST = 0,
+    TELEMETRY_COUNTER_FORWARD_FAILURES,
+    TELEMETRY_COUNTER_FRAMES_DROPPED,
+    TELEMETRY_NUM_COUNTERS,
+} TELEMETRY_COUNTER_T;
+
+typedef struct {
+    uint16_t records;
+    uint16_t frames;
+    uint16_t frames_dropped; // discarded, not accepted by the mesh
+    uint32_t bytes;          // telemetry payload bytes sent
+    uint16_t reported;       // temperatures and relay changes recorded
+    uint16_t suppressed;     // temperatures within the deadband
+    uint16_t alarms;         // alarm frames sent
+} TELEMETRY_STATS_T;
+
+void Telemetry__Initialize(void);
+void Telemetry__100msTask(void);
+void Telemetry__OnTemperatureReady(const EVENT_T* event);
+void Telemetry__OnRelayDone(const EVENT_T* event);
+void Telemetry__OnSensorFault(const EVENT_T* event);
+BOOL_T Telemetry__Flush(void);
+void Telemetry__SetReporting(uint16_t deadband, uint16_t heartbeat_s);
+BOOL_T Telemetry__OnMeshFrame(uint8_t source, const uint8_t* payload, uint8_t length);
+void Telemetry__GetStats(TELEMETRY_STATS_T* stats);
+
+#endif /* TELEMETRY_H_ */
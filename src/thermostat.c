@@ -9,10 +9,11 @@
 #include "temp_sensor.h"
 #include "relays.h"
 #include "parameters.h"
+#include "soft_timer.h"
 #include "thermostat.h"
 
-#define THERMOSTAT_SAMPLE_RATE_100MS 50 // 5 seconds
-#define THERMOSTAT_TIMEOUT_100MS 10 // 1 seconds
+#define THERMOSTAT_SAMPLE_PERIOD_MS 5000
+#define THERMOSTAT_TIMEOUT_MS 1000
 
 #define THERMOSTAT_LOAD_ON()  {Relays__Set(RELAY_0); Thermostat_Status.load_active = 1;}
 #define THERMOSTAT_LOAD_OFF() {Relays__Reset(RELAY_0); Thermostat_Status.load_active = 0;}
@@ -25,7 +26,6 @@ typedef enum {
 
 typedef union {
     struct {
-        uint8_t temperature_ready :1;
         uint8_t load_active :1;
     };
     uint8_t all;
@@ -37,18 +37,19 @@ typedef enum {
 } THERMOSTAT_MODE_T;
 
 
-static uint8_t Sample_Counter;
-static uint8_t Timeout_Counter;
+static SOFT_TIMER_T Sample_Timer;
+static SOFT_TIMER_T Timeout_Timer;
 static TEMP_READING_STATE_T Temperature_Reading_State;
 static THERMOSTAT_STATUS_T Thermostat_Status;
 static THERMOSTAT_MODE_T Thermostat_Mode;
 static int16_t Last_Temperature; // Q12.4 format
 
 static inline void TemperatureReadingStateMachine(void);
+static void ControlLoad(void);
 
 void Thermostat__Initialize(void)
 {
-    Sample_Counter = 0;
+    SoftTimer__StartPeriodic(&Sample_Timer, THERMOSTAT_SAMPLE_PERIOD_MS, NULL);
     Temperature_Reading_State = STATE_IDLE;
     Thermostat_Status.all = 0;
     Thermostat_Mode = MODE_WINTER;
@@ -61,24 +62,33 @@ void Thermostat__Initialize(void)
 void Thermostat__100msTask(void)
 {
     TemperatureReadingStateMachine();
+}
 
-    if (Thermostat_Status.temperature_ready)
+void Thermostat__OnTemperatureReady(const EVENT_T* event)
+{
+    if (Temperature_Reading_State == STATE_WAIT_FOR_TEMPERATURE)
     {
-        Thermostat_Status.temperature_ready = 0;
+        SoftTimer__Stop(&Timeout_Timer);
+        Last_Temperature = (int16_t)event->payload;
+        Temperature_Reading_State = STATE_IDLE;
+        ControlLoad();
+    }
+}
 
-        if (Last_Temperature <= THERMOSTAT_TEMPERATURE_SET - THERMOSTAT_TEMPERATURE_HISTERESYS)
+static void ControlLoad(void)
+{
+    if (Last_Temperature <= config.thermostat.tempSet100 - (int16_t)config.thermostat.hist100)
+    {
+        if (Thermostat_Status.load_active == 0)
         {
-            if (Thermostat_Status.load_active == 0)
-            {
-                THERMOSTAT_LOAD_ON();
-            }
+            THERMOSTAT_LOAD_ON();
         }
-        else if (Last_Temperature >= THERMOSTAT_TEMPERATURE_SET)
+    }
+    else if (Last_Temperature >= config.thermostat.tempSet100)
+    {
+        if (Thermostat_Status.load_active == 1)
         {
-            if (Thermostat_Status.load_active == 1)
-            {
-                THERMOSTAT_LOAD_OFF();
-            }
+            THERMOSTAT_LOAD_OFF();
         }
     }
 }
@@ -89,39 +99,24 @@ static inline void TemperatureReadingStateMachine(void)
 
     next_state = Temperature_Reading_State;
 
-    if (Sample_Counter < THERMOSTAT_SAMPLE_RATE_100MS)
-    {
-        Sample_Counter++;
-    }
-
     switch (Temperature_Reading_State)
     {
         case STATE_IDLE:
         {
-            if (Sample_Counter == THERMOSTAT_SAMPLE_RATE_100MS)
+            if (SoftTimer__IsExpired(&Sample_Timer))
             {
-                Sample_Counter = 0;
                 TempSensor__StartAcquisition();
-                Timeout_Counter = THERMOSTAT_TIMEOUT_100MS;
+                SoftTimer__StartOneShot(&Timeout_Timer, THERMOSTAT_TIMEOUT_MS, NULL);
                 next_state = STATE_WAIT_FOR_TEMPERATURE;
             }
             break;
         }
         case STATE_WAIT_FOR_TEMPERATURE:
         {
-            if (TempSensor__IsTemperatureReady())
-            {
-                Last_Temperature = TempSensor__GetTemperature();
-                Thermostat_Status.temperature_ready = 1;
-                next_state = STATE_IDLE;
-            }
-            else
+            // The temperature is received by Thermostat__OnTemperatureReady()
+            if (SoftTimer__IsExpired(&Timeout_Timer))
             {
-                Timeout_Counter--;
-                if (Timeout_Counter == 0)
-                {
-                    next_state = STATE_ERROR_FOUND;
-                }
+                next_state = STATE_ERROR_FOUND;
             }
             break;
         }
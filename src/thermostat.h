@@ -8,8 +8,11 @@
 #ifndef THERMOSTAT_H_
 #define THERMOSTAT_H_
 
+#include "events.h"
+
 void Thermostat__Initialize(void);
 void Thermostat__100msTask(void);
+void Thermostat__OnTemperatureReady(const EVENT_T* event);
 
 
 #endif /* THERMOSTAT_H_ */
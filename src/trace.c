@@ -0,0 +1,151 @@
+/**
+ * @file trace.c
+ *
+ * @brief Binary trace log
+ *
+ * @details Each record holds a timestamp (16 bits of milliseconds and
+ *          the Timer0 count, 4 us each), the event ID and two 16-bit
+ *          arguments. Records are stored in a RAM ring buffer and
+ *          formatted only on the host, using the dictionary in
+ *          trace_ids.h.
+ *
+ *          The ring is drained in MSG_TRACE frames, as many records per
+ *          frame as fit, whenever a protocol frame buffer is free. Records
+ *          which do not fit in the ring are counted and reported with a
+ *          TRACE_LOST record.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#include "micro.h"
+#include "timer.h"
+#include "protocol.h"
+#include "trace.h"
+
+#ifdef TRACE_ENABLED
+
+// Must be a power of 2
+#define TRACE_BUFFER_SIZE 16
+#define TRACE_BUFFER_MASK (TRACE_BUFFER_SIZE - 1)
+
+#define RECORD_SIZE 8
+#define RECORDS_PER_FRAME (PROTOCOL_MAX_PAYLOAD / RECORD_SIZE)
+
+typedef struct {
+    uint16_t timestamp_ms;
+    uint8_t timestamp_count;
+    uint8_t id;
+    uint16_t a;
+    uint16_t b;
+} TRACE_RECORD_T;
+
+static TRACE_RECORD_T Trace_Buffer[TRACE_BUFFER_SIZE];
+static volatile uint8_t Trace_Head;
+static volatile uint8_t Trace_Tail;
+static volatile uint16_t Trace_Lost;
+
+static uint8_t PackRecord(uint8_t* buffer, const TRACE_RECORD_T* record);
+
+void Trace__Initialize(void)
+{
+    Trace_Head = 0;
+    Trace_Tail = 0;
+    Trace_Lost = 0;
+}
+
+/**
+ * @brief Record a trace event
+ *
+ * @remarks Can be called from both ISRs and the main loop
+ */
+void Trace__Record(uint8_t id, uint16_t a, uint16_t b)
+{
+    TRACE_RECORD_T* record;
+    uint8_t next;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        next = (Trace_Head + 1) & TRACE_BUFFER_MASK;
+        if (next != Trace_Tail)
+        {
+            record = &Trace_Buffer[Trace_Head];
+            record->timestamp_ms = (uint16_t)Timer_Millis;
+            record->timestamp_count = Timer__GetTimerCount();
+            record->id = id;
+            record->a = a;
+            record->b = b;
+            Trace_Head = next;
+        }
+        else
+        {
+            Trace_Lost++;
+        }
+    }
+}
+
+/**
+ * @brief Drain the ring buffer over the serial protocol
+ */
+void Trace__10msTask(void)
+{
+    TRACE_RECORD_T lost;
+    uint8_t payload[RECORDS_PER_FRAME * RECORD_SIZE];
+    uint8_t length;
+    uint8_t tail;
+    uint8_t count;
+
+    if (Trace_Lost != 0)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            lost.a = Trace_Lost;
+            lost.timestamp_ms = (uint16_t)Timer_Millis;
+            lost.timestamp_count = Timer__GetTimerCount();
+        }
+        lost.id = TRACE_LOST;
+        lost.b = 0;
+        length = PackRecord(payload, &lost);
+        if (Protocol__Send(MSG_TRACE, 0, payload, length))
+        {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                Trace_Lost -= lost.a;
+            }
+        }
+    }
+
+    while (Trace_Tail != Trace_Head)
+    {
+        tail = Trace_Tail;
+        length = 0;
+        for (count = 0; count < RECORDS_PER_FRAME && tail != Trace_Head; count++)
+        {
+            length += PackRecord(&payload[length], &Trace_Buffer[tail]);
+            tail = (tail + 1) & TRACE_BUFFER_MASK;
+        }
+
+        if (!Protocol__Send(MSG_TRACE, 0, payload, length))
+        {
+            // Retry when a frame buffer is free
+            break;
+        }
+        Trace_Tail = tail;
+    }
+}
+
+static uint8_t PackRecord(uint8_t* buffer, const TRACE_RECORD_T* record)
+{
+    buffer[0] = (uint8_t)record->timestamp_ms;
+    buffer[1] = (uint8_t)(record->timestamp_ms >> 8);
+    buffer[2] = record->timestamp_count;
+    buffer[3] = record->id;
+    buffer[4] = (uint8_t)record->a;
+    buffer[5] = (uint8_t)(record->a >> 8);
+    buffer[6] = (uint8_t)record->b;
+    buffer[7] = (uint8_t)(record->b >> 8);
+
+    return RECORD_SIZE;
+}
+
+#endif /* TRACE_ENABLED */
@@ -0,0 +1,40 @@
+/**
+ * @file trace.h
+ *
+ * @brief Binary trace log
+ *
+ * @details Enabled by defining TRACE_ENABLED at compile time. When
+ *          disabled the TRACE macro expands to nothing.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "micro.h"
+#include "trace_ids.h"
+
+#define TRACE_EVENT(id, format) id,
+typedef enum {
+    TRACE_EVENTS
+    TRACE_NUM_EVENTS,
+} TRACE_ID_T;
+#undef TRACE_EVENT
+
+#ifdef TRACE_ENABLED
+
+#define TRACE(id, a, b) Trace__Record(id, a, b)
+
+void Trace__Initialize(void);
+void Trace__Record(uint8_t id, uint16_t a, uint16_t b);
+void Trace__10msTask(void);
+
+#else
+
+#define TRACE(id, a, b)
+
+#endif /* TRACE_ENABLED */
+
+#endif /* TRACE_H_ */
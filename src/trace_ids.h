@@ -0,0 +1,23 @@
+/**
+ * @file trace_ids.h
+ *
+ * @brief Trace event dictionary
+ *
+ * @details Each entry is TRACE_EVENT(id, format). Only the IDs are
+ *          compiled into the firmware; the format strings are read by
+ *          the host decoder (tools/trace_decode.py), with the two record
+ *          arguments as parameters. Append new entries at the end, so
+ *          the IDs of the existing ones do not change.
+ *
+ * @date 17/10/2026
+ * @author Leonardo Ricupero
+ */
+
+#define TRACE_EVENTS \
+    TRACE_EVENT(TRACE_LOST,                "%u trace records lost") \
+    TRACE_EVENT(TRACE_TEMP_SENSOR_READY,   "temperature ready: %d/16 C") \
+    TRACE_EVENT(TRACE_TEMP_SENSOR_ERROR,   "temperature sensor error, state %u") \
+    TRACE_EVENT(TRACE_RADIO_IRQ,           "radio IRQ") \
+    TRACE_EVENT(TRACE_RADIO_TX,            "radio TX, length %u") \
+    TRACE_EVENT(TRACE_RELAY_PULSE_START,   "relay %u pulse start, set %u") \
+    TRACE_EVENT(TRACE_RELAY_PULSE_END,     "relay %u pulse end, set %u")
@@ -6,45 +6,45 @@
  */
 
 #include "micro.h"
+#include "soft_timer.h"
 #include "ui.h"
 
-#define UI_BLINK_RATE_500MS 5 // 500ms
+#define UI_BLINK_PERIOD_MS 500
 
-static uint8_t Countdown_Timer;
+static SOFT_TIMER_T Blink_Timer;
 static uint8_t Blinks_Remaining;
 
+static void BlinkTimerCallback(void);
+
 void Ui__Initialize(void)
 {
 	DDRB |= (1 << DDB0);
 	Ui__LedOff();
 
 	Blinks_Remaining = 0;
-	Countdown_Timer = 0;
 }
 
 void Ui__LedBlink500ms(uint8_t times)
 {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-    {
-        Blinks_Remaining = (times << 1) + 1;
-        Countdown_Timer = UI_BLINK_RATE_500MS;
-        Ui__LedOn();
-    }
+    Blinks_Remaining = (times << 1) + 1;
+    SoftTimer__StartPeriodic(&Blink_Timer, UI_BLINK_PERIOD_MS, BlinkTimerCallback);
+    Ui__LedOn();
+}
+
+/**
+ * @brief Blink once to show a radio transfer
+ */
+void Ui__OnRadioIrq(const EVENT_T* event)
+{
+    Ui__LedBlink500ms(1);
 }
 
-void Ui__100msTask(void)
+static void BlinkTimerCallback(void)
 {
-    if (Blinks_Remaining != 0)
+    Ui__LedToggle();
+    Blinks_Remaining--;
+    if (Blinks_Remaining == 0)
     {
-        if (Countdown_Timer == 0)
-        {
-            Ui__LedToggle();
-            Countdown_Timer = UI_BLINK_RATE_500MS;
-            Blinks_Remaining--;
-        }
-        else
-        {
-            Countdown_Timer--;
-        }
+        SoftTimer__Stop(&Blink_Timer);
     }
 }
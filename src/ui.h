@@ -9,6 +9,7 @@
 #define SRC_UI_H_
 
 #include "micro.h"
+#include "events.h"
 
 #define LED_PORT PORTB
 #define LED_PIN PB0
@@ -21,6 +22,6 @@
 
 void Ui__Initialize(void);
 void Ui__LedBlink500ms(uint8_t times);
-void Ui__100msTask(void);
+void Ui__OnRadioIrq(const EVENT_T* event);
 
 #endif /* SRC_UI_H_ */
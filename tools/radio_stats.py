@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Print the on-air bytes per radio message of a node.
+
+Sends MSG_GET_RADIO_STATS on the serial port and prints the average data
+frame size, as sent with dynamic payload lengths and as it would be with
+static 32-byte payloads. The port must already be configured, e.g.
+
+    stty -F /dev/ttyUSB0 9600 raw -echo
+    radio_stats.py /dev/ttyUSB0
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+from trace_decode import crc16, frames
+
+MSG_GET_RADIO_STATS = 0x08
+MSG_REPLY = 0x80
+STATS_FORMAT = "<HHIIHIIHHHH"
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out += bytes([len(block) + 1]) + block
+            block.clear()
+        else:
+            block.append(byte)
+            if len(block) == 0xFE:
+                out += bytes([0xFF]) + block
+                block.clear()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out) + b"\x00"
+
+
+def request(msg_id, seq, payload=b""):
+    frame = bytes([msg_id, seq]) + payload
+    return cobs_encode(frame + struct.pack(">H", crc16(frame)))
+
+
+def per_message(air_bytes, messages):
+    return air_bytes / messages if messages else 0.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("device", help="serial device")
+    args = parser.parse_args()
+
+    fd = os.open(args.device, os.O_RDWR | os.O_NOCTTY)
+    with os.fdopen(fd, "r+b", buffering=0) as port:
+        port.write(request(MSG_GET_RADIO_STATS, 1))
+        for frame in frames(port):
+            if frame[0] == MSG_GET_RADIO_STATS | MSG_REPLY:
+                break
+        else:
+            sys.exit("no reply")
+
+    (tx_messages, tx_frames, tx_air, tx_air_static,
+     rx_messages, rx_air, rx_air_static, rx_errors, ack_payloads,
+     cca_busy, cca_forced) = struct.unpack_from(STATS_FORMAT, frame, 2)
+    print("TX: %u messages, %u frames, %.1f bytes/message (%.1f with 32-byte payloads)"
+          % (tx_messages, tx_frames, per_message(tx_air, tx_messages), per_message(tx_air_static, tx_messages)))
+    print("RX: %u messages, %.1f bytes/message (%.1f with 32-byte payloads), %u errors"
+          % (rx_messages, per_message(rx_air, rx_messages), per_message(rx_air_static, rx_messages), rx_errors))
+    print("ACK payloads sent: %u" % ack_payloads)
+    print("Busy channel backoffs: %u, sent on a busy channel: %u" % (cca_busy, cca_forced))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Decode the telemetry frames received by the gateway.
+
+Reads the serial stream of the gateway (a file, a tty device or stdin),
+extracts the MSG_MESH_FRAME frames carrying telemetry (see src/telemetry.c)
+and prints one line per record, timed from the reception of its frame, and
+one line per alarm.
+
+    telemetry_decode.py /dev/ttyUSB0
+    telemetry_decode.py capture.bin
+"""
+
+import argparse
+import sys
+import time
+
+from trace_decode import frames
+
+MSG_MESH_FRAME = 0x43
+TELEMETRY_FRAME_TAG = 0x54
+TELEMETRY_ALARM_TAG = 0x41
+TIME_UNIT_S = 0.1
+
+RECORD_TEMPERATURE = 0
+RECORD_RELAY = 1
+RECORD_COUNTER = 2
+RELAY_SET_FLAG = 0x08
+COUNTERS = ["events lost", "forward failures", "telemetry frames dropped"]
+ALARMS = ["sensor %u fault"]
+
+
+def varint(data, i):
+    """Return the value of the varint at data[i] and the index after it."""
+    value = 0
+    shift = 0
+    while True:
+        byte = data[i]
+        i += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, i
+
+
+def decode(payload):
+    """Return the list of (time, text) of a telemetry payload, time in
+    seconds before the frame was sent."""
+    age, i = varint(payload, 1)
+    units = 0
+    temperature = 0
+    records = []
+    while i < len(payload):
+        tag = payload[i]
+        record_type, index = tag >> 4, tag & 0x0F
+        delta, i = varint(payload, i + 1)
+        units += delta
+        if record_type == RECORD_TEMPERATURE:
+            zigzag, i = varint(payload, i)
+            temperature += (zigzag >> 1) ^ -(zigzag & 1)
+            text = "temperature %u: %.2f C" % (index, temperature / 16.0)
+        elif record_type == RECORD_RELAY:
+            text = "relay %u: %s" % (index & ~RELAY_SET_FLAG, "set" if index & RELAY_SET_FLAG else "reset")
+        elif record_type == RECORD_COUNTER:
+            value, i = varint(payload, i)
+            name = COUNTERS[index] if index < len(COUNTERS) else "counter %u" % index
+            text = "%s: %u" % (name, value)
+        else:
+            records.append((0.0, "unknown record type %u, frame dropped" % record_type))
+            break
+        records.append(((age - units) * TIME_UNIT_S, text))
+    return records
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", help="serial device or capture file, stdin by default")
+    args = parser.parse_args()
+
+    stream = open(args.input, "rb", buffering=0) if args.input else sys.stdin.buffer
+    for frame in frames(stream):
+        if frame[0] != MSG_MESH_FRAME or len(frame) < 5:
+            continue
+        received = time.time()
+        source, payload = frame[2], frame[3:]
+        if payload[0] == TELEMETRY_ALARM_TAG and len(payload) >= 3:
+            text = ALARMS[payload[1]] % payload[2] if payload[1] < len(ALARMS) else "alarm %u" % payload[1]
+            print("%s node %u ALARM %s" % (time.strftime("%H:%M:%S", time.localtime(received)), source, text))
+            continue
+        if payload[0] != TELEMETRY_FRAME_TAG:
+            continue
+        try:
+            records = decode(payload)
+        except IndexError:
+            print("node %u: truncated telemetry frame" % source)
+            continue
+        if not records:
+            print("%s node %u heartbeat" % (time.strftime("%H:%M:%S", time.localtime(received)), source))
+        for before, text in records:
+            stamp = time.strftime("%H:%M:%S", time.localtime(received - before))
+            print("%s node %u %s" % (stamp, source, text))
+
+
+if __name__ == "__main__":
+    main()
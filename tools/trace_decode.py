@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""Decode the binary trace log sent by the node.
+
+Reads the serial stream (a file, a tty device or stdin), extracts the
+MSG_TRACE frames of the framed serial protocol and prints one line per
+record, formatted with the dictionary in src/trace_ids.h.
+
+    trace_decode.py /dev/ttyUSB0
+    trace_decode.py --dictionary src/trace_ids.h capture.bin
+    trace_decode.py --generate trace_dict.json
+    trace_decode.py --dictionary trace_dict.json capture.bin
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+MSG_TRACE = 0x42
+RECORD_FORMAT = "<HBBHH"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+MICROS_PER_COUNT = 4
+
+DEFAULT_DICTIONARY = os.path.join(os.path.dirname(__file__), "..", "src", "trace_ids.h")
+ENTRY_RE = re.compile(r'TRACE_EVENT\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+
+
+def load_dictionary(path):
+    """Return the list of (name, format) indexed by trace ID."""
+    with open(path) as f:
+        text = f.read()
+    if path.endswith(".json"):
+        return [tuple(entry) for entry in json.loads(text)]
+    return ENTRY_RE.findall(text)
+
+
+def crc16(data):
+    """CRC-16/CCITT, polynomial 0x1021, initial value 0xFFFF."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def frames(stream):
+    """Yield the decoded and CRC checked frames of the stream."""
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        if chunk[0] != 0:
+            buffer += chunk
+            continue
+        frame = cobs_decode(bytes(buffer)) if buffer else None
+        buffer.clear()
+        if frame is not None and len(frame) >= 4 and crc16(frame) == 0:
+            yield frame[:-2]
+
+
+def format_record(dictionary, trace_id, a, b):
+    if trace_id >= len(dictionary):
+        return "unknown trace ID %u (%u, %u)" % (trace_id, a, b)
+    name, fmt = dictionary[trace_id]
+    args = []
+    for conversion, value in zip(re.findall(r"%[-0-9]*([a-zA-Z])", fmt), (a, b)):
+        args.append(value - 0x10000 if conversion == "d" and value & 0x8000 else value)
+    try:
+        return fmt % tuple(args)
+    except TypeError:
+        return "%s (%u, %u)" % (name, a, b)
+
+
+def decode(stream, dictionary):
+    epoch_ms = 0
+    last_ms = None
+    for frame in frames(stream):
+        if frame[0] != MSG_TRACE:
+            continue
+        payload = frame[2:]
+        for offset in range(0, len(payload) - RECORD_SIZE + 1, RECORD_SIZE):
+            ms, count, trace_id, a, b = struct.unpack_from(RECORD_FORMAT, payload, offset)
+            # The millisecond field wraps around every 65.536 s
+            if last_ms is not None and ms < last_ms:
+                epoch_ms += 0x10000
+            last_ms = ms
+            timestamp_us = (epoch_ms + ms) * 1000 + count * MICROS_PER_COUNT
+            print("%12.3f ms  %s" % (timestamp_us / 1000.0, format_record(dictionary, trace_id, a, b)))
+            sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", help="serial device or capture file, stdin if omitted")
+    parser.add_argument("--dictionary", default=DEFAULT_DICTIONARY, help="trace_ids.h or generated JSON dictionary")
+    parser.add_argument("--generate", metavar="JSON", help="write the dictionary as JSON and exit")
+    args = parser.parse_args()
+
+    dictionary = load_dictionary(args.dictionary)
+    if args.generate:
+        with open(args.generate, "w") as f:
+            json.dump(dictionary, f, indent=1)
+        return
+
+    if args.input:
+        with open(args.input, "rb", buffering=0) as stream:
+            decode(stream, dictionary)
+    else:
+        decode(sys.stdin.buffer, dictionary)
+
+
+if __name__ == "__main__":
+    main()